@@ -0,0 +1,880 @@
+#include "e6502.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Checks a core against the reference table core or against test vectors.
+//
+// Images, such as Klaus Dormann's functional tests, run on both cores in
+// lockstep until the program traps in a jump or branch to itself. The core
+// runs slices of instructions at full speed and is compared after each. At
+// a mismatch both are rewound to the start of the slice and replayed an
+// instruction at a time to find the first one that diverges.
+//
+// JSON files hold single instruction test vectors in the format of the
+// SingleStepTests suites: an array of objects with a name, the initial and
+// final registers and RAM, and one entry per bus cycle.
+
+#define kSlice 1000
+#define kContext 8
+#define kMaxWrites 4
+#define kMaxDiffs 8
+#define kMaxReports 10
+#define kMaxVectorRam 32
+
+struct Regs {
+  u16 pc;
+  u8 a;
+  u8 x;
+  u8 y;
+  u8 s;
+  u8 p;
+  bool waiting;
+  u64 cycles;
+};
+
+// An instruction run by the reference and the writes it made.
+struct Step {
+  u16 pc;
+  u8 bytes[3];
+  struct Regs after;
+  size_t num_writes;
+  u16 write_addrs[kMaxWrites];
+  u8 write_data[kMaxWrites];
+};
+
+struct Machine {
+  u8* ram;
+  struct Bus bus;
+  struct Cpu cpu;
+  // Where writes through the callbacks are logged, if set.
+  struct Step* step;
+};
+
+static u8 bus_read(void* ctx, u16 addr) {
+  return ((struct Machine*)ctx)->ram[addr];
+}
+
+static void bus_write(void* ctx, u16 addr, u8 data) {
+  struct Machine* machine = ctx;
+  struct Step* step = machine->step;
+  if (step && step->num_writes < kMaxWrites) {
+    step->write_addrs[step->num_writes] = addr;
+    step->write_data[step->num_writes] = data;
+    ++step->num_writes;
+  }
+
+  machine->ram[addr] = data;
+}
+
+// The reference sees every access through the callbacks, the core under test
+// runs on RAM mapped into the page table.
+static bool machine_init(struct Machine* machine, enum CpuVariant variant,
+                         bool mapped) {
+  machine->ram = calloc(0x10000, sizeof(u8));
+  if (!machine->ram) {
+    return false;
+  }
+
+  machine->bus = (struct Bus){
+      .ctx = machine,
+      .read = bus_read,
+      .write = bus_write,
+  };
+
+  if (mapped) {
+    bus_map_ram(&machine->bus, 0x00, 0x100, machine->ram);
+  }
+
+  cpu_init(&machine->cpu, &machine->bus, variant);
+  return true;
+}
+
+static void machine_destroy(struct Machine* machine) {
+  if (machine->ram) {
+    cpu_destroy(&machine->cpu);
+    free(machine->ram);
+  }
+}
+
+static struct Regs get_regs(const struct Cpu* cpu) {
+  return (struct Regs){
+      .pc = cpu->pc,
+      .a = cpu->a,
+      .x = cpu->x,
+      .y = cpu->y,
+      .s = cpu->s,
+      .p = cpu_get_p(cpu),
+      .waiting = cpu->waiting,
+      .cycles = cpu->cycles,
+  };
+}
+
+static void set_regs(struct Cpu* cpu, const struct Regs* regs) {
+  cpu->pc = regs->pc;
+  cpu->a = regs->a;
+  cpu->x = regs->x;
+  cpu->y = regs->y;
+  cpu->s = regs->s;
+  cpu_set_p(cpu, regs->p);
+  cpu->waiting = regs->waiting;
+  cpu->jammed = false;
+  cpu->cycles = regs->cycles;
+}
+
+static bool same_regs(const struct Regs* a, const struct Regs* b) {
+  return a->pc == b->pc && a->a == b->a && a->x == b->x && a->y == b->y &&
+         a->s == b->s && a->p == b->p && a->waiting == b->waiting &&
+         a->cycles == b->cycles;
+}
+
+static bool same_machines(const struct Machine* a, const struct Machine* b) {
+  struct Regs ra = get_regs(&a->cpu);
+  struct Regs rb = get_regs(&b->cpu);
+  return same_regs(&ra, &rb) && memcmp(a->ram, b->ram, 0x10000) == 0;
+}
+
+static const char status_reg[8] = {
+    'C', 'Z', 'I', 'D', 'B', 'U', 'V', 'N',
+};
+
+static void format_status_reg(u8 p, char buf[8]) {
+  for (int i = 7; i >= 0; --i) {
+    if (p & (1 << i)) {
+      buf[i] = status_reg[i];
+    } else {
+      buf[i] = '.';
+    }
+  }
+}
+
+static void print_regs(const char* name, const struct Regs* regs) {
+  char p[8];
+  format_status_reg(regs->p, p);
+  fprintf(stderr,
+          "%-6s PC:%04" PRIX16 " A:%02" PRIX8 " X:%02" PRIX8 " Y:%02" PRIX8
+          " S:%02" PRIX8 " P:%c%c%c%c%c%c%c%c cycles:%" PRIu64 "%s\n",
+          name, regs->pc, regs->a, regs->x, regs->y, regs->s, p[7], p[6],
+          p[5], p[4], p[3], p[2], p[1], p[0], regs->cycles,
+          regs->waiting ? " waiting" : "");
+}
+
+static void print_diffs(const u8* expected, const u8* actual) {
+  int n = 0;
+  for (u32 addr = 0; addr < 0x10000 && n < kMaxDiffs; ++addr) {
+    if (expected[addr] != actual[addr]) {
+      fprintf(stderr, "  $%04" PRIX32 " table %02" PRIX8 " core %02" PRIX8 "\n",
+              addr, expected[addr], actual[addr]);
+      ++n;
+    }
+  }
+}
+
+// The last instructions of the reference, oldest first.
+struct Context {
+  struct Step steps[kContext];
+  size_t next;
+  size_t count;
+};
+
+static void print_context(const struct Context* context,
+                          enum CpuVariant variant) {
+  for (size_t i = 0; i < context->count; ++i) {
+    const struct Step* step =
+        context->steps + (context->next + kContext - context->count + i) %
+                             kContext;
+    u8 num_bytes = opcode_bytes(variant, step->bytes[0]);
+    char p[8];
+    format_status_reg(step->after.p, p);
+    fprintf(stderr, "  %04" PRIX16 "  %s", step->pc,
+            opcode_name(variant, step->bytes[0]));
+    for (u8 j = 1; j < 3; ++j) {
+      if (j < num_bytes) {
+        fprintf(stderr, " %02" PRIX8, step->bytes[j]);
+      } else {
+        fprintf(stderr, "   ");
+      }
+    }
+
+    fprintf(stderr,
+            "  A:%02" PRIX8 " X:%02" PRIX8 " Y:%02" PRIX8 " S:%02" PRIX8
+            " P:%c%c%c%c%c%c%c%c",
+            step->after.a, step->after.x, step->after.y, step->after.s, p[7],
+            p[6], p[5], p[4], p[3], p[2], p[1], p[0]);
+    for (size_t j = 0; j < step->num_writes; ++j) {
+      fprintf(stderr, " [%04" PRIX16 "]=%02" PRIX8, step->write_addrs[j],
+              step->write_data[j]);
+    }
+
+    fprintf(stderr, "\n");
+  }
+}
+
+// Runs one instruction on the reference and logs it. Returns false if the
+// CPU is stuck in a JAM, STP or WAI.
+static bool reference_step(struct Machine* ref, struct Context* context) {
+  struct Step* step = context->steps + context->next;
+  step->pc = ref->cpu.pc;
+  for (int i = 0; i < 3; ++i) {
+    step->bytes[i] = ref->ram[(u16)(step->pc + i)];
+  }
+
+  step->num_writes = 0;
+  ref->step = step;
+  struct RunResult result = cpu_run(&ref->cpu, 1);
+  ref->step = NULL;
+  if (result.instructions == 0) {
+    return false;
+  }
+
+  step->after = get_regs(&ref->cpu);
+  context->next = (context->next + 1) % kContext;
+  if (context->count < kContext) {
+    ++context->count;
+  }
+
+  return true;
+}
+
+// A BRK ends a run early, the rest of the slice is run after it.
+static bool core_run(struct Machine* core, u64 instructions) {
+  while (instructions > 0) {
+    struct RunResult result = cpu_run(&core->cpu, instructions);
+    if (result.instructions == 0) {
+      return false;
+    }
+
+    instructions -= result.instructions;
+  }
+
+  return true;
+}
+
+// The start of a slice of the lockstep run.
+struct Slice {
+  struct Regs regs;
+  u8* ram;
+  u64 start;
+  // Pages the reference ran code from during the slice.
+  bool code_pages[256];
+};
+
+// Cached blocks stay valid unless code the slice ran from was changed, so
+// that hot code stays translated when the core is rewound.
+static void rewind_machine(struct Machine* machine, const struct Slice* slice) {
+  bool flush = false;
+  for (int page = 0; page < 256 && !flush; ++page) {
+    flush = slice->code_pages[page] &&
+            memcmp(machine->ram + (page << 8), slice->ram + (page << 8),
+                   0x100) != 0;
+  }
+
+  memcpy(machine->ram, slice->ram, 0x10000);
+  set_regs(&machine->cpu, &slice->regs);
+  if (flush) {
+    cpu_flush_blocks(&machine->cpu);
+  }
+}
+
+// Whether the core matches the reference after running the first count
+// instructions of the slice at full speed.
+static bool replay(struct Machine* ref, struct Machine* core,
+                   struct Context* context, const struct Slice* slice,
+                   u64 count) {
+  rewind_machine(ref, slice);
+  rewind_machine(core, slice);
+  context->count = 0;
+  for (u64 i = 0; i < count; ++i) {
+    reference_step(ref, context);
+  }
+
+  return core_run(core, count) && same_machines(ref, core);
+}
+
+// Bisects a slice of count instructions that mismatched for the first
+// instruction after which the machines differ. Returns false if the mismatch
+// does not show again when the slice is replayed.
+static bool find_divergence(struct Machine* ref, struct Machine* core,
+                            struct Context* context, const struct Slice* slice,
+                            u64 count) {
+  if (replay(ref, core, context, slice, count)) {
+    return false;
+  }
+
+  u64 lo = 0;
+  u64 hi = count;
+  while (hi - lo > 1) {
+    u64 mid = lo + (hi - lo) / 2;
+    if (replay(ref, core, context, slice, mid)) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  replay(ref, core, context, slice, hi);
+  struct Regs expected = get_regs(&ref->cpu);
+  struct Regs actual = get_regs(&core->cpu);
+  fprintf(stderr, "first divergence at instruction %" PRIu64 "\n",
+          slice->start + hi);
+  print_context(context, ref->cpu.variant);
+  print_regs("table", &expected);
+  print_regs("core", &actual);
+  print_diffs(ref->ram, core->ram);
+  return true;
+}
+
+static int check_image(const char* file, bool has_core, enum CpuCore core,
+                       enum CpuVariant variant, u16 load_addr, int start,
+                       int success) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error opening %s\n", file);
+    return 1;
+  }
+
+  struct Machine machines[2] = {0};
+  struct Machine* ref = machines;
+  struct Machine* test = machines + 1;
+  struct Slice slice = {.ram = malloc(0x10000)};
+  struct Context* context = calloc(1, sizeof(struct Context));
+  int ret = 1;
+  if (!slice.ram || !context || !machine_init(ref, variant, false) ||
+      !machine_init(test, variant, true)) {
+    fprintf(stderr, "memory alloc error\n");
+    goto out;
+  }
+
+  ssize_t size = read(fd, ref->ram + load_addr, 0x10000 - load_addr);
+  if (size <= 0) {
+    fprintf(stderr, "error reading %s\n", file);
+    goto out;
+  }
+
+  if (!cpu_set_core(&ref->cpu, kCpuCoreTable) ||
+      (has_core && !cpu_set_core(&test->cpu, core))) {
+    fprintf(stderr, "core not available\n");
+    goto out;
+  }
+
+  // Reset reads the vector, which the image has just loaded.
+  cpu_reset(&ref->cpu);
+  if (start >= 0) {
+    ref->cpu.pc = start;
+  }
+
+  bool stuck = false;
+  bool trapped = false;
+  while (!stuck && !trapped) {
+    slice.regs = get_regs(&ref->cpu);
+    memcpy(slice.ram, ref->ram, 0x10000);
+    memset(slice.code_pages, 0, sizeof(slice.code_pages));
+    if (slice.start == 0) {
+      rewind_machine(test, &slice);
+    }
+
+    u64 count = 0;
+    while (count < kSlice) {
+      u16 pc = ref->cpu.pc;
+      slice.code_pages[pc >> 8] = true;
+      slice.code_pages[(u16)(pc + 2) >> 8] = true;
+      if (!reference_step(ref, context)) {
+        stuck = true;
+        break;
+      }
+
+      ++count;
+      if (ref->cpu.pc == pc && !ref->cpu.waiting) {
+        trapped = true;
+        break;
+      }
+    }
+
+    if (!core_run(test, count) || !same_machines(ref, test)) {
+      struct Regs expected = get_regs(&ref->cpu);
+      struct Regs actual = get_regs(&test->cpu);
+      fprintf(stderr,
+              "mismatch within the %" PRIu64 " instructions after %" PRIu64
+              "\n",
+              count, slice.start);
+      print_regs("table", &expected);
+      print_regs("core", &actual);
+      print_diffs(ref->ram, test->ram);
+      if (!find_divergence(ref, test, context, &slice, count)) {
+        fprintf(stderr, "the mismatch does not show again on a replay\n");
+      }
+
+      goto out;
+    }
+
+    slice.start += count;
+  }
+
+  fprintf(stderr, "%" PRIu64 " instructions match, %s at %04" PRIX16 "\n",
+          slice.start, trapped ? "trapped" : "stuck", ref->cpu.pc);
+  if (success >= 0 && (!trapped || ref->cpu.pc != success)) {
+    print_context(context, variant);
+    fprintf(stderr, "failed, expected a trap at %04X\n", success);
+  } else {
+    ret = 0;
+  }
+
+out:
+  machine_destroy(ref);
+  machine_destroy(test);
+  free(context);
+  free(slice.ram);
+  close(fd);
+  return ret;
+}
+
+// A small JSON reader for the test vector files, which are mapped whole.
+struct Json {
+  const char* p;
+  const char* end;
+  bool ok;
+};
+
+static void skip_space(struct Json* j) {
+  while (j->p < j->end &&
+         (*j->p == ' ' || *j->p == '\t' || *j->p == '\n' || *j->p == '\r')) {
+    ++j->p;
+  }
+}
+
+// Consumes c if it is the next token.
+static bool consume(struct Json* j, char c) {
+  skip_space(j);
+  if (j->ok && j->p < j->end && *j->p == c) {
+    ++j->p;
+    return true;
+  }
+
+  return false;
+}
+
+static void expect(struct Json* j, char c) {
+  if (!consume(j, c)) {
+    j->ok = false;
+  }
+}
+
+static long parse_number(struct Json* j) {
+  skip_space(j);
+  bool negative = consume(j, '-');
+  const char* start = j->p;
+  long value = 0;
+  while (j->p < j->end && *j->p >= '0' && *j->p <= '9') {
+    value = value * 10 + (*j->p++ - '0');
+  }
+
+  if (j->p == start) {
+    j->ok = false;
+  }
+
+  return negative ? -value : value;
+}
+
+// Truncates to the buffer, escapes are kept as the escaped character.
+static void parse_string(struct Json* j, char* buf, size_t size) {
+  size_t n = 0;
+  expect(j, '"');
+  while (j->ok && j->p < j->end && *j->p != '"') {
+    if (*j->p == '\\' && j->end - j->p > 1) {
+      ++j->p;
+    }
+
+    if (n + 1 < size) {
+      buf[n++] = *j->p;
+    }
+
+    ++j->p;
+  }
+
+  expect(j, '"');
+  if (size > 0) {
+    buf[n] = '\0';
+  }
+}
+
+static void skip_value(struct Json* j) {
+  skip_space(j);
+  if (j->p == j->end) {
+    j->ok = false;
+  } else if (*j->p == '"') {
+    parse_string(j, NULL, 0);
+  } else if (consume(j, '[')) {
+    if (!consume(j, ']')) {
+      do {
+        skip_value(j);
+      } while (j->ok && consume(j, ','));
+      expect(j, ']');
+    }
+  } else if (consume(j, '{')) {
+    if (!consume(j, '}')) {
+      do {
+        parse_string(j, NULL, 0);
+        expect(j, ':');
+        skip_value(j);
+      } while (j->ok && consume(j, ','));
+      expect(j, '}');
+    }
+  } else if (*j->p == '-' || (*j->p >= '0' && *j->p <= '9')) {
+    parse_number(j);
+  } else {
+    // true, false or null.
+    while (j->p < j->end && *j->p >= 'a' && *j->p <= 'z') {
+      ++j->p;
+    }
+  }
+}
+
+struct VectorState {
+  struct Regs regs;
+  size_t num_ram;
+  u16 ram_addrs[kMaxVectorRam];
+  u8 ram_data[kMaxVectorRam];
+};
+
+struct Vector {
+  char name[64];
+  struct VectorState initial;
+  struct VectorState final;
+  u64 cycles;
+};
+
+static void parse_ram(struct Json* j, struct VectorState* state) {
+  expect(j, '[');
+  if (consume(j, ']')) {
+    return;
+  }
+
+  do {
+    expect(j, '[');
+    long addr = parse_number(j);
+    expect(j, ',');
+    long data = parse_number(j);
+    expect(j, ']');
+    if (state->num_ram == kMaxVectorRam || addr < 0 || addr > 0xffff ||
+        data < 0 || data > 0xff) {
+      j->ok = false;
+    } else {
+      state->ram_addrs[state->num_ram] = addr;
+      state->ram_data[state->num_ram] = data;
+      ++state->num_ram;
+    }
+  } while (j->ok && consume(j, ','));
+  expect(j, ']');
+}
+
+static void parse_state(struct Json* j, struct VectorState* state) {
+  *state = (struct VectorState){0};
+  expect(j, '{');
+  do {
+    char key[8];
+    parse_string(j, key, sizeof(key));
+    expect(j, ':');
+    if (strcmp(key, "ram") == 0) {
+      parse_ram(j, state);
+    } else if (strcmp(key, "pc") == 0) {
+      state->regs.pc = parse_number(j);
+    } else if (strcmp(key, "a") == 0) {
+      state->regs.a = parse_number(j);
+    } else if (strcmp(key, "x") == 0) {
+      state->regs.x = parse_number(j);
+    } else if (strcmp(key, "y") == 0) {
+      state->regs.y = parse_number(j);
+    } else if (strcmp(key, "s") == 0) {
+      state->regs.s = parse_number(j);
+    } else if (strcmp(key, "p") == 0) {
+      state->regs.p = parse_number(j);
+    } else {
+      skip_value(j);
+    }
+  } while (j->ok && consume(j, ','));
+  expect(j, '}');
+}
+
+static bool parse_vector(struct Json* j, struct Vector* vector) {
+  vector->name[0] = '\0';
+  vector->cycles = 0;
+  expect(j, '{');
+  do {
+    char key[8];
+    parse_string(j, key, sizeof(key));
+    expect(j, ':');
+    if (strcmp(key, "name") == 0) {
+      parse_string(j, vector->name, sizeof(vector->name));
+    } else if (strcmp(key, "initial") == 0) {
+      parse_state(j, &vector->initial);
+    } else if (strcmp(key, "final") == 0) {
+      parse_state(j, &vector->final);
+    } else if (strcmp(key, "cycles") == 0) {
+      // Only their number is checked.
+      expect(j, '[');
+      if (!consume(j, ']')) {
+        do {
+          skip_value(j);
+          ++vector->cycles;
+        } while (j->ok && consume(j, ','));
+        expect(j, ']');
+      }
+    } else {
+      skip_value(j);
+    }
+  } while (j->ok && consume(j, ','));
+  expect(j, '}');
+  return j->ok;
+}
+
+// B and U are not flags of the register, how they read back after PLP or RTI
+// differs between suites.
+#define kVectorFlags 0xcf
+
+static bool run_vector(struct Machine* machine, const struct Vector* vector) {
+  const struct VectorState* initial = &vector->initial;
+  const struct VectorState* final = &vector->final;
+  for (size_t i = 0; i < initial->num_ram; ++i) {
+    machine->ram[initial->ram_addrs[i]] = initial->ram_data[i];
+  }
+
+  struct Regs regs = initial->regs;
+  regs.cycles = machine->cpu.cycles;
+  set_regs(&machine->cpu, &regs);
+  cpu_flush_blocks(&machine->cpu);
+  cpu_run(&machine->cpu, 1);
+
+  struct Regs actual = get_regs(&machine->cpu);
+  bool ok = actual.pc == final->regs.pc && actual.a == final->regs.a &&
+            actual.x == final->regs.x && actual.y == final->regs.y &&
+            actual.s == final->regs.s &&
+            ((actual.p ^ final->regs.p) & kVectorFlags) == 0 &&
+            actual.cycles - regs.cycles == vector->cycles;
+  for (size_t i = 0; i < final->num_ram; ++i) {
+    ok &= machine->ram[final->ram_addrs[i]] == final->ram_data[i];
+  }
+
+  return ok;
+}
+
+static void report_vector(const struct Machine* machine,
+                          const struct Vector* vector, u64 start_cycles) {
+  struct Regs expected = vector->final.regs;
+  struct Regs actual = get_regs(&machine->cpu);
+  expected.cycles = vector->cycles;
+  actual.cycles -= start_cycles;
+  fprintf(stderr, "%s\n", vector->name);
+  print_regs("vector", &expected);
+  print_regs("core", &actual);
+  for (size_t i = 0; i < vector->final.num_ram; ++i) {
+    u16 addr = vector->final.ram_addrs[i];
+    if (machine->ram[addr] != vector->final.ram_data[i]) {
+      fprintf(stderr, "  $%04" PRIX16 " vector %02" PRIX8 " core %02" PRIX8
+              "\n",
+              addr, vector->final.ram_data[i], machine->ram[addr]);
+    }
+  }
+}
+
+// Only the addresses the vectors name are cleared between them, the
+// instruction under test reads no others.
+static void clear_vector(struct Machine* machine, const struct Vector* vector) {
+  for (size_t i = 0; i < vector->initial.num_ram; ++i) {
+    machine->ram[vector->initial.ram_addrs[i]] = 0;
+  }
+
+  for (size_t i = 0; i < vector->final.num_ram; ++i) {
+    machine->ram[vector->final.ram_addrs[i]] = 0;
+  }
+}
+
+static int check_vectors(const char* file, bool has_core, enum CpuCore core,
+                         enum CpuVariant variant) {
+  int fd = open(file, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+    fprintf(stderr, "error opening %s\n", file);
+    if (fd >= 0) {
+      close(fd);
+    }
+
+    return 1;
+  }
+
+  const char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "error reading %s\n", file);
+    return 1;
+  }
+
+  int ret = 1;
+  struct Machine machine = {0};
+  if (!machine_init(&machine, variant, true)) {
+    fprintf(stderr, "memory alloc error\n");
+    goto out;
+  }
+
+  if (has_core && !cpu_set_core(&machine.cpu, core)) {
+    fprintf(stderr, "core not available\n");
+    goto out;
+  }
+
+  struct Json j = {
+      .p = map,
+      .end = map + st.st_size,
+      .ok = true,
+  };
+
+  u64 passed = 0;
+  u64 failed = 0;
+  struct Vector vector;
+  expect(&j, '[');
+  if (!consume(&j, ']')) {
+    do {
+      if (!parse_vector(&j, &vector)) {
+        break;
+      }
+
+      u64 start_cycles = machine.cpu.cycles;
+      if (run_vector(&machine, &vector)) {
+        ++passed;
+      } else if (failed++ < kMaxReports) {
+        report_vector(&machine, &vector, start_cycles);
+      }
+
+      clear_vector(&machine, &vector);
+    } while (consume(&j, ','));
+    expect(&j, ']');
+  }
+
+  if (!j.ok) {
+    fprintf(stderr, "%s is not a test vector file\n", file);
+    goto out;
+  }
+
+  fprintf(stderr, "%s: %" PRIu64 " of %" PRIu64 " passed\n", file, passed,
+          passed + failed);
+  ret = failed > 0;
+
+out:
+  machine_destroy(&machine);
+  munmap((void*)map, st.st_size);
+  return ret;
+}
+
+#define USAGE                                                              \
+  "Usage: %s [-c table|fused|block|jit] [-v 6502|65c02|w65c02] "           \
+  "[-l load_addr] [-s start_addr] [-e success_addr] image_file\n"          \
+  "       %s [-c table|fused|block|jit] [-v 6502|65c02|w65c02] "           \
+  "vector_file.json...\n"
+
+static bool parse_core(const char* name, enum CpuCore* core) {
+  static const struct {
+    const char* name;
+    enum CpuCore core;
+  } cores[] = {
+      {"table", kCpuCoreTable},
+      {"fused", kCpuCoreFused},
+      {"block", kCpuCoreBlock},
+      {"jit", kCpuCoreJit},
+  };
+
+  for (size_t i = 0; i < sizeof(cores) / sizeof(cores[0]); ++i) {
+    if (strcmp(name, cores[i].name) == 0) {
+      *core = cores[i].core;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool parse_variant(const char* name, enum CpuVariant* variant) {
+  static const struct {
+    const char* name;
+    enum CpuVariant variant;
+  } variants[] = {
+      {"6502", kCpuVariantNmos},
+      {"65c02", kCpuVariant65c02},
+      {"w65c02", kCpuVariantW65c02},
+  };
+
+  for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i) {
+    if (strcmp(name, variants[i].name) == 0) {
+      *variant = variants[i].variant;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Hexadecimal with an optional $ or 0x. Returns -1 if not an address.
+static int parse_addr(const char* s) {
+  if (*s == '$') {
+    ++s;
+  }
+
+  char* end;
+  unsigned long addr = strtoul(s, &end, 16);
+  return *s && !*end && addr <= 0xffff ? (int)addr : -1;
+}
+
+static bool is_json(const char* file) {
+  size_t n = strlen(file);
+  return n > 5 && strcmp(file + n - 5, ".json") == 0;
+}
+
+int main(int argc, char* argv[]) {
+  bool has_core = false;
+  enum CpuCore core = kCpuCoreTable;
+  enum CpuVariant variant = kCpuVariantNmos;
+  int load_addr = 0;
+  int start = -1;
+  int success = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "c:v:l:s:e:")) != -1) {
+    if (opt == 'c' && parse_core(optarg, &core)) {
+      has_core = true;
+    } else if (opt == 'v' && parse_variant(optarg, &variant)) {
+      continue;
+    } else if (opt == 'l' && (load_addr = parse_addr(optarg)) >= 0) {
+      continue;
+    } else if (opt == 's' && (start = parse_addr(optarg)) >= 0) {
+      continue;
+    } else if (opt == 'e' && (success = parse_addr(optarg)) >= 0) {
+      continue;
+    } else {
+      fprintf(stderr, USAGE, argv[0], argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 1 || (!is_json(argv[optind]) && argc - optind != 1)) {
+    fprintf(stderr, USAGE, argv[0], argv[0]);
+    return 1;
+  }
+
+  if (!is_json(argv[optind])) {
+    return check_image(argv[optind], has_core, core, variant, load_addr,
+                       start, success);
+  }
+
+  int ret = 0;
+  for (int i = optind; i < argc; ++i) {
+    ret |= check_vectors(argv[i], has_core, core, variant);
+  }
+
+  return ret;
+}
@@ -0,0 +1,218 @@
+#include "e6502.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// libFuzzer target for guest programs, see fuzzer_new(). The program, the
+// variant and the cycle limit of a run come from the E6502_PROGRAM,
+// E6502_VARIANT and E6502_MAX_CYCLES environment variables. A JAM or STP is
+// the guest's crash. Built without libFuzzer, the inputs given on the command
+// line are run instead, to reproduce a crash or to time runs.
+
+// About 0.1 s of a 1 MHz 6502, inputs that take longer are hangs.
+#define kDefaultMaxCycles 100000
+
+// libFuzzer adds counters in this section to its own coverage.
+__attribute__((section("__libfuzzer_extra_counters"))) static u8
+    coverage[kCoverageSize];
+
+static struct Rom* rom;
+static struct Fuzzer* fuzzer;
+static u64 max_cycles = kDefaultMaxCycles;
+
+static bool parse_variant(const char* name, enum CpuVariant* variant) {
+  static const struct {
+    const char* name;
+    enum CpuVariant variant;
+  } variants[] = {
+      {"6502", kCpuVariantNmos},
+      {"65c02", kCpuVariant65c02},
+      {"w65c02", kCpuVariantW65c02},
+  };
+
+  for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i) {
+    if (strcmp(name, variants[i].name) == 0) {
+      *variant = variants[i].variant;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool setup(const char* program, enum CpuVariant variant) {
+  int fd = open(program, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error opening %s\n", program);
+    return false;
+  }
+
+  rom = rom_new(fd);
+  close(fd);
+  if (!rom) {
+    fprintf(stderr, "%s is not a program that fits in 64 KiB\n", program);
+    return false;
+  }
+
+  fuzzer = fuzzer_new(rom, variant, coverage);
+  if (!fuzzer) {
+    fprintf(stderr, "memory alloc error\n");
+    rom_free(rom);
+    return false;
+  }
+
+  return true;
+}
+
+int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  const char* program = getenv("E6502_PROGRAM");
+  const char* variant_name = getenv("E6502_VARIANT");
+  const char* cycles = getenv("E6502_MAX_CYCLES");
+  enum CpuVariant variant = kCpuVariantNmos;
+  if (!program || (variant_name && !parse_variant(variant_name, &variant))) {
+    fprintf(stderr, "set E6502_PROGRAM and optionally E6502_VARIANT\n");
+    exit(1);
+  }
+
+  if (cycles) {
+    max_cycles = strtoull(cycles, NULL, 10);
+  }
+
+  if (!setup(program, variant)) {
+    exit(1);
+  }
+
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  struct RunResult result = fuzzer_run(fuzzer, data, size, max_cycles);
+  if (result.reason == kStopReasonIllegal) {
+    abort();
+  }
+
+  return 0;
+}
+
+#ifndef E6502_LIBFUZZER
+
+static u8* read_input(const char* file, size_t* size) {
+  int fd = open(file, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    if (fd >= 0) {
+      close(fd);
+    }
+
+    return NULL;
+  }
+
+  // One more byte so that empty inputs are not NULL.
+  u8* data = malloc(st.st_size + 1);
+  ssize_t n = data ? read(fd, data, st.st_size) : -1;
+  close(fd);
+  if (n != st.st_size) {
+    free(data);
+    return NULL;
+  }
+
+  *size = n;
+  return data;
+}
+
+static const char* const reason_names[] = {
+    [kStopReasonLimit] = "limit",
+    [kStopReasonBrk] = "brk",
+    [kStopReasonTrap] = "trap",
+    [kStopReasonHost] = "end of input",
+    [kStopReasonIdle] = "idle",
+    [kStopReasonIllegal] = "illegal",
+    [kStopReasonBreakpoint] = "breakpoint",
+    [kStopReasonWatchpoint] = "watchpoint",
+};
+
+#define USAGE                                                     \
+  "Usage: %s [-v 6502|65c02|w65c02] [-n max_cycles] [-r runs] "   \
+  "program_file input_file...\n"
+
+int main(int argc, char* argv[]) {
+  enum CpuVariant variant = kCpuVariantNmos;
+  unsigned long runs = 1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "v:n:r:")) != -1) {
+    if (opt == 'v' && parse_variant(optarg, &variant)) {
+      continue;
+    } else if (opt == 'n') {
+      max_cycles = strtoull(optarg, NULL, 10);
+    } else if (opt == 'r' && (runs = strtoul(optarg, NULL, 10)) > 0) {
+      continue;
+    } else {
+      fprintf(stderr, USAGE, argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc - optind < 2) {
+    fprintf(stderr, USAGE, argv[0]);
+    return 1;
+  }
+
+  if (!setup(argv[optind], variant)) {
+    return 1;
+  }
+
+  int ret = 0;
+  for (int i = optind + 1; i < argc; ++i) {
+    size_t size;
+    u8* data = read_input(argv[i], &size);
+    if (!data) {
+      fprintf(stderr, "error reading %s\n", argv[i]);
+      ret = 1;
+      continue;
+    }
+
+    struct timespec start;
+    struct timespec end;
+    struct RunResult result;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned long j = 0; j < runs; ++j) {
+      // The u8 counters would wrap over several runs, libFuzzer clears them
+      // before each run as well.
+      memset(coverage, 0, sizeof(coverage));
+      result = fuzzer_run(fuzzer, data, size, max_cycles);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(data);
+
+    size_t edges = 0;
+    for (size_t j = 0; j < kCoverageSize; ++j) {
+      edges += coverage[j] != 0;
+    }
+
+    double seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%s: %s after %" PRIu64 " instructions, %zu edges, %.0f runs/s\n",
+           argv[i], reason_names[result.reason], result.instructions, edges,
+           runs / seconds);
+    if (result.reason == kStopReasonIllegal) {
+      ret = 1;
+    }
+  }
+
+  fuzzer_free(fuzzer);
+  rom_free(rom);
+  return ret;
+}
+
+#endif
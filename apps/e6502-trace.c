@@ -0,0 +1,132 @@
+#include "e6502.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "trace_format.h"
+
+// Decodes a binary trace written by tracer_new() into the format of the -d
+// mode of e6502.
+
+static const char status_reg[8] = {
+    'C', 'Z', 'I', 'D', 'B', 'U', 'V', 'N',
+};
+
+static void format_status_reg(u8 p, char buf[8]) {
+  for (int i = 7; i >= 0; --i) {
+    if (p & (1 << i)) {
+      buf[i] = status_reg[i];
+    } else {
+      buf[i] = '.';
+    }
+  }
+}
+
+// From the header, traces of older versions leave it 0 for the 6502.
+static enum CpuVariant variant;
+
+static void print_record(FILE* out, const u8* record) {
+  u8 opcode = record[kFieldOpcode];
+  u8 num_bytes = opcode_bytes(variant, opcode);
+  fprintf(out, "%s", opcode_name(variant, opcode));
+  if (num_bytes >= 2) {
+    fprintf(out, " %02" PRIX8, record[kFieldOperand1]);
+  } else {
+    fprintf(out, "   ");
+  }
+
+  if (num_bytes == 3) {
+    fprintf(out, " %02" PRIX8, record[kFieldOperand2]);
+  } else {
+    fprintf(out, "   ");
+  }
+
+  char p[8];
+  format_status_reg(record[kFieldP], p);
+  u16 pc = record[kFieldPcLo] | record[kFieldPcHi] << 8;
+  fprintf(out,
+          "  PC:%04" PRIX16 " A:%02" PRIX8 " X:%02" PRIX8 " Y:%02" PRIX8
+          " S:%02" PRIX8 " P:%c%c%c%c%c%c%c%c\n",
+          pc, record[kFieldA], record[kFieldX], record[kFieldY],
+          record[kFieldS], p[7], p[6], p[5], p[4], p[3], p[2], p[1], p[0]);
+}
+
+// The predictor state of the writer, see trace_format.h.
+static u8 seen[0x10000][4];
+
+static bool decode_compressed(FILE* in, u8* record, u8* previous) {
+  int lo = fgetc(in);
+  int hi = fgetc(in);
+  if (lo == EOF || hi == EOF) {
+    return false;
+  }
+
+  predict_pc(variant, previous, record);
+
+  // The PC decides the rest of the prediction, so it is read first.
+  u16 mask = lo | hi << 8;
+  for (int i = 0; i < kTraceRecordSize; ++i) {
+    if (i == kFieldOpcode) {
+      predict_seen(seen[record[kFieldPcLo] | record[kFieldPcHi] << 8], record);
+    }
+
+    if (mask & (1 << i)) {
+      int c = fgetc(in);
+      if (c == EOF) {
+        return false;
+      }
+
+      record[i] = c;
+    }
+  }
+
+  update_seen(seen[record[kFieldPcLo] | record[kFieldPcHi] << 8], record);
+  memcpy(previous, record, kTraceRecordSize);
+  return true;
+}
+
+#define USAGE "Usage: %s trace_file\n"
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, USAGE, argv[0]);
+    return 1;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "error opening %s\n", argv[1]);
+    return 1;
+  }
+
+  u8 header[12];
+  if (fread(header, 1, sizeof(header), in) != sizeof(header) ||
+      memcmp(header, kMagic, sizeof(kMagic)) != 0 || header[8] != kVersion ||
+      header[10] != kTraceRecordSize || header[11] >= kNumCpuVariants) {
+    fprintf(stderr, "%s is not a trace\n", argv[1]);
+    fclose(in);
+    return 1;
+  }
+
+  bool compressed = header[9] & kFlagCompressed;
+  variant = header[11];
+  u8 record[kTraceRecordSize];
+  u8 previous[kTraceRecordSize] = {0};
+  for (;;) {
+    if (compressed) {
+      if (!decode_compressed(in, record, previous)) {
+        break;
+      }
+    } else if (fread(record, 1, kTraceRecordSize, in) != kTraceRecordSize) {
+      break;
+    }
+
+    print_record(stdout, record);
+  }
+
+  fclose(in);
+  return 0;
+}
@@ -7,46 +7,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
-static void* map_program_file(int fd, size_t* size) {
-  void* addr = MAP_FAILED;
-
-  struct stat st;
-  if (fstat(fd, &st)) {
-    goto err;
-  }
-
-  if (!S_ISREG(st.st_mode)) {
-    goto err;
+static struct Rom* open_rom(const char* file) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error opening %s\n", file);
+    return NULL;
   }
 
-  *size = st.st_size;
-  if (*size != 0) {
-    addr = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+  struct Rom* rom = rom_new(fd);
+  close(fd);
+  if (!rom) {
+    fprintf(stderr, "%s is not a program that fits in 64 KiB\n", file);
   }
 
-err:
-  close(fd);
-  return addr == MAP_FAILED ? NULL : addr;
+  return rom;
 }
 
 struct BusImpl {
   u8* ram;
-
-  u8 io_byte;
-  bool io_full;
+  struct Serial* serial;
+  struct Mapper* mapper;
 };
 
+#define kSerialAddr 0xffe0
+
+static bool is_serial(u16 address) {
+  return address >= kSerialAddr &&
+         address < kSerialAddr + kSerialNumRegisters;
+}
+
+// Reading the data register pops the input queue, loops polling the others
+// may be skipped as idle.
+static void mark_serial_pure(struct Bus* bus) {
+  bus_add_pure_read(bus, kSerialAddr + kSerialStatus);
+  bus_add_pure_read(bus, kSerialAddr + kSerialRxDepth);
+  bus_add_pure_read(bus, kSerialAddr + kSerialTxDepth);
+}
+
 static u8 bus_read(void* ctx, u16 address) {
   struct BusImpl* bus = ctx;
-  if (address == 0xffe0) {
-    return bus->io_full;
-  } else if (address == 0xffe1) {
-    return bus->io_byte;
+  if (is_serial(address)) {
+    return serial_read(bus->serial, address - kSerialAddr);
   } else {
     return bus->ram[address];
   }
@@ -54,122 +58,587 @@ static u8 bus_read(void* ctx, u16 address) {
 
 static void bus_write(void* ctx, u16 address, u8 data) {
   struct BusImpl* bus = ctx;
-  if (address == 0xffe1) {
-    bus->io_byte = data;
-    bus->io_full = true;
+  if (bus->mapper && mapper_write(bus->mapper, address, data)) {
+    return;
+  } else if (is_serial(address)) {
+    serial_write(bus->serial, address - kSerialAddr, data);
   } else {
     bus->ram[address] = data;
   }
 }
 
-// https://www.pagetable.com/c64ref/6502/
-// https://www.nesdev.org/wiki/Visual6502wiki/6502_all_256_Opcodes
-static u8 instruction_bytes(u8 opcode) {
-  u8 hi = opcode >> 4;
-  u8 lo = opcode & 0x0f;
-  if (lo == 0x00) {
-    if (hi == 0x02) {
-      return 3;
+static const char status_reg[8] = {
+    'C', 'Z', 'I', 'D', 'B', 'U', 'V', 'N',
+};
+
+static void format_status_reg(u8 p, char buf[8]) {
+  for (int i = 7; i >= 0; --i) {
+    if (p & (1 << i)) {
+      buf[i] = status_reg[i];
+    } else {
+      buf[i] = '.';
     }
+  }
+}
 
-    if (hi >= 0x07) {
-      return 2;
+static void print_step(const struct Bus* bus, const struct Cpu* cpu, u16 pc,
+                       u8 opcode) {
+  u8 num_bytes = opcode_bytes(cpu->variant, opcode);
+  fprintf(stderr, "%s", opcode_name(cpu->variant, opcode));
+  if (num_bytes >= 2) {
+    fprintf(stderr, " %02" PRIX8, bus->read(bus->ctx, pc + 1));
+  } else {
+    fprintf(stderr, "   ");
+  }
+
+  if (num_bytes == 3) {
+    fprintf(stderr, " %02" PRIX8, bus->read(bus->ctx, pc + 2));
+  } else {
+    fprintf(stderr, "   ");
+  }
+
+  char p[8];
+  format_status_reg(cpu_get_p(cpu), p);
+  fprintf(stderr,
+          "  PC:%04" PRIX16 " A:%02" PRIX8 " X:%02" PRIX8 " Y:%02" PRIX8
+          " S:%02" PRIX8 " P:%c%c%c%c%c%c%c%c\n",
+          pc, cpu->a, cpu->x, cpu->y, cpu->s, p[7], p[6], p[5], p[4], p[3],
+          p[2], p[1], p[0]);
+}
+
+static const char* const addr_mode_names[kNumAddrModes] = {
+    [kAddrModeImplied] = "implied", [kAddrModeImm] = "imm",
+    [kAddrModeZp] = "zp",           [kAddrModeZpx] = "zp,x",
+    [kAddrModeZpy] = "zp,y",        [kAddrModeRel] = "rel",
+    [kAddrModeAbs] = "abs",         [kAddrModeAbx] = "abs,x",
+    [kAddrModeAby] = "abs,y",       [kAddrModeInd] = "ind",
+    [kAddrModeIzx] = "(zp,x)",      [kAddrModeIzy] = "(zp),y",
+    [kAddrModeIzp] = "(zp)",        [kAddrModeIax] = "(abs,x)",
+    [kAddrModeZpr] = "zp,rel",
+};
+
+// Reads ROM pages where they are mapped and RAM elsewhere, the I/O page
+// included, without going through the callbacks.
+static u8 peek(const struct Bus* bus, u16 addr) {
+  const u8* page = bus->read_pages[addr >> 8];
+  if (page) {
+    return page[addr & 0x00ff];
+  }
+
+  return ((const struct BusImpl*)bus->ctx)->ram[addr];
+}
+
+static void disassemble(enum CpuVariant variant, const struct Bus* bus,
+                        u16 pc, char* buf, size_t size) {
+  u8 opcode = peek(bus, pc);
+  u8 lo = peek(bus, pc + 1);
+  u8 hi = peek(bus, pc + 2);
+  u16 word = lo | hi << 8;
+  const char* name = opcode_name(variant, opcode);
+  switch (opcode_addr_mode(variant, opcode)) {
+    case kAddrModeImm:
+      snprintf(buf, size, "%s #$%02" PRIX8, name, lo);
+      break;
+    case kAddrModeZp:
+      snprintf(buf, size, "%s $%02" PRIX8, name, lo);
+      break;
+    case kAddrModeZpx:
+      snprintf(buf, size, "%s $%02" PRIX8 ",X", name, lo);
+      break;
+    case kAddrModeZpy:
+      snprintf(buf, size, "%s $%02" PRIX8 ",Y", name, lo);
+      break;
+    case kAddrModeRel:
+      snprintf(buf, size, "%s $%04" PRIX16, name, (u16)(pc + 2 + (int8_t)lo));
+      break;
+    case kAddrModeAbs:
+      snprintf(buf, size, "%s $%04" PRIX16, name, word);
+      break;
+    case kAddrModeAbx:
+      snprintf(buf, size, "%s $%04" PRIX16 ",X", name, word);
+      break;
+    case kAddrModeAby:
+      snprintf(buf, size, "%s $%04" PRIX16 ",Y", name, word);
+      break;
+    case kAddrModeInd:
+      snprintf(buf, size, "%s ($%04" PRIX16 ")", name, word);
+      break;
+    case kAddrModeIzx:
+      snprintf(buf, size, "%s ($%02" PRIX8 ",X)", name, lo);
+      break;
+    case kAddrModeIzy:
+      snprintf(buf, size, "%s ($%02" PRIX8 "),Y", name, lo);
+      break;
+    case kAddrModeIzp:
+      snprintf(buf, size, "%s ($%02" PRIX8 ")", name, lo);
+      break;
+    case kAddrModeIax:
+      snprintf(buf, size, "%s ($%04" PRIX16 ",X)", name, word);
+      break;
+    case kAddrModeZpr:
+      snprintf(buf, size, "%s $%02" PRIX8 ",$%04" PRIX16, name, lo,
+               (u16)(pc + 3 + (int8_t)hi));
+      break;
+    default:
+      snprintf(buf, size, "%s", name);
+  }
+}
+
+#define kReportLines 20
+
+// Sorts indices by descending key.
+static const u64* sort_keys;
+
+static int compare_keys(const void* a, const void* b) {
+  u64 ka = sort_keys[*(const u32*)a];
+  u64 kb = sort_keys[*(const u32*)b];
+  return (ka < kb) - (ka > kb);
+}
+
+static size_t sort_by(const u64* keys, size_t num_keys, u32* order) {
+  size_t n = 0;
+  for (size_t i = 0; i < num_keys; ++i) {
+    if (keys[i] != 0) {
+      order[n++] = i;
     }
+  }
+
+  sort_keys = keys;
+  qsort(order, n, sizeof(u32), compare_keys);
+  return n;
+}
 
-    return (hi & 1) == 0 ? 1 : 2;
+static double percent(u64 part, u64 total) {
+  return total == 0 ? 0.0 : 100.0 * part / total;
+}
+
+// Hot addresses are disassembled from memory as it is after the run.
+static void print_profile(const struct Profile* profile,
+                          enum CpuVariant variant, const struct Bus* bus) {
+  static u32 order[0x10000];
+  u64 instructions = 0;
+  u64 cycles = 0;
+  for (u32 i = 0; i < 0x10000; ++i) {
+    instructions += profile->instructions[i];
+    cycles += profile->cycles[i];
   }
 
-  if (lo == 0x01 || (lo >= 0x03 && lo <= 0x07)) {
-    return 2;
+  fprintf(stderr, "%" PRIu64 " instructions, %" PRIu64 " cycles\n",
+          instructions, cycles);
+
+  fprintf(stderr, "\n%10s %6s %12s %6s  %-4s  %s\n", "count", "%", "cycles",
+          "%", "pc", "instruction");
+  size_t n = sort_by(profile->cycles, 0x10000, order);
+  for (size_t i = 0; i < n && i < kReportLines; ++i) {
+    u16 pc = order[i];
+    char buf[32];
+    disassemble(variant, bus, pc, buf, sizeof(buf));
+    fprintf(stderr,
+            "%10" PRIu64 " %6.2f %12" PRIu64 " %6.2f  %04" PRIX16 "  %s\n",
+            profile->instructions[pc],
+            percent(profile->instructions[pc], instructions),
+            profile->cycles[pc], percent(profile->cycles[pc], cycles), pc,
+            buf);
   }
 
-  if (lo == 0x02) {
-    if (hi <= 0x07) {
-      return 1;
+  fprintf(stderr, "\n%10s %6s  %s\n", "count", "%", "opcode");
+  n = sort_by(profile->opcodes, 256, order);
+  for (size_t i = 0; i < n && i < kReportLines; ++i) {
+    u8 opcode = order[i];
+    fprintf(stderr, "%10" PRIu64 " %6.2f  %02" PRIX8 " %s %s\n",
+            profile->opcodes[opcode],
+            percent(profile->opcodes[opcode], instructions), opcode,
+            opcode_name(variant, opcode),
+            addr_mode_names[opcode_addr_mode(variant, opcode)]);
+  }
+
+  u64 modes[kNumAddrModes] = {0};
+  for (int i = 0; i < 256; ++i) {
+    modes[opcode_addr_mode(variant, i)] += profile->opcodes[i];
+  }
+
+  fprintf(stderr, "\n%10s %6s  %s\n", "count", "%", "mode");
+  n = sort_by(modes, kNumAddrModes, order);
+  for (size_t i = 0; i < n; ++i) {
+    fprintf(stderr, "%10" PRIu64 " %6.2f  %s\n", modes[order[i]],
+            percent(modes[order[i]], instructions),
+            addr_mode_names[order[i]]);
+  }
+
+  u64 call_cycles[kProfileMaxCalls];
+  for (int i = 0; i < kProfileMaxCalls; ++i) {
+    call_cycles[i] = profile->calls[i].calls ? profile->calls[i].cycles + 1 : 0;
+  }
+
+  fprintf(stderr, "\n%10s %12s %6s  %-4s  %s\n", "calls", "cycles", "%",
+          "site", "target");
+  n = sort_by(call_cycles, kProfileMaxCalls, order);
+  for (size_t i = 0; i < n && i < kReportLines; ++i) {
+    const struct ProfileCall* call = profile->calls + order[i];
+    fprintf(stderr,
+            "%10" PRIu64 " %12" PRIu64 " %6.2f  %04" PRIX16 "  %04" PRIX16
+            "\n",
+            call->calls, call->cycles, percent(call->cycles, cycles),
+            call->site, call->target);
+  }
+
+  if (profile->dropped_calls > 0) {
+    fprintf(stderr, "%" PRIu64 " calls not recorded\n",
+            profile->dropped_calls);
+  }
+}
+
+#define USAGE                                                  \
+  "Usage: %s [-d] [-x] [-p] [-s] [-t trace_file [-z]] "        \
+  "[-c table|fused|block|jit] [-v 6502|65c02|w65c02] "         \
+  "[-b addr] [-w addr] [-m bank_file] [-j threads] "           \
+  "program_file...\n"
+
+static bool parse_core(const char* name, enum CpuCore* core) {
+  static const struct {
+    const char* name;
+    enum CpuCore core;
+  } cores[] = {
+      {"table", kCpuCoreTable},
+      {"fused", kCpuCoreFused},
+      {"block", kCpuCoreBlock},
+      {"jit", kCpuCoreJit},
+  };
+
+  for (size_t i = 0; i < sizeof(cores) / sizeof(cores[0]); ++i) {
+    if (strcmp(name, cores[i].name) == 0) {
+      *core = cores[i].core;
+      return true;
     }
+  }
 
-    return (hi & 1) == 0 ? 2 : 1;
+  return false;
+}
+
+static bool parse_variant(const char* name, enum CpuVariant* variant) {
+  static const struct {
+    const char* name;
+    enum CpuVariant variant;
+  } variants[] = {
+      {"6502", kCpuVariantNmos},
+      {"65c02", kCpuVariant65c02},
+      {"w65c02", kCpuVariantW65c02},
+  };
+
+  for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i) {
+    if (strcmp(name, variants[i].name) == 0) {
+      *variant = variants[i].variant;
+      return true;
+    }
   }
 
-  if (lo == 0x08 || lo == 0x0a) {
-    return 1;
+  return false;
+}
+
+static int parse_addr(const char* s) {
+  if (*s == '$') {
+    ++s;
+  }
+
+  char* end;
+  unsigned long addr = strtoul(s, &end, 16);
+  return *s && !*end && addr <= 0xffff ? (int)addr : -1;
+}
+
+// The banks of the file are paged in at $8000-$BFFF by writing the bank
+// number to $FFE8 and $FFE9.
+#define kBankFirstPage 0x80
+#define kBankNumPages 0x40
+#define kBankControlAddr 0xffe8
+
+static struct Mapper* open_banks(const char* file, struct Bus* bus) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error opening %s\n", file);
+    return NULL;
   }
 
-  if (lo == 0x09 || lo == 0x0b) {
-    return (hi & 1) == 0 ? 2 : 3;
+  struct Mapper* mapper = NULL;
+  off_t size = lseek(fd, 0, SEEK_END);
+  if (size > 0) {
+    mapper = mapper_new(bus, fd, size);
   }
 
-  return 3;
+  close(fd);
+  if (mapper && mapper_add_window(mapper, kBankFirstPage, kBankNumPages,
+                                  kBankControlAddr, true) < 0) {
+    mapper_free(mapper);
+    mapper = NULL;
+  }
+
+  if (!mapper) {
+    fprintf(stderr, "%s does not hold a 16 KiB bank\n", file);
+  }
+
+  return mapper;
 }
 
-static const char status_reg[8] = {
-    'C', 'Z', 'I', 'D', 'B', 'U', 'V', 'N',
-};
+static void print_state(const char* name, const struct Cpu* cpu) {
+  char p[8];
+  format_status_reg(cpu_get_p(cpu), p);
+  fprintf(stderr,
+          "%-6s PC:%04" PRIX16 " A:%02" PRIX8 " X:%02" PRIX8 " Y:%02" PRIX8
+          " S:%02" PRIX8 " P:%c%c%c%c%c%c%c%c cycles:%" PRIu64 "\n",
+          name, cpu->pc, cpu->a, cpu->x, cpu->y, cpu->s, p[7], p[6], p[5],
+          p[4], p[3], p[2], p[1], p[0], cpu->cycles);
+}
 
-static void format_status_reg(u8 p, char buf[8]) {
-  for (int i = 7; i >= 0; --i) {
-    if (p & (1 << i)) {
-      buf[i] = status_reg[i];
-    } else {
-      buf[i] = '.';
+#define kDiffSlice 1000
+
+// Runs the program on core and on the reference table core side by side and
+// compares registers, cycles and memory after every slice of instructions.
+static int run_diff(const struct Rom* rom, enum CpuCore core,
+                    enum CpuVariant variant) {
+  const size_t ram_size = 0x10000;
+  struct BusImpl impls[2] = {0};
+  struct Bus buses[2];
+  struct Cpu cpus[2];
+  int ret = 1;
+
+  // Only the reference prints, neither reads input so that both see the
+  // same.
+  impls[0].ram = calloc(ram_size, sizeof(u8));
+  impls[1].ram = calloc(ram_size, sizeof(u8));
+  impls[0].serial = serial_new(-1, STDOUT_FILENO);
+  impls[1].serial = serial_new(-1, -1);
+  if (!impls[0].ram || !impls[1].ram || !impls[0].serial ||
+      !impls[1].serial) {
+    fprintf(stderr, "memory alloc error\n");
+    goto err;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    buses[i] = (struct Bus){
+        .ctx = impls + i,
+        .read = bus_read,
+        .write = bus_write,
+    };
+
+    bus_map_ram(buses + i, 0x00, 0xff, impls[i].ram);
+    mark_serial_pure(buses + i);
+    rom_load(rom, buses + i, impls[i].ram);
+    cpu_init(cpus + i, buses + i, variant);
+  }
+
+  if (!cpu_set_core(cpus, kCpuCoreTable) || !cpu_set_core(cpus + 1, core)) {
+    fprintf(stderr, "core not available\n");
+    goto out;
+  }
+
+  u64 instructions = 0;
+  for (;;) {
+    struct RunResult expected = cpu_run(cpus, kDiffSlice);
+    struct RunResult actual = cpu_run(cpus + 1, kDiffSlice);
+    instructions += expected.instructions;
+
+    // Cores may notice an idle loop at different points but all stop at the
+    // same limit. Without input an idle program never wakes up.
+    bool idle = expected.reason == kStopReasonIdle ||
+                actual.reason == kStopReasonIdle;
+    if (expected.reason == kStopReasonIdle) {
+      expected.reason = kStopReasonLimit;
+    }
+
+    if (actual.reason == kStopReasonIdle) {
+      actual.reason = kStopReasonLimit;
+    }
+
+    const struct Cpu* a = cpus;
+    const struct Cpu* b = cpus + 1;
+    if (expected.instructions != actual.instructions ||
+        expected.reason != actual.reason || a->pc != b->pc ||
+        a->a != b->a || a->x != b->x || a->y != b->y || a->s != b->s ||
+        cpu_get_p(a) != cpu_get_p(b) || a->cycles != b->cycles ||
+        memcmp(impls[0].ram, impls[1].ram, ram_size) != 0) {
+      fprintf(stderr, "mismatch within %d instructions of %" PRIu64 "\n",
+              kDiffSlice, instructions);
+      print_state("table", a);
+      print_state("core", b);
+      goto out;
+    }
+
+    serial_flush(impls[0].serial);
+    serial_flush(impls[1].serial);
+
+    if (expected.reason == kStopReasonBrk || idle) {
+      break;
     }
   }
+
+  fprintf(stderr, "%" PRIu64 " instructions match\n", instructions);
+  ret = 0;
+out:
+  cpu_destroy(cpus);
+  cpu_destroy(cpus + 1);
+err:
+  serial_free(impls[0].serial);
+  serial_free(impls[1].serial);
+  free(impls[0].ram);
+  free(impls[1].ram);
+  return ret;
 }
 
-#define USAGE "Usage: %s [-d] program_file\n"
+#define kOutputCapacity 0x10000
+
+// About 0.1 s of a 1 MHz 6502.
+#define kSliceCycles 100000
+
+#define kMaxStopPoints 16
+
+// Runs every program on a machine of its own and prints their output in
+// order once all of them are done.
+static int run_batch(char* files[], size_t num_files, unsigned num_threads,
+                     enum CpuVariant variant) {
+  int ret = 1;
+
+  struct BatchJob* jobs = calloc(num_files, sizeof(struct BatchJob));
+  u8* output = malloc(num_files * kOutputCapacity);
+  if (!jobs || !output) {
+    fprintf(stderr, "memory alloc error\n");
+    goto err;
+  }
+
+  for (size_t i = 0; i < num_files; ++i) {
+    jobs[i].rom = open_rom(files[i]);
+    if (!jobs[i].rom) {
+      goto err;
+    }
+
+    jobs[i].variant = variant;
+    jobs[i].output = output + i * kOutputCapacity;
+    jobs[i].output_capacity = kOutputCapacity;
+  }
+
+  if (!batch_run(jobs, num_files, num_threads)) {
+    fprintf(stderr, "batch run failed\n");
+    goto err;
+  }
+
+  for (size_t i = 0; i < num_files; ++i) {
+    printf("==> %s <==\n", files[i]);
+    fwrite(jobs[i].output, 1, jobs[i].output_size, stdout);
+    if (jobs[i].result.reason != kStopReasonBrk) {
+      printf("stopped without BRK at PC %04" PRIX16 "\n", jobs[i].pc);
+    }
+  }
+
+  ret = 0;
+err:
+  for (size_t i = 0; jobs && i < num_files; ++i) {
+    rom_free((struct Rom*)jobs[i].rom);
+  }
+
+  free(output);
+  free(jobs);
+  return ret;
+}
 
 int main(int argc, char* argv[]) {
   bool debug = false;
+  bool diff = false;
+  bool has_core = false;
+  enum CpuCore core = kCpuCoreJit;
+  enum CpuVariant variant = kCpuVariantNmos;
+  unsigned num_threads = 0;
+  const char* trace_file = NULL;
+  const char* bank_file = NULL;
+  bool compressed = false;
+  bool profiling = false;
+  bool strict = false;
+  u16 breakpoints[kMaxStopPoints];
+  size_t num_breakpoints = 0;
+  u16 watchpoints[kMaxStopPoints];
+  size_t num_watchpoints = 0;
 
   int opt;
-  while ((opt = getopt(argc, argv, "d")) != -1) {
+  int addr;
+  while ((opt = getopt(argc, argv, "dxpst:zc:v:b:w:m:j:")) != -1) {
     if (opt == 'd') {
       debug = true;
+    } else if (opt == 'x') {
+      diff = true;
+    } else if (opt == 'p') {
+      profiling = true;
+    } else if (opt == 's') {
+      strict = true;
+    } else if (opt == 't') {
+      trace_file = optarg;
+    } else if (opt == 'z') {
+      compressed = true;
+    } else if (opt == 'c' && parse_core(optarg, &core)) {
+      has_core = true;
+    } else if (opt == 'v' && parse_variant(optarg, &variant)) {
+      continue;
+    } else if (opt == 'b' && num_breakpoints < kMaxStopPoints &&
+               (addr = parse_addr(optarg)) >= 0) {
+      breakpoints[num_breakpoints++] = addr;
+    } else if (opt == 'w' && num_watchpoints < kMaxStopPoints &&
+               (addr = parse_addr(optarg)) >= 0) {
+      watchpoints[num_watchpoints++] = addr;
+    } else if (opt == 'm') {
+      bank_file = optarg;
+    } else if (opt == 'j') {
+      num_threads = strtoul(optarg, NULL, 10);
     } else {
       fprintf(stderr, USAGE, argv[0]);
       return 1;
     }
   }
 
-  if ((argc - optind) != 1) {
+  bool stop_points = num_breakpoints > 0 || num_watchpoints > 0;
+  if ((argc - optind) < 1 || (compressed && !trace_file) ||
+      ((bank_file || stop_points) && diff) ||
+      ((debug || diff || profiling || strict || has_core || trace_file ||
+        bank_file || stop_points) &&
+       (argc - optind) != 1)) {
     fprintf(stderr, USAGE, argv[0]);
     return 1;
   }
 
-  int fd = open(argv[optind], O_RDONLY);
-  if (fd < 0) {
-    fprintf(stderr, "error opening %s\n", argv[optind]);
-    return 2;
+  if ((argc - optind) > 1) {
+    if (num_threads == 0) {
+      long n = sysconf(_SC_NPROCESSORS_ONLN);
+      num_threads = n > 0 ? n : 1;
+    }
+
+    return run_batch(argv + optind, argc - optind, num_threads, variant);
   }
 
-  size_t program_data_size;
-  void* program_data = map_program_file(fd, &program_data_size);
-  if (!program_data) {
-    fprintf(stderr, "error mapping %s\n", argv[optind]);
-    goto err;
+  struct Rom* rom = open_rom(argv[optind]);
+  if (!rom) {
+    return 1;
   }
 
-  const size_t ram_size = 0x10000;
-  if (program_data_size > (ram_size - 0x0200)) {
-    fprintf(stderr, "%s does not fit in RAM\n", argv[optind]);
-    goto err;
+  if (diff) {
+    int ret = run_diff(rom, core, variant);
+    rom_free(rom);
+    return ret;
   }
 
+  // Released at err, where the free functions take NULL and cpu_destroy() a
+  // zeroed CPU.
+  int ret = 1;
+  struct BusImpl bus_impl = {0};
+  struct Cpu cpu = {0};
+  struct Profile* profile = NULL;
+  const size_t ram_size = 0x10000;
   uint8_t* ram = calloc(ram_size, sizeof(uint8_t));
   if (!ram) {
     fprintf(stderr, "memory alloc error\n");
     goto err;
   }
 
-  ram[0xfffc] = 0x00;
-  ram[0xfffd] = 0x02;
-
-  memcpy(ram + 0x0200, program_data, program_data_size);
-  munmap(program_data, program_data_size);
-
-  struct BusImpl bus_impl = {
-      .ram = ram,
-  };
+  bus_impl.ram = ram;
+  bus_impl.serial = serial_new(STDIN_FILENO, STDOUT_FILENO);
+  if (!bus_impl.serial) {
+    fprintf(stderr, "error setting up the serial device\n");
+    goto err;
+  }
 
   struct Bus bus = {
       .ctx = &bus_impl,
@@ -177,54 +646,142 @@ int main(int argc, char* argv[]) {
       .write = bus_write,
   };
 
-  struct Cpu cpu;
-  cpu_init(&cpu, &bus);
+  // Everything but the I/O page is plain RAM, or ROM mapped from the image.
+  bus_map_ram(&bus, 0x00, 0xff, ram);
+  mark_serial_pure(&bus);
+  rom_load(rom, &bus, ram);
+  if (bank_file) {
+    bus_impl.mapper = open_banks(bank_file, &bus);
+    if (!bus_impl.mapper) {
+      goto err;
+    }
+  }
 
-  u16 pc = 0x0200;
-  char p[8];
-  for (;;) {
-    if (bus_impl.io_full) {
-      printf("%c", bus_impl.io_byte);
-      bus_impl.io_full = false;
+  cpu_init(&cpu, &bus, variant);
+  if (has_core && !cpu_set_core(&cpu, core)) {
+    fprintf(stderr, "core not available\n");
+    goto err;
+  }
+
+  cpu_set_strict(&cpu, strict);
+
+  bool armed = true;
+  for (size_t i = 0; i < num_breakpoints; ++i) {
+    armed &= cpu_set_breakpoint(&cpu, breakpoints[i]);
+  }
+
+  for (size_t i = 0; i < num_watchpoints; ++i) {
+    armed &= cpu_set_watchpoint(&cpu, watchpoints[i],
+                                kAccessTypeRead | kAccessTypeWrite);
+  }
+
+  if (!armed) {
+    fprintf(stderr, "memory alloc error\n");
+    goto err;
+  }
+
+  // Traced and profiled runs go through the table core whatever core is set.
+  if (profiling) {
+    profile = profile_new(true);
+    if (!profile) {
+      fprintf(stderr, "memory alloc error\n");
+      goto err;
     }
 
-    u8 opcode = cpu_step(&cpu);
+    cpu_set_profile(&cpu, profile);
+  }
+
+  struct Tracer* tracer = NULL;
+  int trace_fd = -1;
+  if (trace_file) {
+    trace_fd = open(trace_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (trace_fd >= 0) {
+      tracer = tracer_new(trace_fd, compressed, variant);
+    }
+
+    if (!tracer) {
+      fprintf(stderr, "error opening %s\n", trace_file);
+      if (trace_fd >= 0) {
+        close(trace_fd);
+      }
+
+      goto err;
+    }
+
+    cpu_set_tracer(&cpu, tracer);
+  }
+
+  // The serial device is serviced between slices of the run.
+  bool done = false;
+  bool illegal = false;
+  while (!done) {
     if (debug) {
-      u8 num_bytes = instruction_bytes(opcode);
-      fprintf(stderr, "%s", opcode_name(opcode));
-      if (num_bytes >= 2) {
-        fprintf(stderr, " %02" PRIX8, bus.read(&bus_impl, pc + 1));
-      } else {
-        fprintf(stderr, "   ");
+      u16 pc = cpu.pc;
+      u8 opcode = cpu_step(&cpu);
+      print_step(&bus, &cpu, pc, opcode);
+      done = opcode == 0x00 || cpu.jammed || cpu.waiting;
+    } else {
+      enum StopReason reason = cpu_run_cycles(&cpu, kSliceCycles).reason;
+      done = reason == kStopReasonBrk;
+
+      // The run goes on after printing the instruction up next.
+      if (reason == kStopReasonBreakpoint) {
+        fprintf(stderr, "breakpoint at %04" PRIx16 "\n", cpu.pc);
+        print_step(&bus, &cpu, cpu.pc, bus.read(bus.ctx, cpu.pc));
+      } else if (reason == kStopReasonWatchpoint) {
+        fprintf(stderr, "watchpoint %s %04" PRIx16 "\n",
+                cpu.watch_access == kAccessTypeRead ? "read" : "write",
+                cpu.watch_addr);
+        print_step(&bus, &cpu, cpu.pc, bus.read(bus.ctx, cpu.pc));
       }
 
-      if (num_bytes == 3) {
-        fprintf(stderr, " %02" PRIX8, bus.read(&bus_impl, pc + 2));
-      } else {
-        fprintf(stderr, "   ");
+      if (reason == kStopReasonIllegal) {
+        u8 opcode = bus.read(bus.ctx, cpu.pc);
+        fprintf(stderr, "illegal opcode %s (%02" PRIx8 ") at %04" PRIx16 "\n",
+                opcode_name(variant, opcode), opcode, cpu.pc);
+        illegal = true;
+        done = true;
       }
 
-      format_status_reg(cpu.p, p);
-      fprintf(stderr,
-              "  PC:%04" PRIX16 " A:%02" PRIX8 " X:%02" PRIX8 " Y:%02" PRIX8
-              " S:%02" PRIX8 " P:%c%c%c%c%c%c%c%c\n",
-              pc, cpu.a, cpu.x, cpu.y, cpu.s, p[7], p[6], p[5], p[4], p[3],
-              p[2], p[1], p[0]);
-    }
+      // Nothing on this machine raises interrupts, a WAI never ends.
+      if (reason == kStopReasonIdle && cpu.waiting) {
+        fprintf(stderr, "waiting for an interrupt at %04" PRIx16 "\n", cpu.pc);
+        done = true;
+      }
 
-    if (opcode == 0x00) {
-      break;
+      // Sleep while the program polls for input.
+      if (reason == kStopReasonIdle && !done) {
+        serial_flush(bus_impl.serial);
+        if (!serial_wait(bus_impl.serial)) {
+          fprintf(stderr, "waiting for input after the end of input\n");
+          done = true;
+        }
+      }
     }
 
-    pc = cpu.pc;
+    serial_flush(bus_impl.serial);
+    serial_poll(bus_impl.serial);
   }
 
-  free(ram);
-  return 0;
-err:
-  if (program_data) {
-    munmap(program_data, program_data_size);
+  ret = illegal;
+  if (tracer) {
+    cpu_set_tracer(&cpu, NULL);
+    if (!tracer_free(tracer) || close(trace_fd)) {
+      fprintf(stderr, "error writing %s\n", trace_file);
+      ret = 1;
+    }
+  }
+
+  if (profile) {
+    print_profile(profile, variant, &bus);
   }
 
-  return 1;
+err:
+  profile_free(profile);
+  cpu_destroy(&cpu);
+  serial_free(bus_impl.serial);
+  mapper_free(bus_impl.mapper);
+  free(ram);
+  rom_free(rom);
+  return ret;
 }
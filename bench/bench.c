@@ -0,0 +1,364 @@
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "e6502.h"
+
+// All programs are loaded at $0200 and loop forever, the benchmark runs each
+// of them for a fixed number of instructions.
+
+// Tight ALU loop over A with zero page operands.
+static const u8 kProgramAlu[] = {
+    // start:
+    0xa0, 0x00,             // ldy #$00
+    // outer:
+    0xa2, 0x00,             // ldx #$00
+    // inner:
+    0x8a,                   // txa
+    0x65, 0x10,             // adc $10
+    0x45, 0x11,             // eor $11
+    0x85, 0x11,             // sta $11
+    0x0a,                   // asl a
+    0x66, 0x12,             // ror $12
+    0xca,                   // dex
+    0xd0, 0xf3,             // bne inner
+    0x88,                   // dey
+    0xd0, 0xee,             // bne outer
+    0x4c, 0x00, 0x02,       // jmp start
+};
+
+// Copies pages with absolute indexed and indirect indexed addressing.
+static const u8 kProgramCopy[] = {
+    // start:
+    0xa2, 0x00,             // ldx #$00
+    // copy1:
+    0xbd, 0x00, 0x10,       // lda $1000,x
+    0x9d, 0x00, 0x20,       // sta $2000,x
+    0xbd, 0x00, 0x11,       // lda $1100,x
+    0x9d, 0x00, 0x21,       // sta $2100,x
+    0xe8,                   // inx
+    0xd0, 0xf1,             // bne copy1
+    0xa9, 0x00,             // lda #$00
+    0x85, 0x00,             // sta $00
+    0x85, 0x02,             // sta $02
+    0xa9, 0x10,             // lda #$10
+    0x85, 0x01,             // sta $01
+    0xa9, 0x30,             // lda #$30
+    0x85, 0x03,             // sta $03
+    0xa2, 0x04,             // ldx #$04
+    0xa0, 0x00,             // ldy #$00
+    // copy2:
+    0xb1, 0x00,             // lda ($00),y
+    0x91, 0x02,             // sta ($02),y
+    0xc8,                   // iny
+    0xd0, 0xf9,             // bne copy2
+    0xe6, 0x01,             // inc $01
+    0xe6, 0x03,             // inc $03
+    0xca,                   // dex
+    0xd0, 0xf2,             // bne copy2
+    0x4c, 0x00, 0x02,       // jmp start
+};
+
+// Recurses 80 levels deep through JSR/RTS with a push per level.
+static const u8 kProgramRecurse[] = {
+    // start:
+    0xa2, 0xff,             // ldx #$ff
+    0x9a,                   // txs
+    0xa9, 0x50,             // lda #$50
+    0x20, 0x0b, 0x02,       // jsr recurse
+    0x4c, 0x00, 0x02,       // jmp start
+    // recurse:
+    0xf0, 0x08,             // beq done
+    0x48,                   // pha
+    0x38,                   // sec
+    0xe9, 0x01,             // sbc #$01
+    0x20, 0x0b, 0x02,       // jsr recurse
+    0x68,                   // pla
+    // done:
+    0x60,                   // rts
+};
+
+// Bubble sorts 64 pseudo random bytes, refilled on every round.
+static const u8 kProgramSort[] = {
+    0xa9, 0xa5,             // lda #$a5
+    0x85, 0x20,             // sta $20
+    // start:
+    0xa2, 0x3f,             // ldx #$3f
+    // fill:
+    0xa5, 0x20,             // lda $20
+    0x0a,                   // asl a
+    0x90, 0x02,             // bcc nofb
+    0x49, 0x1d,             // eor #$1d
+    // nofb:
+    0x85, 0x20,             // sta $20
+    0x9d, 0x00, 0x10,       // sta $1000,x
+    0xca,                   // dex
+    0x10, 0xf1,             // bpl fill
+    // sort:
+    0xa0, 0x00,             // ldy #$00
+    0xa2, 0x00,             // ldx #$00
+    // pass:
+    0xbd, 0x00, 0x10,       // lda $1000,x
+    0xdd, 0x01, 0x10,       // cmp $1001,x
+    0x90, 0x0f,             // bcc noswap
+    0xf0, 0x0d,             // beq noswap
+    0x48,                   // pha
+    0xbd, 0x01, 0x10,       // lda $1001,x
+    0x9d, 0x00, 0x10,       // sta $1000,x
+    0x68,                   // pla
+    0x9d, 0x01, 0x10,       // sta $1001,x
+    0xa0, 0x01,             // ldy #$01
+    // noswap:
+    0xe8,                   // inx
+    0xe0, 0x3f,             // cpx #$3f
+    0xd0, 0xe4,             // bne pass
+    0x88,                   // dey
+    0xf0, 0xdd,             // beq sort
+    0x4c, 0x04, 0x02,       // jmp start
+};
+
+// 16-bit BCD addition and subtraction with the D flag set.
+static const u8 kProgramDecimal[] = {
+    0xa9, 0x37,             // lda #$37
+    0x85, 0x40,             // sta $40
+    0xa9, 0x12,             // lda #$12
+    0x85, 0x41,             // sta $41
+    0xa9, 0x19,             // lda #$19
+    0x85, 0x42,             // sta $42
+    0xa9, 0x04,             // lda #$04
+    0x85, 0x43,             // sta $43
+    0xf8,                   // sed
+    // start:
+    0x18,                   // clc
+    0xa5, 0x30,             // lda $30
+    0x65, 0x40,             // adc $40
+    0x85, 0x30,             // sta $30
+    0xa5, 0x31,             // lda $31
+    0x65, 0x41,             // adc $41
+    0x85, 0x31,             // sta $31
+    0x38,                   // sec
+    0xa5, 0x32,             // lda $32
+    0xe5, 0x42,             // sbc $42
+    0x85, 0x32,             // sta $32
+    0xa5, 0x33,             // lda $33
+    0xe5, 0x43,             // sbc $43
+    0x85, 0x33,             // sta $33
+    0x4c, 0x11, 0x02,       // jmp start
+};
+
+// The decimal kernel with the D flag clear, to compare binary and decimal
+// arithmetic.
+static const u8 kProgramBinary[] = {
+    0xa9, 0x37,             // lda #$37
+    0x85, 0x40,             // sta $40
+    0xa9, 0x12,             // lda #$12
+    0x85, 0x41,             // sta $41
+    0xa9, 0x19,             // lda #$19
+    0x85, 0x42,             // sta $42
+    0xa9, 0x04,             // lda #$04
+    0x85, 0x43,             // sta $43
+    0xd8,                   // cld
+    // start:
+    0x18,                   // clc
+    0xa5, 0x30,             // lda $30
+    0x65, 0x40,             // adc $40
+    0x85, 0x30,             // sta $30
+    0xa5, 0x31,             // lda $31
+    0x65, 0x41,             // adc $41
+    0x85, 0x31,             // sta $31
+    0x38,                   // sec
+    0xa5, 0x32,             // lda $32
+    0xe5, 0x42,             // sbc $42
+    0x85, 0x32,             // sta $32
+    0xa5, 0x33,             // lda $33
+    0xe5, 0x43,             // sbc $43
+    0x85, 0x33,             // sta $33
+    0x4c, 0x11, 0x02,       // jmp start
+};
+
+struct Workload {
+  const char* name;
+  const u8* program;
+  size_t program_size;
+};
+
+#define WORKLOAD(name, program) {name, program, sizeof(program)}
+
+static const struct Workload workloads[] = {
+    WORKLOAD("alu", kProgramAlu),
+    WORKLOAD("copy", kProgramCopy),
+    WORKLOAD("recurse", kProgramRecurse),
+    WORKLOAD("sort", kProgramSort),
+    WORKLOAD("binary", kProgramBinary),
+    WORKLOAD("decimal", kProgramDecimal),
+};
+
+#define NUM_WORKLOADS (sizeof(workloads) / sizeof(workloads[0]))
+
+struct Config {
+  const char* name;
+  enum CpuCore core;
+  bool paged;
+};
+
+static const struct Config configs[] = {
+    {"table/callback", kCpuCoreTable, false},
+    {"table/paged", kCpuCoreTable, true},
+    {"fused/callback", kCpuCoreFused, false},
+    {"fused/paged", kCpuCoreFused, true},
+    {"block/callback", kCpuCoreBlock, false},
+    {"block/paged", kCpuCoreBlock, true},
+    {"jit/callback", kCpuCoreJit, false},
+    {"jit/paged", kCpuCoreJit, true},
+};
+
+#define NUM_CONFIGS (sizeof(configs) / sizeof(configs[0]))
+
+static u8 bus_read(void* ctx, u16 address) {
+  u8* ram = ctx;
+  return ram[address];
+}
+
+static void bus_write(void* ctx, u16 address, u8 data) {
+  u8* ram = ctx;
+  ram[address] = data;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char* const reason_names[] = {
+    [kStopReasonLimit] = "limit",
+    [kStopReasonBrk] = "brk",
+    [kStopReasonTrap] = "trap",
+    [kStopReasonHost] = "host",
+    [kStopReasonIdle] = "idle",
+    [kStopReasonIllegal] = "illegal",
+    [kStopReasonBreakpoint] = "breakpoint",
+    [kStopReasonWatchpoint] = "watchpoint",
+};
+
+// Returns 0 if the core is not available and a negative time if the
+// workload stopped before running all instructions.
+static double run_workload(const struct Workload* workload,
+                           const struct Config* config, u8* ram,
+                           u64 num_instructions) {
+  memset(ram, 0, 0x10000);
+  memcpy(ram + 0x0200, workload->program, workload->program_size);
+  ram[0xfffc] = 0x00;
+  ram[0xfffd] = 0x02;
+
+  struct Bus bus = {
+      .ctx = ram,
+      .read = bus_read,
+      .write = bus_write,
+  };
+
+  if (config->paged) {
+    bus_map_ram(&bus, 0x00, 0x100, ram);
+  }
+
+  struct Cpu cpu;
+  cpu_init(&cpu, &bus, kCpuVariantNmos);
+  if (!cpu_set_core(&cpu, config->core)) {
+    cpu_destroy(&cpu);
+    return 0.0;
+  }
+
+  // The workloads loop forever, any other stop than the limit means that the
+  // core went astray and might not make progress again.
+  double start = now();
+  for (u64 n = 0; n < num_instructions;) {
+    struct RunResult result = cpu_run(&cpu, num_instructions - n);
+    n += result.instructions;
+    if (result.reason != kStopReasonLimit) {
+      fprintf(stderr, "%s on %s stopped by %s at $%04" PRIX16 "\n",
+              workload->name, config->name, reason_names[result.reason],
+              cpu.pc);
+      cpu_destroy(&cpu);
+      return -1.0;
+    }
+  }
+
+  double seconds = now() - start;
+  cpu_destroy(&cpu);
+  return seconds;
+}
+
+static bool selected(const struct Workload* workload, int argc, char* argv[]) {
+  if (argc == 0) {
+    return true;
+  }
+
+  for (int i = 0; i < argc; ++i) {
+    if (strcmp(argv[i], workload->name) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+#define USAGE "Usage: %s [-n instructions] [workload...]\n"
+
+int main(int argc, char* argv[]) {
+  u64 num_instructions = 20000000;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:")) != -1) {
+    if (opt == 'n') {
+      num_instructions = strtoull(optarg, NULL, 0);
+    } else {
+      fprintf(stderr, USAGE, argv[0]);
+      return 1;
+    }
+  }
+
+  u8* ram = malloc(0x10000);
+  if (!ram) {
+    fprintf(stderr, "memory alloc error\n");
+    return 1;
+  }
+
+  int ret = 0;
+  printf("%-10s %-16s %10s %10s\n", "workload", "config", "MIPS",
+         "ns/instr");
+  for (size_t i = 0; i < NUM_WORKLOADS; ++i) {
+    const struct Workload* workload = workloads + i;
+    if (!selected(workload, argc - optind, argv + optind)) {
+      continue;
+    }
+
+    for (size_t j = 0; j < NUM_CONFIGS; ++j) {
+      double seconds =
+          run_workload(workload, configs + j, ram, num_instructions);
+      if (seconds == 0.0) {
+        printf("%-10s %-16s %10s\n", workload->name, configs[j].name,
+               "n/a");
+        continue;
+      }
+
+      if (seconds < 0.0) {
+        printf("%-10s %-16s %10s\n", workload->name, configs[j].name,
+               "failed");
+        ret = 1;
+        continue;
+      }
+
+      printf("%-10s %-16s %10.1f %10.2f\n", workload->name, configs[j].name,
+             num_instructions / seconds * 1e-6,
+             seconds * 1e9 / num_instructions);
+    }
+  }
+
+  free(ram);
+  return ret;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -9,41 +10,629 @@ extern "C" {
 
 typedef uint8_t u8;
 typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
 
-const char* opcode_name(u8 opcode);
+// Instruction sets. The 65C02 adds BRA, PHX, PHY, PLX, PLY, STZ, TRB, TSB,
+// INC A, DEC A, more BIT modes and (zp) addressing, fixes JMP ($xxFF), clears
+// D when taking an interrupt and takes a cycle more for ADC and SBC in decimal
+// mode, which set N and Z from the result there. Its unused opcodes are NOPs.
+// The W65C02 also has BBR, BBS, RMB, SMB, WAI and STP.
+enum CpuVariant {
+  kCpuVariantNmos,
+  kCpuVariant65c02,
+  kCpuVariantW65c02,
+};
+
+#define kNumCpuVariants 3
+
+const char* opcode_name(enum CpuVariant variant, u8 opcode);
+
+// Length of the instruction, undocumented opcodes included.
+u8 opcode_bytes(enum CpuVariant variant, u8 opcode);
+
+enum AddrMode {
+  kAddrModeImplied,
+  kAddrModeImm,
+  kAddrModeZp,
+  kAddrModeZpx,
+  kAddrModeZpy,
+  kAddrModeRel,
+  kAddrModeAbs,
+  kAddrModeAbx,
+  kAddrModeAby,
+  kAddrModeInd,
+  kAddrModeIzx,
+  kAddrModeIzy,
+  // 65C02 only, (zp), JMP (abs,x) and the zero page and branch offset of BBR
+  // and BBS.
+  kAddrModeIzp,
+  kAddrModeIax,
+  kAddrModeZpr,
+};
+
+#define kNumAddrModes 15
+
+// Accumulator forms of the shifts, rotates and 65C02 INC and DEC are implied.
+enum AddrMode opcode_addr_mode(enum CpuVariant variant, u8 opcode);
+
+// What an instruction does at its effective address.
+enum OpcodeAccess {
+  kOpcodeAccessNone,
+  kOpcodeAccessRead,
+  kOpcodeAccessWrite,
+  kOpcodeAccessRmw,
+};
+
+struct OpcodeInfo {
+  const char* name;
+  u8 addr_mode;  // enum AddrMode
+  u8 access;     // enum OpcodeAccess
+  u8 bytes;
+  // Without the page crossing cycle and the branch penalties.
+  u8 cycles;
+  bool page_cycle;
+  bool documented;
+  // False for the undocumented opcodes whose result varies between chips and
+  // for the JAMs, see cpu_set_strict().
+  bool stable;
+};
 
+const struct OpcodeInfo* opcode_info(enum CpuVariant variant, u8 opcode);
+
+// Bits of Cpu.interrupts.
 enum InterruptType {
-  kInterruptTypeNone,
-  kInterruptTypeNmi,
-  kInterruptTypeIrq,
+  kInterruptTypeNone = 0,
+  kInterruptTypeNmi = 1 << 0,
+  kInterruptTypeIrq = 1 << 1,
 };
 
+enum StopReason {
+  kStopReasonLimit,
+  kStopReasonBrk,
+  kStopReasonTrap,
+  kStopReasonHost,
+  // The limit was reached in a loop that only polls memory without side
+  // effects, its iterations were skipped, or while waiting in WAI without an
+  // event to wake it before the limit. Nothing changes until an event, an
+  // interrupt or the host changes what it polls, so the host may wait for I/O
+  // before running on. Runs with a tracer, profile or coverage attached never
+  // skip loops.
+  kStopReasonIdle,
+  // The PC is at a JAM or STP, which lock up the CPU, or in strict mode at an
+  // unstable opcode. Running on stops there again.
+  kStopReasonIllegal,
+  // The PC is at a breakpoint, see cpu_set_breakpoint().
+  kStopReasonBreakpoint,
+  // The last instruction accessed a watched address, see Cpu.watch_access.
+  kStopReasonWatchpoint,
+};
+
+enum AccessType {
+  kAccessTypeNone = 0,
+  kAccessTypeRead = 1 << 0,
+  kAccessTypeWrite = 1 << 1,
+};
+
+// The table core is the reference implementation, the fused core is the fast
+// one. The block core runs the table core's ops from predecoded basic blocks,
+// the JIT core additionally translates hot blocks to native code where the
+// jit build option is enabled. The default is picked by the core build option.
+enum CpuCore {
+  kCpuCoreTable,
+  kCpuCoreFused,
+  kCpuCoreBlock,
+  kCpuCoreJit,
+};
+
+struct RunResult {
+  u64 instructions;
+  u64 cycles;
+  enum StopReason reason;
+};
+
+#define kBusMaxPureReads 8
+
 struct Bus {
   void* ctx;
 
   u8 (*read)(void* ctx, u16 addr);
   void (*write)(void* ctx, u16 addr, u8 data);
+
+  // Optional page table indexed by the high byte of the address. Pages with
+  // a non-NULL entry are accessed directly, all other accesses go through
+  // read and write above. A page mapped only for reading is ROM, writes to it
+  // still reach the write callback.
+  const u8* read_pages[256];
+  u8* write_pages[256];
+
+  // Set for every page the CPU writes to, mapped or not. Only the host clears
+  // it, see bus_clear_dirty() and bus_reset_dirty().
+  bool dirty[256];
+
+  // Addresses handled by the read callback whose reads have no side effects,
+  // see bus_add_pure_read().
+  u16 pure_reads[kBusMaxPureReads];
+  u8 num_pure_reads;
 };
 
+void bus_map_ram(struct Bus* bus, u8 first_page, u16 num_pages, u8* mem);
+
+void bus_map_rom(struct Bus* bus, u8 first_page, u16 num_pages,
+                 const u8* mem);
+
+void bus_unmap(struct Bus* bus, u8 first_page, u16 num_pages);
+
+// Marks reads of addr through the read callback as free of side effects, such
+// as those of a status register. Loops are only skipped as idle if they read
+// nothing but mapped memory and such addresses, see kStopReasonIdle. Returns
+// false if kBusMaxPureReads addresses are already marked.
+bool bus_add_pure_read(struct Bus* bus, u16 addr);
+
+void bus_clear_dirty(struct Bus* bus);
+
+// Copies the dirty pages mapped for writing back from baseline, an image of
+// all 64 KiB, and clears their flags. Dirty pages handled by the write
+// callback are left flagged for the host. Blocks decoded from restored pages
+// are stale, see cpu_flush_blocks(). Returns the number of pages restored.
+size_t bus_reset_dirty(struct Bus* bus, const u8* baseline);
+
+struct PageRange {
+  u8 first_page;
+  u16 num_pages;
+};
+
+// Fills ranges, which has room for the at most 128 there can be, with the
+// runs of dirty pages in address order and returns their number.
+size_t bus_dirty_ranges(const struct Bus* bus, struct PageRange* ranges);
+
+// Encodes the bytes of the dirty pages mapped for reading that differ from
+// before, an image of all 64 KiB taken when the flags were last cleared. Each
+// record is a little endian address, the length minus one and that many bytes
+// of data, records do not cross pages. Returns the size of the whole diff,
+// which is only written to out if it fits in capacity.
+size_t bus_diff(const struct Bus* bus, const u8* before, u8* out,
+                size_t capacity);
+
+// Applies a diff made by bus_diff() through the page table or the write
+// callback, flagging the pages written dirty. Returns false if it is
+// malformed, after applying the records before the bad one.
+bool bus_patch(struct Bus* bus, const u8* diff, size_t size);
+
+// A program image mapped from a file. Plain binaries load at $0200 with the
+// reset vector pointing there. Images with an e6502 ROM header or in the o65
+// format place their segments and vectors themselves, see src/rom.c. An image
+// may be loaded into any number of machines and must outlive them.
+struct Rom;
+
+// Maps the file read-only, the fd may be closed afterwards. Returns NULL if
+// the image is not valid or does not fit in 64 KiB.
+struct Rom* rom_new(int fd);
+
+void rom_free(struct Rom* rom);
+
+// Loads the image into a machine with 64 KiB of ram. Read-only segments that
+// cover whole pages the bus maps to ram are mapped straight from the file
+// instead, so that machines share the page cache copy. All other segments,
+// including those over pages handled by the bus callbacks, are copied into
+// ram, and so are the vectors.
+void rom_load(const struct Rom* rom, struct Bus* bus, u8* ram);
+
+// Banked storage larger than the 64 KiB address space, seen through windows
+// of whole pages. Selecting a bank swaps the window's page table entries, no
+// memory is copied. The block and JIT cores tell the banks apart, but code in
+// a bank mapped by two windows at once must be flushed with cpu_flush_blocks()
+// after writing it through the other window.
+struct Mapper;
+
+// The storage is a private copy-on-write mapping of the first size bytes of
+// the file, or zero filled memory allocated as it is touched if fd is -1.
+// The fd may be closed afterwards. Returns NULL if the file is too short.
+struct Mapper* mapper_new(struct Bus* bus, int fd, size_t size);
+
+void mapper_free(struct Mapper* mapper);
+
+u8* mapper_storage(const struct Mapper* mapper);
+
+size_t mapper_size(const struct Mapper* mapper);
+
+// Adds a window showing bank 0, banks are num_pages long and laid out back to
+// back in the storage. Writes to control and control + 1 select the low and
+// high byte of the bank, both must be on pages handled by the bus callbacks.
+// Returns the index of the window, or -1 if it does not fit.
+int mapper_add_window(struct Mapper* mapper, u8 first_page, u8 num_pages,
+                      u16 control, bool writable);
+
+// Banks past the end of the storage wrap around.
+void mapper_select(struct Mapper* mapper, int window, u16 bank);
+
+u16 mapper_bank(const struct Mapper* mapper, int window);
+
+// To be called first by the bus write callback. Returns true if the write
+// was to a control register.
+bool mapper_write(struct Mapper* mapper, u16 addr, u8 data);
+
+#define kMaxCallbackReads 4
+
 struct Cpu {
   u8 a;
   u8 x;
   u8 y;
   u8 s;
-  u8 p;
+  u8 p;  // Only I, D, B and U, use cpu_get_p() for the full register.
   u16 pc;
 
-  const struct Bus* bus;
-  enum InterruptType interrupt;
+  u8 flag_n;
+  u8 flag_z;
+  u8 flag_c;
+  u8 flag_v;
+
+  struct Bus* bus;
+  enum CpuVariant variant;
+  // The instruction table of the variant, see instr.c.
+  const struct Instruction* instructions;
+  // An NMI waiting to be taken and whether the IRQ line is held.
+  u8 interrupts;
+  // Set by WAI until an interrupt is raised, which wakes the CPU even while I
+  // is set. No instructions run meanwhile but time passes up to the next
+  // event.
+  bool waiting;
+  enum CpuCore core;
+
+  bool trap_enabled;
+  u16 trap;
+  bool stop_requested;
+  bool strict;
+  // Set when the last run or step hit a JAM or STP.
+  bool jammed;
+  // The first access of the last run or step that hit a watchpoint.
+  u8 watch_access;
+  u16 watch_addr;
+
+  struct BlockCache* blocks;
+  struct Tracer* tracer;
+  struct Profile* profile;
+  u8* coverage;
+  struct EventQueue* events;
+  // Breakpoints, watchpoints and host traps, NULL until one is set.
+  struct StopPoints* stops;
+
+  // Cycles executed since cpu_init(), including page crossing and taken
+  // branch penalties.
+  u64 cycles;
+
+  // The first addresses read through the callback since the last check for
+  // an idle loop, which only skips loops that read nothing but those marked
+  // with bus_add_pure_read().
+  u16 callback_reads[kMaxCallbackReads];
+  u64 num_callback_reads;
+  // Set by a branch taken back to or before itself.
+  bool closed_loop;
 };
 
-bool cpu_init(struct Cpu* cpu, const struct Bus* bus);
+bool cpu_init(struct Cpu* cpu, struct Bus* bus, enum CpuVariant variant);
+
+// Frees what cpu_init() and cpu_set_core() allocated.
+void cpu_destroy(struct Cpu* cpu);
+
+// Switch cores through here rather than by setting core, the block and JIT
+// cores allocate their caches. Returns false if that fails or if the JIT core
+// is not available in this build.
+bool cpu_set_core(struct Cpu* cpu, enum CpuCore core);
+
+// The block core notices writes made by the CPU to memory it has decoded
+// code from. Call this after changing such memory from the host.
+void cpu_flush_blocks(struct Cpu* cpu);
 
 void cpu_reset(struct Cpu* cpu);
 
+// Always executes through the reference table core. Due events fire and a
+// pending interrupt is taken first. A CPU waiting in WAI executes nothing,
+// returns the WAI opcode and skips ahead to the next event.
 u8 cpu_step(struct Cpu* cpu);
 
-// TODO: Interrupts
+// Runs at most max_instructions instructions. Stops early after a BRK, when
+// the PC reaches the trap address or a breakpoint, on a watchpoint or when
+// cpu_stop() has been called, e.g. from a bus callback. Interrupts are taken
+// and scheduled events fire between instructions without stopping the run.
+struct RunResult cpu_run(struct Cpu* cpu, u64 max_instructions);
+
+// Like cpu_run() but limited by cycles instead of instructions. The last
+// instruction may overshoot the budget, the overshoot is reported in the
+// result and carried over in the cycle counter.
+struct RunResult cpu_run_cycles(struct Cpu* cpu, u64 budget);
+
+// N, Z, C and V are evaluated lazily, these read and write the complete
+// status register.
+u8 cpu_get_p(const struct Cpu* cpu);
+
+void cpu_set_p(struct Cpu* cpu, u8 p);
+
+void cpu_stop(struct Cpu* cpu);
+
+void cpu_set_trap(struct Cpu* cpu, u16 addr);
+
+void cpu_clear_trap(struct Cpu* cpu);
+
+// In strict mode runs stop before unstable undocumented opcodes instead of
+// emulating them, see OpcodeInfo. Strict runs go through the table core.
+void cpu_set_strict(struct Cpu* cpu, bool strict);
+
+// A program run by batch_run() on a machine of its own: 64 KiB of RAM with
+// the program loaded at $0200 and the reset vector pointing there, or with
+// the image rom loaded if set. Bytes written to $FFE1 are captured in output,
+// reading $FFE0 returns 0. This is the same machine as the e6502 app.
+struct BatchJob {
+  const u8* program;
+  size_t program_size;
+  const struct Rom* rom;
+  enum CpuVariant variant;
+
+  // Zero means no limit. The job always stops after a BRK.
+  u64 max_instructions;
+  u64 max_cycles;
+
+  // Optional, output that does not fit is dropped.
+  u8* output;
+  size_t output_capacity;
+
+  // Filled in by batch_run().
+  struct RunResult result;
+  size_t output_size;
+  bool output_truncated;
+  u16 pc;
+  u8 a;
+  u8 x;
+  u8 y;
+  u8 s;
+  u8 p;
+};
+
+// Runs all jobs on num_threads worker threads, the calling thread included.
+// Jobs are split evenly up front and idle workers steal from busy ones.
+// Returns false if a program does not fit in RAM, nothing is run then, or if
+// memory runs out.
+bool batch_run(struct BatchJob* jobs, size_t num_jobs, unsigned num_threads);
+
+// In-process fuzzing of a program on the machine of the e6502 app. Every run
+// starts from reset with the image freshly loaded, only the pages the last
+// run wrote to are copied back. The guest reads its input through the serial
+// registers at $FFE0, reading past its end stops the run with
+// kStopReasonHost. Output is dropped. Runs collect coverage and go through the
+// table core, see cpu_set_coverage().
+struct Fuzzer;
+
+// The image must outlive the fuzzer. coverage may be NULL. Returns NULL if out
+// of memory.
+struct Fuzzer* fuzzer_new(const struct Rom* rom, enum CpuVariant variant,
+                          u8* coverage);
+
+void fuzzer_free(struct Fuzzer* fuzzer);
+
+// Zero max_cycles means no limit. The run always stops after a BRK.
+struct RunResult fuzzer_run(struct Fuzzer* fuzzer, const u8* input,
+                            size_t size, u64 max_cycles);
+
+// 64 KiB of RAM made of pages that snapshots share copy-on-write. A new
+// memory is all zeros and shares a single zero page. Shared pages are mapped
+// read only into the bus so that writes to them reach the write callback,
+// which must pass them on to memory_write(). Page references are counted
+// atomically, memories forked from one snapshot may run on different threads.
+struct Memory;
+
+struct Memory* memory_new(void);
+
+void memory_free(struct Memory* mem);
+
+// Maps the pages into the bus page table and keeps them mapped as they are
+// copied. A memory can be mapped into one bus only.
+void memory_map(struct Memory* mem, struct Bus* bus, u8 first_page,
+                u16 num_pages);
+
+u8 memory_read(const struct Memory* mem, u16 addr);
+
+// Copies the page first if it is shared. Returns false if that fails.
+bool memory_write(struct Memory* mem, u16 addr, u8 data);
+
+bool memory_load(struct Memory* mem, u16 addr, const u8* data, size_t size);
+
+// Registers, flags, pending interrupts, cycle counter and memory. Scheduled
+// events are not part of it.
+struct Snapshot;
+
+// Shares the pages of mem with the snapshot. Returns NULL if out of memory.
+struct Snapshot* snapshot_take(const struct Cpu* cpu, struct Memory* mem);
+
+void snapshot_free(struct Snapshot* snapshot);
+
+// Shares the pages of the snapshot with mem, dropping its own. Restoring into
+// a new memory forks the machine, restoring into the one the snapshot was
+// taken from rewinds it. The bus, core, traps, breakpoints and block cache of
+// the CPU are kept, the blocks are flushed.
+void snapshot_restore(const struct Snapshot* snapshot, struct Cpu* cpu,
+                      struct Memory* mem);
+
+// Buffered serial device. Bytes sent by the guest are queued and written to
+// the output fd in bulk when the queue fills up or serial_flush() is called.
+// Input is read without blocking by serial_poll() into a queue the guest
+// reads from. Either fd may be -1, output is then dropped or there is no
+// input. Call serial_flush() and serial_poll() from the host loop between
+// runs, not per instruction.
+struct Serial;
+
+// Register offsets from where the host maps the device, $FFE0 in the e6502
+// app.
+enum SerialRegister {
+  // Non-zero while the output queue is full. It only fills up if writing to
+  // the output fd fails, programs written for the unbuffered device that
+  // wait for zero here keep working.
+  kSerialStatus,
+  // Writes queue a byte for output, reads take a byte of input or 0.
+  kSerialData,
+  // Bytes waiting in the input and output queues, saturated at 255.
+  kSerialRxDepth,
+  kSerialTxDepth,
+};
+
+#define kSerialNumRegisters 4
+
+// Puts in_fd in non-blocking mode until serial_free(). Returns NULL if that
+// fails or if out of memory.
+struct Serial* serial_new(int in_fd, int out_fd);
+
+// Flushes the remaining output.
+void serial_free(struct Serial* serial);
+
+u8 serial_read(struct Serial* serial, u8 reg);
+
+void serial_write(struct Serial* serial, u8 reg, u8 data);
+
+// Returns false if writing failed, the output stays queued then.
+bool serial_flush(struct Serial* serial);
+
+void serial_poll(struct Serial* serial);
+
+// Returns at once while input is queued, otherwise blocks until input is
+// ready to be polled. Returns false if the queue is empty and there is no more
+// input.
+bool serial_wait(struct Serial* serial);
+
+// Binary instruction trace. Every instruction becomes a fixed size record of
+// its PC, opcode and operand bytes as fetched, followed by A, X, Y, S and P
+// after it executed and the cycles it took. Records are collected in chunks
+// that a background thread writes to the fd, optionally delta compressed.
+// The e6502-trace tool decodes traces. A tracer belongs to one CPU and is
+// filled by the thread running it. CPUs with a tracer always run through the
+// table core, the other cores have no tracing overhead.
+struct Tracer;
+
+#define kTraceRecordSize 11
+
+// Writes the file header, which records the variant that decides the
+// instruction lengths. Returns NULL if that fails or if out of memory.
+struct Tracer* tracer_new(int fd, bool compressed, enum CpuVariant variant);
+
+// Writes the remaining records and stops the writer thread. Returns false if
+// any write failed.
+bool tracer_free(struct Tracer* tracer);
+
+// NULL stops tracing.
+void cpu_set_tracer(struct Cpu* cpu, struct Tracer* tracer);
+
+// Execution profile of a CPU. Every instruction adds one to the counters of
+// its PC and opcode, and optionally its cycles to those of its PC, counts per
+// addressing mode follow from the opcodes with opcode_addr_mode(). Calls are
+// followed from JSR to the RTS that returns past its stack frame, so that
+// returns skipped by unwinding the stack by hand are still matched. CPUs with
+// a profile run through the table core like those with a tracer.
+struct ProfileCall {
+  u16 site;  // Address of the JSR.
+  u16 target;
+  u64 calls;
+  // From the JSR up to the RTS, including callees. Recursive calls are
+  // counted from the outermost one.
+  u64 cycles;
+  u32 active;
+};
+
+#define kProfileMaxCalls 4096
+// Every frame takes two bytes of the stack page.
+#define kProfileMaxDepth 128
+
+struct ProfileFrame {
+  u32 call;
+  u8 s;
+  u64 cycles;
+};
+
+struct Profile {
+  bool count_cycles;
+
+  u64 instructions[0x10000];
+  u64 cycles[0x10000];
+  u64 opcodes[256];
+
+  // Open addressed by site and target, free entries have no calls. Calls
+  // made once the table is full are only counted in dropped_calls.
+  struct ProfileCall calls[kProfileMaxCalls];
+  u64 dropped_calls;
+
+  // Calls that have not returned yet, the innermost last.
+  struct ProfileFrame frames[kProfileMaxDepth];
+  u32 depth;
+};
+
+// All counters start at zero. Returns NULL if out of memory.
+struct Profile* profile_new(bool count_cycles);
+
+void profile_free(struct Profile* profile);
+
+// NULL stops profiling. The profile may be read between runs.
+void cpu_set_profile(struct Cpu* cpu, struct Profile* profile);
+
+// Edge coverage in the style of AFL. Branches, whether taken or not, JMP and
+// JSR add one to the counter of a hash of the address after the instruction
+// and where execution continues. Counters wrap. CPUs collecting coverage run
+// through the table core like those with a tracer.
+#define kCoverageSize 0x10000
+
+// NULL stops collecting, otherwise coverage has kCoverageSize counters.
+void cpu_set_coverage(struct Cpu* cpu, u8* coverage);
+
+// Taking an interrupt pushes the PC and P, sets I and jumps through the
+// vector at $FFFA for NMI and $FFFE for IRQ, which takes 7 cycles. Running
+// cores finish the current instruction first.
+void cpu_nmi(struct Cpu* cpu);
+
+// The IRQ line is level triggered, it is taken whenever I is clear until the
+// device releases it.
+void cpu_set_irq(struct Cpu* cpu, bool asserted);
+
+// Device callbacks run between instructions, they may raise interrupts and
+// schedule further events.
+typedef void (*EventFn)(struct Cpu* cpu, void* ctx);
+
+// Calls fn once the cycle counter reaches cycles, an absolute count like
+// Cpu.cycles. The instruction that crosses the deadline is completed first.
+// Events due at the same cycle fire in the order they were scheduled.
+// Returns false if out of memory.
+bool cpu_schedule(struct Cpu* cpu, u64 cycles, EventFn fn, void* ctx);
+
+// Drops every scheduled call of fn with ctx.
+void cpu_cancel(struct Cpu* cpu, EventFn fn, void* ctx);
+
+// Breakpoints, watchpoints and host traps are kept in bitmaps per page, runs
+// only pay for the pages that have some set. The set functions return false
+// if out of memory.
+
+// Stops runs with kStopReasonBreakpoint when the PC reaches addr. Checked
+// after every instruction like the trap, so a run started there resumes.
+bool cpu_set_breakpoint(struct Cpu* cpu, u16 addr);
+
+void cpu_clear_breakpoint(struct Cpu* cpu, u16 addr);
+
+// Stops runs with kStopReasonWatchpoint after an instruction that reads or
+// writes addr, as selected by the AccessType bits in access. Instruction
+// fetches count as reads. Runs go through the table core while watchpoints
+// are set, only accesses to watched pages are slowed down further.
+bool cpu_set_watchpoint(struct Cpu* cpu, u16 addr, u8 access);
+
+void cpu_clear_watchpoint(struct Cpu* cpu, u16 addr, u8 access);
+
+// Runs in place of the guest code at the address of a host trap, usually a
+// native version of a subroutine. It updates memory, registers and cycles as
+// the subroutine would and returns with cpu_rts(). If it leaves the PC
+// unchanged the guest code runs instead. It may call cpu_stop().
+typedef void (*HostTrapFn)(struct Cpu* cpu, void* ctx);
+
+// Calls fn whenever a run reaches addr, including a run started there.
+// Replaces the host trap already set at addr.
+bool cpu_set_host_trap(struct Cpu* cpu, u16 addr, HostTrapFn fn, void* ctx);
+
+void cpu_clear_host_trap(struct Cpu* cpu, u16 addr);
+
+// Pulls the return address off the stack as RTS does, taking its 6 cycles.
+void cpu_rts(struct Cpu* cpu);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,221 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#define kRamSize 0x10000
+#define kLoadAddr 0x0200
+
+// Every worker owns a contiguous range of job indices. It takes jobs from the
+// front of its own range and, once that is empty, steals the back half of
+// another worker's range.
+struct Worker {
+  pthread_t thread;
+  bool started;
+  pthread_mutex_t lock;
+  size_t begin;
+  size_t end;
+
+  struct Batch* batch;
+  size_t id;
+};
+
+struct Batch {
+  struct BatchJob* jobs;
+  struct Worker* workers;
+  size_t num_workers;
+};
+
+struct Machine {
+  u8* ram;
+  struct BatchJob* job;
+};
+
+static u8 machine_read(void* ctx, u16 addr) {
+  struct Machine* machine = ctx;
+  if (addr == 0xffe0) {
+    return 0;
+  }
+
+  return machine->ram[addr];
+}
+
+static void machine_write(void* ctx, u16 addr, u8 data) {
+  struct Machine* machine = ctx;
+  if (addr != 0xffe1) {
+    machine->ram[addr] = data;
+    return;
+  }
+
+  struct BatchJob* job = machine->job;
+  if (job->output_size < job->output_capacity) {
+    job->output[job->output_size++] = data;
+  } else {
+    job->output_truncated = true;
+  }
+}
+
+static void run_job(struct Machine* machine, struct Bus* bus,
+                    struct BatchJob* job) {
+  // Everything but the I/O page is plain RAM, unless the last job mapped ROM.
+  memset(machine->ram, 0, kRamSize);
+  bus_map_ram(bus, 0x00, 0xff, machine->ram);
+  if (job->rom) {
+    rom_load(job->rom, bus, machine->ram);
+  } else {
+    memcpy(machine->ram + kLoadAddr, job->program, job->program_size);
+    machine->ram[0xfffc] = kLoadAddr & 0x00ff;
+    machine->ram[0xfffd] = kLoadAddr >> 8;
+  }
+
+  machine->job = job;
+
+  job->output_size = 0;
+  job->output_truncated = false;
+
+  struct Cpu cpu;
+  cpu_init(&cpu, bus, job->variant);
+
+  u64 max_instructions = job->max_instructions ? job->max_instructions
+                                               : UINT64_MAX;
+  u64 max_cycles = job->max_cycles ? job->max_cycles : UINT64_MAX;
+  job->result = run_until(&cpu, max_instructions, max_cycles);
+
+  job->pc = cpu.pc;
+  job->a = cpu.a;
+  job->x = cpu.x;
+  job->y = cpu.y;
+  job->s = cpu.s;
+  job->p = cpu_get_p(&cpu);
+
+  cpu_destroy(&cpu);
+}
+
+static bool take(struct Worker* worker, size_t* index) {
+  pthread_mutex_lock(&worker->lock);
+  bool taken = worker->begin < worker->end;
+  if (taken) {
+    *index = worker->begin++;
+  }
+
+  pthread_mutex_unlock(&worker->lock);
+  return taken;
+}
+
+static bool steal(struct Worker* thief) {
+  struct Batch* batch = thief->batch;
+  for (size_t i = 1; i < batch->num_workers; ++i) {
+    struct Worker* victim =
+        batch->workers + (thief->id + i) % batch->num_workers;
+
+    pthread_mutex_lock(&victim->lock);
+    size_t left = victim->end - victim->begin;
+    size_t end = victim->end;
+    victim->end -= (left + 1) / 2;
+    size_t begin = victim->end;
+    pthread_mutex_unlock(&victim->lock);
+
+    if (begin < end) {
+      pthread_mutex_lock(&thief->lock);
+      thief->begin = begin;
+      thief->end = end;
+      pthread_mutex_unlock(&thief->lock);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void* worker_main(void* arg) {
+  struct Worker* worker = arg;
+
+  u8* ram = malloc(kRamSize);
+  if (!ram) {
+    return NULL;
+  }
+
+  struct Machine machine = {
+      .ram = ram,
+  };
+
+  struct Bus bus = {
+      .ctx = &machine,
+      .read = machine_read,
+      .write = machine_write,
+  };
+
+  do {
+    size_t index;
+    while (take(worker, &index)) {
+      run_job(&machine, &bus, worker->batch->jobs + index);
+    }
+  } while (steal(worker));
+
+  free(ram);
+  return NULL;
+}
+
+bool batch_run(struct BatchJob* jobs, size_t num_jobs, unsigned num_threads) {
+  for (size_t i = 0; i < num_jobs; ++i) {
+    if (!jobs[i].rom && jobs[i].program_size > kRamSize - kLoadAddr) {
+      return false;
+    }
+  }
+
+  if (num_threads > num_jobs) {
+    num_threads = num_jobs;
+  }
+
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+
+  struct Worker* workers = calloc(num_threads, sizeof(struct Worker));
+  if (!workers) {
+    return false;
+  }
+
+  struct Batch batch = {
+      .jobs = jobs,
+      .workers = workers,
+      .num_workers = num_threads,
+  };
+
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers[i].batch = &batch;
+    workers[i].id = i;
+    workers[i].begin = num_jobs * i / num_threads;
+    workers[i].end = num_jobs * (i + 1) / num_threads;
+    pthread_mutex_init(&workers[i].lock, NULL);
+  }
+
+  // The calling thread is worker 0 and steals the jobs of any worker that
+  // fails to start.
+  for (size_t i = 1; i < num_threads; ++i) {
+    workers[i].started = !pthread_create(&workers[i].thread, NULL,
+                                         worker_main, workers + i);
+  }
+
+  worker_main(workers);
+
+  for (size_t i = 1; i < num_threads; ++i) {
+    if (workers[i].started) {
+      pthread_join(workers[i].thread, NULL);
+    }
+  }
+
+  // Jobs are only left over if a worker could not allocate its RAM.
+  bool done = true;
+  for (size_t i = 0; i < num_threads; ++i) {
+    done &= workers[i].begin >= workers[i].end;
+    pthread_mutex_destroy(&workers[i].lock);
+  }
+
+  free(workers);
+  return done;
+}
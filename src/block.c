@@ -0,0 +1,511 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+// Block core. The first time the PC reaches an address the straight-line run
+// of instructions starting there is decoded into a block, later visits execute
+// the ops of the table core directly from the decoded records without fetching
+// and decoding through the bus again. Blocks end at the first instruction that
+// changes the PC or at the end of the page, and are only decoded from pages in
+// the read page table so that fetching has no side effects.
+
+#define kNumBlocks 1024
+
+// Executions before the JIT core translates a block.
+#define kJitThreshold 32
+
+// Pages invalidated this often are treated as self-modifying and stay with
+// the interpreter.
+#define kJitMaxGeneration 64
+
+struct BlockCache* block_cache_new(void) {
+  struct BlockCache* cache = calloc(1, sizeof(struct BlockCache));
+  if (!cache) {
+    return NULL;
+  }
+
+  cache->blocks = calloc(kNumBlocks, sizeof(struct Block));
+  if (!cache->blocks) {
+    free(cache);
+    return NULL;
+  }
+
+  return cache;
+}
+
+void block_cache_free(struct BlockCache* cache) {
+  if (cache) {
+    block_cache_set_jit(cache, false);
+    free(cache->blocks);
+    free(cache);
+  }
+}
+
+bool block_cache_set_jit(struct BlockCache* cache, bool enabled) {
+#if defined(E6502_JIT)
+  if (enabled && !cache->jit) {
+    cache->jit = jit_new();
+  }
+
+  if (!enabled && cache->jit) {
+    for (int i = 0; i < kNumBlocks; ++i) {
+      cache->blocks[i].native = NULL;
+      cache->blocks[i].executions = 0;
+      cache->blocks[i].translated = false;
+    }
+
+    jit_free(cache->jit);
+    cache->jit = NULL;
+  }
+
+  return cache->jit != NULL || !enabled;
+#else
+  return !enabled;
+#endif
+}
+
+void block_cache_flush(struct BlockCache* cache) {
+  for (int i = 0; i < 256; ++i) {
+    if (cache->code[i]) {
+      cache->code[i] = false;
+      ++cache->generation[i];
+    }
+  }
+}
+
+static bool ends_block(const struct Instruction* instr,
+                       enum AddrMode addr_mode) {
+  return addr_mode == kAddrModeRel || addr_mode == kAddrModeZpr ||
+         instr->op_impl == op_brk || instr->op_impl == op_jmp ||
+         instr->op_impl == op_jsr || instr->op_impl == op_rti ||
+         instr->op_impl == op_rts || instr->op_impl == op_jam ||
+         instr->op_impl == op_wai;
+}
+
+static bool may_idle(const struct Block* block, u16 end) {
+  const struct BlockInstruction* last = block->instructions + block->count - 1;
+  u16 target;
+  if (last->addr_mode == kAddrModeRel) {
+    target = end + last->operand;
+  } else if (last->addr_mode == kAddrModeZpr) {
+    u16 offset = last->operand >> 8;
+    target = end + (offset & 0x0080 ? offset | 0xff00 : offset);
+  } else {
+    return false;
+  }
+
+  if (target != block->pc) {
+    return false;
+  }
+
+  for (u8 i = 0; i + 1 < block->count; ++i) {
+    const struct BlockInstruction* instr = block->instructions + i;
+    if (!reads_only(instr->op_impl, instr->addr_mode)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static u16 resolve_operand(enum AddrMode addr_mode, u16 pc, u16 operand) {
+  switch (addr_mode) {
+    case kAddrModeImm:
+      return pc + 1;
+    case kAddrModeRel:
+      return operand & 0x0080 ? operand | 0xff00 : operand;
+    default:
+      return operand;
+  }
+}
+
+static struct Block* decode(struct Cpu* cpu, struct Block* block) {
+  u16 pc = cpu->pc;
+  const u8* page = cpu->bus->read_pages[pc >> 8];
+  if (!page) {
+    return NULL;
+  }
+
+  u8 count = 0;
+  u16 max_cycles = 0;
+  u16 offset = pc & 0x00ff;
+  while (count < kMaxBlockInstructions) {
+    u8 opcode = page[offset];
+    const struct Instruction* instr = cpu->instructions + opcode;
+    const struct OpcodeInfo* info = opcode_info(cpu->variant, opcode);
+    enum AddrMode addr_mode = info->addr_mode;
+    u8 length = info->bytes;
+    if (offset + length > 0x0100) {
+      break;
+    }
+
+    u16 operand = 0;
+    if (length >= 2) {
+      operand = page[offset + 1];
+    }
+
+    if (length == 3) {
+      operand |= page[offset + 2] << 8;
+    }
+
+    block->instructions[count++] = (struct BlockInstruction){
+        .op_impl = instr->op_impl,
+        .operand = resolve_operand(addr_mode, (pc & 0xff00) | offset, operand),
+        .addr_mode = addr_mode,
+        .length = length,
+        .cycles = instr->cycles,
+        .page_cycle = instr->page_cycle,
+    };
+
+    max_cycles += instr->cycles + instr->page_cycle;
+    if (addr_mode == kAddrModeRel || addr_mode == kAddrModeZpr) {
+      max_cycles += 2;
+    }
+
+    // Decimal mode on the 65C02.
+    if (cpu->variant != kCpuVariantNmos &&
+        (instr->op_impl == op_adc || instr->op_impl == op_sbc)) {
+      ++max_cycles;
+    }
+
+    offset += length;
+    if (ends_block(instr, addr_mode)) {
+      break;
+    }
+  }
+
+  if (count == 0) {
+    return NULL;
+  }
+
+  struct BlockCache* cache = cpu->blocks;
+  cache->code[pc >> 8] = true;
+
+  block->page = page;
+  block->generation = cache->generation[pc >> 8];
+  block->pc = pc;
+  block->count = count;
+  block->max_cycles = max_cycles;
+  block->native = NULL;
+  block->executions = 0;
+  block->translated = false;
+  block->may_idle = may_idle(block, (pc & 0xff00) + offset);
+  block->idle_cycles = 0;
+  return block;
+}
+
+static struct Block* lookup(struct Cpu* cpu) {
+  u16 pc = cpu->pc;
+  struct Block* block = cpu->blocks->blocks + (pc & (kNumBlocks - 1));
+  if (block->count && block->pc == pc &&
+      block->page == cpu->bus->read_pages[pc >> 8] &&
+      block->generation == cpu->blocks->generation[pc >> 8]) {
+    return block;
+  }
+
+  return decode(cpu, block);
+}
+
+// Mirrors the addressing modes in instr.c, the operand bytes come from the
+// block instead of the bus.
+static bool effective_addr(struct Cpu* cpu,
+                           const struct BlockInstruction* instr, u16* addr) {
+  u16 operand = instr->operand;
+  switch (instr->addr_mode) {
+    case kAddrModeZpx:
+      *addr = (operand + cpu->x) & 0x00ff;
+      return false;
+    case kAddrModeZpy:
+      *addr = (operand + cpu->y) & 0x00ff;
+      return false;
+    case kAddrModeAbx:
+      *addr = operand + cpu->x;
+      return (*addr & 0xff00) != (operand & 0xff00);
+    case kAddrModeAby:
+      *addr = operand + cpu->y;
+      return (*addr & 0xff00) != (operand & 0xff00);
+    case kAddrModeInd: {
+      u16 hi = operand + 1;
+      if (cpu->variant == kCpuVariantNmos) {
+        hi = (operand & 0xff00) | (hi & 0x00ff);
+      }
+
+      *addr = (bus_load(cpu, hi) << 8) | bus_load(cpu, operand);
+      return false;
+    }
+    case kAddrModeIax: {
+      u16 base = operand + cpu->x;
+      *addr = (bus_load(cpu, base + 1) << 8) | bus_load(cpu, base);
+      return false;
+    }
+    case kAddrModeIzx: {
+      u16 lo = bus_load(cpu, (operand + cpu->x) & 0x00ff);
+      u16 hi = bus_load(cpu, (operand + cpu->x + 1) & 0x00ff);
+      *addr = (hi << 8) | lo;
+      return false;
+    }
+    case kAddrModeIzy: {
+      u16 lo = bus_load(cpu, operand);
+      u16 hi = bus_load(cpu, (operand + 1) & 0x00ff);
+      u16 base = (hi << 8) | lo;
+      *addr = base + cpu->y;
+      return (*addr & 0xff00) != (base & 0xff00);
+    }
+    case kAddrModeIzp: {
+      u16 lo = bus_load(cpu, operand);
+      u16 hi = bus_load(cpu, (operand + 1) & 0x00ff);
+      *addr = (hi << 8) | lo;
+      return false;
+    }
+    default:
+      *addr = operand;
+      return false;
+  }
+}
+
+#if defined(E6502_JIT)
+static void translate(struct BlockCache* cache, struct Block* block,
+                      enum CpuVariant variant) {
+  if (cache->generation[block->pc >> 8] >= kJitMaxGeneration) {
+    block->translated = true;
+    return;
+  }
+
+  block->native = jit_translate(cache->jit, block, variant);
+  if (block->native || !jit_full(cache->jit)) {
+    block->translated = true;
+    return;
+  }
+
+  // Out of code space, start over and translate again once blocks are hot.
+  for (int i = 0; i < kNumBlocks; ++i) {
+    cache->blocks[i].native = NULL;
+    cache->blocks[i].executions = 0;
+    cache->blocks[i].translated = false;
+  }
+
+  jit_reset(cache->jit);
+}
+
+// Whether a breakpoint or host trap is set past the first byte of a block of
+// length bytes.
+static bool exec_stop_within(const struct StopPoints* stops, u16 pc,
+                             u16 length) {
+  for (u16 i = 1; i < length; ++i) {
+    u16 addr = pc + i;
+    if (!stops->exec.pages[addr >> 8]) {
+      i += 0xff - (addr & 0x00ff);
+    } else if (addr_set_has(&stops->exec, addr)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Native code runs without the per instruction checks, so it is only entered
+// when no limit, trap or breakpoint can trigger before its last instruction.
+static bool native_fits(const struct Cpu* cpu, const struct Block* block,
+                        u64 instructions, u64 max_instructions,
+                        u64 max_cycles) {
+  if (max_instructions - instructions < block->count) {
+    return false;
+  }
+
+  if (max_cycles - cpu->cycles <= block->max_cycles) {
+    return false;
+  }
+
+  u16 end = block->pc;
+  for (u8 i = 0; i < block->count; ++i) {
+    end += block->instructions[i].length;
+  }
+
+  if (cpu->stops && exec_stop_within(cpu->stops, block->pc,
+                                     (u16)(end - block->pc))) {
+    return false;
+  }
+
+  return !cpu->trap_enabled || cpu->trap <= block->pc || cpu->trap >= end;
+}
+#endif
+
+// Called when a block that may idle branched back to its start after running
+// from start_cycles. Once an iteration leaves the registers as the previous one
+// did, every further iteration reads and does the same until a device or the
+// host changes what the loop reads. That only holds if the reads have no side
+// effects, so the iteration must not have read through the callback other than
+// from addresses marked with bus_add_pure_read(). Such iterations are skipped,
+// stopping short of the limits so that the run ends exactly where it would
+// have. A trap within the loop stops every iteration before it gets here.
+// Returns true if the loop idles.
+static bool skip_idle(struct Cpu* cpu, struct Block* block, u64 start_cycles,
+                      u64 max_instructions, u64 max_cycles,
+                      struct RunResult* result) {
+  u8 regs[5] = {cpu->a, cpu->x, cpu->y, cpu->s, pack_flags(cpu)};
+  bool idle = callback_reads_pure(cpu) &&
+              block->idle_cycles == start_cycles &&
+              memcmp(regs, block->idle_regs, sizeof(regs)) == 0;
+
+  block->idle_cycles = cpu->cycles;
+  memcpy(block->idle_regs, regs, sizeof(regs));
+  if (!idle) {
+    return false;
+  }
+
+  u64 cycles = cpu->cycles - start_cycles;
+  u64 skip = (max_cycles - cpu->cycles - 1) / cycles;
+  u64 instructions = (max_instructions - result->instructions - 1) /
+                     block->count;
+  if (instructions < skip) {
+    skip = instructions;
+  }
+
+  cpu->cycles += skip * cycles;
+  result->instructions += skip * block->count;
+  block->idle_cycles = cpu->cycles;
+  return true;
+}
+
+struct RunResult block_run(struct Cpu* cpu, u64 max_instructions,
+                           u64 max_cycles) {
+  struct RunResult result = {
+      .instructions = 0,
+      .cycles = 0,
+      .reason = kStopReasonLimit,
+  };
+
+  u64 start_cycles = cpu->cycles;
+  if (run_should_start(cpu, cpu->p, cpu->cycles, max_instructions,
+                       max_cycles, &result)) {
+    return result;
+  }
+
+  struct BlockCache* cache = cpu->blocks;
+  bool idle = false;
+  for (;;) {
+    struct Block* block = lookup(cpu);
+    if (!block) {
+      u8 opcode = execute(cpu);
+      ++result.instructions;
+
+      if (opcode == 0x00) {
+        result.reason = kStopReasonBrk;
+        break;
+      }
+
+      if (run_should_stop(cpu, cpu->p, cpu->pc, cpu->cycles,
+                          max_instructions, max_cycles, &result)) {
+        break;
+      }
+
+      continue;
+    }
+
+    u64 block_cycles = cpu->cycles;
+    if (block->may_idle) {
+      cpu->num_callback_reads = 0;
+    }
+
+    u8 first = 0;
+#if defined(E6502_JIT)
+    if (cache->jit) {
+      if (!block->translated && ++block->executions >= kJitThreshold) {
+        translate(cache, block, cpu->variant);
+      }
+
+      if (block->native && native_fits(cpu, block, result.instructions,
+                                       max_instructions, max_cycles)) {
+        u32 n = block->native(cpu);
+        result.instructions += n;
+        if (n > 0 &&
+            run_should_stop(cpu, cpu->p, cpu->pc, cpu->cycles,
+                            max_instructions, max_cycles, &result)) {
+          break;
+        }
+
+        if (n == block->count) {
+          if (block->may_idle && cpu->pc == block->pc) {
+            idle |= skip_idle(cpu, block, block_cycles, max_instructions,
+                              max_cycles, &result);
+          }
+
+          continue;
+        }
+
+        // The native code stopped early, either at an instruction it does not
+        // translate or at a memory access it leaves to the interpreter. Loops
+        // that may idle are finished by the interpreter so that skip_idle()
+        // sees whole iterations.
+        if (!block->may_idle) {
+          u8 opcode = execute(cpu);
+          ++result.instructions;
+
+          if (opcode == 0x00) {
+            result.reason = kStopReasonBrk;
+            break;
+          }
+
+          if (run_should_stop(cpu, cpu->p, cpu->pc, cpu->cycles,
+                              max_instructions, max_cycles, &result)) {
+            break;
+          }
+
+          continue;
+        }
+
+        first = n;
+      }
+    }
+#endif
+
+    u8 page = block->pc >> 8;
+    u8 i = first;
+    for (; i < block->count; ++i) {
+      const struct BlockInstruction* instr = block->instructions + i;
+      cpu->pc += instr->length;
+      cpu->cycles += instr->cycles;
+
+      u16 addr;
+      if (effective_addr(cpu, instr, &addr) && instr->page_cycle) {
+        ++cpu->cycles;
+      }
+
+      instr->op_impl(cpu, addr, instr->addr_mode == kAddrModeImplied);
+      ++result.instructions;
+
+      if (instr->op_impl == op_brk) {
+        result.reason = kStopReasonBrk;
+        goto out;
+      }
+
+      if (run_should_stop(cpu, cpu->p, cpu->pc, cpu->cycles,
+                          max_instructions, max_cycles, &result)) {
+        goto out;
+      }
+
+      // The rest of the block is stale if the instruction wrote to its page or
+      // had the page remapped.
+      if (block->generation != cache->generation[page] ||
+          block->page != cpu->bus->read_pages[page]) {
+        break;
+      }
+    }
+
+    if (i == block->count && block->may_idle && cpu->pc == block->pc) {
+      idle |= skip_idle(cpu, block, block_cycles, max_instructions,
+                        max_cycles, &result);
+    }
+  }
+
+out:
+  // Running into a limit while idle tells the host that it may wait for I/O.
+  if (idle && result.reason == kStopReasonLimit) {
+    result.reason = kStopReasonIdle;
+  }
+
+  result.cycles = cpu->cycles - start_cycles;
+  return result;
+}
@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "e6502.h"
+
+static size_t clamp_pages(u8 first_page, u16 num_pages) {
+  size_t last = (size_t)first_page + num_pages;
+  return last > 256 ? 256 - first_page : num_pages;
+}
+
+void bus_map_ram(struct Bus* bus, u8 first_page, u16 num_pages, u8* mem) {
+  size_t n = clamp_pages(first_page, num_pages);
+  for (size_t i = 0; i < n; ++i) {
+    bus->read_pages[first_page + i] = mem + (i << 8);
+    bus->write_pages[first_page + i] = mem + (i << 8);
+  }
+}
+
+void bus_map_rom(struct Bus* bus, u8 first_page, u16 num_pages,
+                 const u8* mem) {
+  size_t n = clamp_pages(first_page, num_pages);
+  for (size_t i = 0; i < n; ++i) {
+    bus->read_pages[first_page + i] = mem + (i << 8);
+    bus->write_pages[first_page + i] = NULL;
+  }
+}
+
+void bus_unmap(struct Bus* bus, u8 first_page, u16 num_pages) {
+  size_t n = clamp_pages(first_page, num_pages);
+  for (size_t i = 0; i < n; ++i) {
+    bus->read_pages[first_page + i] = NULL;
+    bus->write_pages[first_page + i] = NULL;
+  }
+}
+
+bool bus_add_pure_read(struct Bus* bus, u16 addr) {
+  if (bus->num_pure_reads == kBusMaxPureReads) {
+    return false;
+  }
+
+  bus->pure_reads[bus->num_pure_reads++] = addr;
+  return true;
+}
+
+void bus_clear_dirty(struct Bus* bus) {
+  memset(bus->dirty, 0, sizeof(bus->dirty));
+}
+
+size_t bus_reset_dirty(struct Bus* bus, const u8* baseline) {
+  size_t restored = 0;
+  for (int page = 0; page < 256; ++page) {
+    if (bus->dirty[page] && bus->write_pages[page]) {
+      memcpy(bus->write_pages[page], baseline + (page << 8), 0x100);
+      bus->dirty[page] = false;
+      ++restored;
+    }
+  }
+
+  return restored;
+}
+
+size_t bus_dirty_ranges(const struct Bus* bus, struct PageRange* ranges) {
+  size_t n = 0;
+  for (int page = 0; page < 256; ++page) {
+    if (!bus->dirty[page]) {
+      continue;
+    }
+
+    if (n > 0 && ranges[n - 1].first_page + ranges[n - 1].num_pages == page) {
+      ++ranges[n - 1].num_pages;
+    } else {
+      ranges[n++] = (struct PageRange){.first_page = page, .num_pages = 1};
+    }
+  }
+
+  return n;
+}
+
+// A record costs 3 bytes on top of its data, so runs at most that many bytes
+// apart are merged.
+#define kDiffHeaderSize 3
+
+size_t bus_diff(const struct Bus* bus, const u8* before, u8* out,
+                size_t capacity) {
+  size_t size = 0;
+  for (int page = 0; page < 256; ++page) {
+    const u8* mem = bus->read_pages[page];
+    if (!bus->dirty[page] || !mem) {
+      continue;
+    }
+
+    const u8* old = before + (page << 8);
+    int i = 0;
+    while (i < 0x100) {
+      if (mem[i] == old[i]) {
+        ++i;
+        continue;
+      }
+
+      int begin = i;
+      int end = ++i;
+      while (i < 0x100 && i - end <= kDiffHeaderSize) {
+        if (mem[i] != old[i]) {
+          end = i + 1;
+        }
+
+        ++i;
+      }
+
+      i = end;
+      size_t len = end - begin;
+      if (size + kDiffHeaderSize + len <= capacity) {
+        u16 addr = page << 8 | begin;
+        out[size] = addr & 0x00ff;
+        out[size + 1] = addr >> 8;
+        out[size + 2] = len - 1;
+        memcpy(out + size + kDiffHeaderSize, mem + begin, len);
+      }
+
+      size += kDiffHeaderSize + len;
+    }
+  }
+
+  return size;
+}
+
+bool bus_patch(struct Bus* bus, const u8* diff, size_t size) {
+  size_t pos = 0;
+  while (pos < size) {
+    if (size - pos < kDiffHeaderSize) {
+      return false;
+    }
+
+    u16 addr = diff[pos] | diff[pos + 1] << 8;
+    size_t len = (size_t)diff[pos + 2] + 1;
+    const u8* data = diff + pos + kDiffHeaderSize;
+    if (size - pos - kDiffHeaderSize < len || (addr & 0x00ff) + len > 0x100) {
+      return false;
+    }
+
+    u8 page = addr >> 8;
+    bus->dirty[page] = true;
+    if (bus->write_pages[page]) {
+      memcpy(bus->write_pages[page] + (addr & 0x00ff), data, len);
+    } else {
+      for (size_t i = 0; i < len; ++i) {
+        bus->write(bus->ctx, addr + i, data[i]);
+      }
+    }
+
+    pos += kDiffHeaderSize + len;
+  }
+
+  return true;
+}
@@ -1,52 +1,225 @@
 #include "cpu.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
-bool get_flag(const struct Cpu* cpu, enum Flag flag) {
-  return (cpu->p & flag) != 0;
-}
+bool cpu_init(struct Cpu* cpu, struct Bus* bus, enum CpuVariant variant) {
+  if (!cpu || !bus || (unsigned)variant >= kNumCpuVariants) {
+    return false;
+  }
 
-void set_flag(struct Cpu* cpu, enum Flag flag, bool value) {
-  if (value) {
-    cpu->p |= flag;
-  } else {
-    cpu->p &= ~flag;
+  cpu->bus = bus;
+  cpu->variant = variant;
+  cpu->instructions = instructions[variant];
+  cpu->interrupts = kInterruptTypeNone;
+  cpu->trap_enabled = false;
+  cpu->trap = 0;
+  cpu->stop_requested = false;
+  cpu->strict = false;
+  cpu->jammed = false;
+  cpu->watch_access = kAccessTypeNone;
+  cpu->watch_addr = 0;
+  cpu->cycles = 0;
+  cpu->blocks = NULL;
+  cpu->tracer = NULL;
+  cpu->profile = NULL;
+  cpu->coverage = NULL;
+  cpu->events = NULL;
+  cpu->stops = NULL;
+#if defined(E6502_CORE_TABLE)
+  enum CpuCore core = kCpuCoreTable;
+#elif defined(E6502_CORE_BLOCK)
+  enum CpuCore core = kCpuCoreBlock;
+#else
+  enum CpuCore core = kCpuCoreFused;
+#endif
+
+  cpu->core = core;
+  if (core == kCpuCoreBlock) {
+    // Without a cache the block core runs as the table core.
+    cpu->blocks = block_cache_new();
   }
-}
 
-u8 read(const struct Cpu* cpu, u16 addr) {
-  return cpu->bus->read(cpu->bus->ctx, addr);
-}
+  cpu_reset(cpu);
 
-void write(const struct Cpu* cpu, u16 addr, u8 data) {
-  cpu->bus->write(cpu->bus->ctx, addr, data);
+  return true;
 }
 
-const char* opcode_name(u8 opcode) { return (instructions + opcode)->name; }
-
-bool cpu_init(struct Cpu* cpu, const struct Bus* bus) {
-  if (!cpu || !bus) {
-    return false;
+void cpu_destroy(struct Cpu* cpu) {
+  if (!cpu) {
+    return;
   }
 
-  cpu->bus = bus;
-  cpu->interrupt = kInterruptTypeNone;
+  block_cache_free(cpu->blocks);
+  cpu->blocks = NULL;
+  event_queue_free(cpu->events);
+  cpu->events = NULL;
+  stop_points_free(cpu->stops);
+  cpu->stops = NULL;
+}
 
-  cpu_reset(cpu);
+bool cpu_set_core(struct Cpu* cpu, enum CpuCore core) {
+  if (core == kCpuCoreBlock || core == kCpuCoreJit) {
+    // The other cores do not invalidate blocks, start over.
+    if (cpu->blocks) {
+      block_cache_flush(cpu->blocks);
+    } else {
+      cpu->blocks = block_cache_new();
+    }
+
+    if (!cpu->blocks) {
+      return false;
+    }
 
+    if (!block_cache_set_jit(cpu->blocks, core == kCpuCoreJit)) {
+      return false;
+    }
+  } else {
+    block_cache_free(cpu->blocks);
+    cpu->blocks = NULL;
+  }
+
+  cpu->core = core;
   return true;
 }
 
+void cpu_flush_blocks(struct Cpu* cpu) {
+  if (cpu->blocks) {
+    block_cache_flush(cpu->blocks);
+  }
+}
+
 void cpu_reset(struct Cpu* cpu) {
   cpu->a = 0;
   cpu->x = 0;
   cpu->y = 0;
   cpu->s = 0xfd;
-  cpu->p = 0x24;
+  unpack_flags(cpu, 0x24);
+  cpu->waiting = false;
+
+  u16 lo = bus_load(cpu, 0xfffc);
+  u16 hi = bus_load(cpu, 0xfffd);
+  cpu->pc = (hi << 8) | lo;
+}
+
+void cpu_set_tracer(struct Cpu* cpu, struct Tracer* tracer) {
+  cpu->tracer = tracer;
+}
+
+void cpu_set_profile(struct Cpu* cpu, struct Profile* profile) {
+  cpu->profile = profile;
+}
+
+void cpu_set_coverage(struct Cpu* cpu, u8* coverage) {
+  cpu->coverage = coverage;
+}
+
+static u8 instrumented_step(struct Cpu* cpu) {
+  u16 pc = cpu->pc;
+  u64 start_cycles = cpu->cycles;
+  if (cpu->tracer) {
+    trace_begin(cpu->tracer, cpu);
+  }
+
+  u8 opcode = execute(cpu);
+  if (cpu->tracer) {
+    trace_end(cpu->tracer, cpu);
+  }
+
+  if (cpu->profile) {
+    profile_count(cpu->profile, cpu, pc, opcode, start_cycles);
+  }
+
+  return opcode;
+}
+
+static inline u8 step(struct Cpu* cpu) {
+  if (!cpu->tracer && !cpu->profile) {
+    return execute(cpu);
+  }
+
+  return instrumented_step(cpu);
+}
+
+void cpu_nmi(struct Cpu* cpu) { cpu->interrupts |= kInterruptTypeNmi; }
+
+void cpu_set_irq(struct Cpu* cpu, bool asserted) {
+  if (asserted) {
+    cpu->interrupts |= kInterruptTypeIrq;
+  } else {
+    cpu->interrupts &= ~kInterruptTypeIrq;
+  }
+}
 
-  u16 lo = read(cpu, 0xfffc);
-  u16 hi = read(cpu, 0xfffd);
+// Like BRK but with B clear in the pushed P and without skipping a byte. Also
+// ends a WAI.
+static void take_interrupt(struct Cpu* cpu) {
+  u16 vector = 0xfffe;
+  if (cpu->interrupts & kInterruptTypeNmi) {
+    cpu->interrupts &= ~kInterruptTypeNmi;
+    vector = 0xfffa;
+  }
+
+  bus_store(cpu, 0x0100 + cpu->s--, (cpu->pc >> 8) & 0x00ff);
+  bus_store(cpu, 0x0100 + cpu->s--, cpu->pc & 0x00ff);
+  bus_store(cpu, 0x0100 + cpu->s--, pack_flags(cpu) & ~kFlagBreak);
+  set_flag(cpu, kFlagInterrupt, true);
+  if (cpu->variant != kCpuVariantNmos) {
+    set_flag(cpu, kFlagDecimal, false);
+  }
+
+  cpu->waiting = false;
+
+  u16 lo = bus_load(cpu, vector);
+  u16 hi = bus_load(cpu, vector + 1);
   cpu->pc = (hi << 8) | lo;
+  cpu->cycles += 7;
+}
+
+// Runs the device events due by now and then takes an interrupt they or
+// earlier instructions left ready.
+static void service(struct Cpu* cpu) {
+  fire_events(cpu);
+  if (interrupt_ready(cpu, cpu->p)) {
+    take_interrupt(cpu);
+  }
+}
+
+// An interrupt raised while I is set wakes a CPU waiting in WAI without being
+// taken. Otherwise time passes up to the next event, which may raise one, or
+// up to max_cycles. Returns false if still waiting.
+static bool wake(struct Cpu* cpu, u64 max_cycles) {
+  if (cpu->interrupts != kInterruptTypeNone) {
+    cpu->waiting = false;
+    return true;
+  }
+
+  u64 deadline = next_event(cpu);
+  if (deadline > max_cycles) {
+    deadline = max_cycles;
+  }
+
+  if (deadline != UINT64_MAX && deadline > cpu->cycles) {
+    cpu->cycles = deadline;
+  }
+
+  return false;
+}
+
+// Watchpoint hits are recorded by the watch bus and copied out when the run
+// or step ends.
+static void clear_watch_hit(struct Cpu* cpu) {
+  cpu->watch_access = kAccessTypeNone;
+  if (cpu->stops) {
+    cpu->stops->hit_access = kAccessTypeNone;
+  }
+}
+
+static void report_watch_hit(struct Cpu* cpu) {
+  if (cpu->stops) {
+    cpu->watch_access = cpu->stops->hit_access;
+    cpu->watch_addr = cpu->stops->hit_addr;
+  }
 }
 
 u8 cpu_step(struct Cpu* cpu) {
@@ -54,17 +227,230 @@ u8 cpu_step(struct Cpu* cpu) {
     return 0;
   }
 
-  u8 opcode = read(cpu, cpu->pc++);
   set_flag(cpu, KFlagUnused, 1);
+  cpu->jammed = false;
+  clear_watch_hit(cpu);
+  service(cpu);
+  if (cpu->waiting && !wake(cpu, UINT64_MAX)) {
+    return 0xcb;  // WAI
+  }
 
-  struct Instruction* instr = instructions + opcode;
-  bool implied = !instr->addr_mode;
-
-  u16 addr = 0;
-  if (!implied) {
-    instr->addr_mode(cpu, &addr);
+  if (!watching(cpu)) {
+    return step(cpu);
   }
 
-  instr->op_impl(cpu, addr, implied);
+  watch_begin(cpu);
+  u8 opcode = step(cpu);
+  watch_end(cpu);
+  report_watch_hit(cpu);
   return opcode;
 }
+
+static struct RunResult table_run(struct Cpu* cpu, u64 max_instructions,
+                                  u64 max_cycles) {
+  struct RunResult result = {
+      .instructions = 0,
+      .cycles = 0,
+      .reason = kStopReasonLimit,
+  };
+
+  u64 start_cycles = cpu->cycles;
+  if (run_should_start(cpu, cpu->p, cpu->cycles, max_instructions,
+                       max_cycles, &result)) {
+    return result;
+  }
+
+  // Skipped iterations would be missing from traces, profiles and coverage.
+  bool detect_idle = !cpu->tracer && !cpu->profile && !cpu->coverage;
+  struct IdleLoop loop = {0};
+  cpu->closed_loop = false;
+  for (;;) {
+    if (cpu->strict &&
+        !opcode_info(cpu->variant, bus_load(cpu, cpu->pc))->stable) {
+      result.reason = kStopReasonIllegal;
+      break;
+    }
+
+    u8 opcode = step(cpu);
+    ++result.instructions;
+
+    if (opcode == 0x00) {
+      result.reason = kStopReasonBrk;
+      break;
+    }
+
+    if (run_should_stop(cpu, cpu->p, cpu->pc, cpu->cycles,
+                        max_instructions, max_cycles, &result)) {
+      break;
+    }
+
+    if (cpu->closed_loop) {
+      cpu->closed_loop = false;
+      if (detect_idle && idle_candidate(&loop, cpu->pc)) {
+        result.instructions +=
+            idle_branch(cpu, &loop, result.instructions, max_instructions,
+                        max_cycles);
+      }
+    }
+  }
+
+  // Running into a limit while idle tells the host that it may wait for I/O.
+  if (loop.idle && result.reason == kStopReasonLimit) {
+    result.reason = kStopReasonIdle;
+  }
+
+  result.cycles = cpu->cycles - start_cycles;
+  return result;
+}
+
+static struct RunResult core_run(struct Cpu* cpu, u64 max_instructions,
+                                 u64 max_cycles) {
+  if (watching(cpu)) {
+    watch_begin(cpu);
+    struct RunResult result = table_run(cpu, max_instructions, max_cycles);
+    watch_end(cpu);
+    return result;
+  }
+
+  if (cpu->tracer || cpu->profile || cpu->coverage || cpu->strict) {
+    return table_run(cpu, max_instructions, max_cycles);
+  }
+
+  switch (cpu->core) {
+    case kCpuCoreFused:
+      return fused_run(cpu, max_instructions, max_cycles);
+    case kCpuCoreBlock:
+    case kCpuCoreJit:
+      if (cpu->blocks) {
+        return block_run(cpu, max_instructions, max_cycles);
+      }
+
+      return table_run(cpu, max_instructions, max_cycles);
+    default:
+      return table_run(cpu, max_instructions, max_cycles);
+  }
+}
+
+// The cores run up to the next event at most and stop at the limit when an
+// interrupt gets ready, either way the run goes on after servicing it. Idle
+// loops are skipped up to the next event the same way.
+struct RunResult run_until(struct Cpu* cpu, u64 max_instructions,
+                           u64 max_cycles) {
+  // PHP, PLP and RTI all leave the unused flag set so it only has to be
+  // forced once per run instead of once per instruction.
+  set_flag(cpu, KFlagUnused, 1);
+  cpu->stop_requested = false;
+  cpu->jammed = false;
+  clear_watch_hit(cpu);
+
+  struct RunResult result = {
+      .instructions = 0,
+      .cycles = 0,
+      .reason = kStopReasonLimit,
+  };
+
+  u64 start_cycles = cpu->cycles;
+  for (;;) {
+    service(cpu);
+
+    if (cpu->waiting && !wake(cpu, max_cycles)) {
+      if (cpu->cycles >= max_cycles || next_event(cpu) == UINT64_MAX) {
+        result.reason = kStopReasonIdle;
+        break;
+      }
+
+      continue;
+    }
+
+    // A host trap runs in place of the guest code at its address.
+    if (cpu->stops && call_host_trap(cpu)) {
+      result.reason =
+          cpu->stop_requested ? kStopReasonHost : kStopReasonLimit;
+      if (cpu->stop_requested || cpu->cycles >= max_cycles) {
+        break;
+      }
+
+      continue;
+    }
+
+    u64 deadline = next_event(cpu);
+    struct RunResult slice =
+        core_run(cpu, max_instructions - result.instructions,
+                 deadline < max_cycles ? deadline : max_cycles);
+
+    // WAI stops the core, the wait starts over at the top.
+    if (cpu->waiting) {
+      cpu->stop_requested = false;
+      slice.reason = kStopReasonLimit;
+    }
+
+    // The cores stop at host traps like at breakpoints, the trap is called
+    // above.
+    if (slice.reason == kStopReasonBreakpoint &&
+        !addr_set_has(&cpu->stops->breakpoints, cpu->pc)) {
+      slice.reason = kStopReasonLimit;
+    }
+
+    result.instructions += slice.instructions;
+    result.reason = slice.reason;
+
+    if ((slice.reason != kStopReasonLimit &&
+         slice.reason != kStopReasonIdle) ||
+        result.instructions >= max_instructions ||
+        cpu->cycles >= max_cycles) {
+      break;
+    }
+  }
+
+  report_watch_hit(cpu);
+  result.cycles = cpu->cycles - start_cycles;
+  return result;
+}
+
+struct RunResult cpu_run(struct Cpu* cpu, u64 max_instructions) {
+  if (!cpu) {
+    struct RunResult result = {
+        .instructions = 0,
+        .cycles = 0,
+        .reason = kStopReasonLimit,
+    };
+
+    return result;
+  }
+
+  return run_until(cpu, max_instructions, UINT64_MAX);
+}
+
+struct RunResult cpu_run_cycles(struct Cpu* cpu, u64 budget) {
+  if (!cpu) {
+    struct RunResult result = {
+        .instructions = 0,
+        .cycles = 0,
+        .reason = kStopReasonLimit,
+    };
+
+    return result;
+  }
+
+  u64 max_cycles = cpu->cycles + budget;
+  if (max_cycles < cpu->cycles) {
+    max_cycles = UINT64_MAX;
+  }
+
+  return run_until(cpu, UINT64_MAX, max_cycles);
+}
+
+u8 cpu_get_p(const struct Cpu* cpu) { return pack_flags(cpu); }
+
+void cpu_set_p(struct Cpu* cpu, u8 p) { unpack_flags(cpu, p); }
+
+void cpu_stop(struct Cpu* cpu) { cpu->stop_requested = true; }
+
+void cpu_set_trap(struct Cpu* cpu, u16 addr) {
+  cpu->trap_enabled = true;
+  cpu->trap = addr;
+}
+
+void cpu_clear_trap(struct Cpu* cpu) { cpu->trap_enabled = false; }
+
+void cpu_set_strict(struct Cpu* cpu, bool strict) { cpu->strict = strict; }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "e6502.h"
 
@@ -15,28 +17,515 @@ enum Flag {
   kFlagNegative = (1 << 7),
 };
 
-bool get_flag(const struct Cpu* cpu, enum Flag flag);
+// N, Z, C and V are evaluated lazily. The last result byte is kept in flag_n
+// and flag_z (N is bit 7 of flag_n, Z is set when flag_z is zero), the carry
+// is 0 or 1 in flag_c and V is bit 7 of flag_v. Only the remaining flags live
+// in p until pack_flags() materializes the full status register.
+#define kLazyFlags (kFlagCarry | kFlagZero | kFlagOverflow | kFlagNegative)
+
+static inline bool get_flag(const struct Cpu* cpu, enum Flag flag) {
+  switch (flag) {
+    case kFlagCarry:
+      return cpu->flag_c;
+    case kFlagZero:
+      return cpu->flag_z == 0x00;
+    case kFlagOverflow:
+      return cpu->flag_v & 0x80;
+    case kFlagNegative:
+      return cpu->flag_n & 0x80;
+    default:
+      return (cpu->p & flag) != 0;
+  }
+}
+
+static inline void set_flag(struct Cpu* cpu, enum Flag flag, bool value) {
+  switch (flag) {
+    case kFlagCarry:
+      cpu->flag_c = value;
+      break;
+    case kFlagZero:
+      cpu->flag_z = !value;
+      break;
+    case kFlagOverflow:
+      cpu->flag_v = value ? 0x80 : 0x00;
+      break;
+    case kFlagNegative:
+      cpu->flag_n = value ? 0x80 : 0x00;
+      break;
+    default:
+      if (value) {
+        cpu->p |= flag;
+      } else {
+        cpu->p &= ~flag;
+      }
+  }
+}
+
+static inline void set_nz(struct Cpu* cpu, u8 value) {
+  cpu->flag_n = value;
+  cpu->flag_z = value;
+}
+
+// NMOS decimal adjustment of a digit sum or difference in 0x00-0x1f: the
+// adjusted digit with the carry or borrow in bit 4. Defined in op.c.
+extern const u8 decimal_add[32];
+extern const u8 decimal_sub[32];
+
+// Result and lazy flags of a decimal ADC. N and V come from the sum before
+// the high digit is adjusted, Z from the binary sum.
+struct DecimalSum {
+  u8 a;
+  u8 n;
+  u8 v;
+  u8 c;
+};
+
+static inline struct DecimalSum decimal_adc(u8 a, u8 b, u8 c) {
+  u8 lo = decimal_add[(a & 0x0f) + (b & 0x0f) + c];
+  u8 hi = (a >> 4) + (b >> 4) + (lo >> 4);
+  u8 adjusted = decimal_add[hi];
+  return (struct DecimalSum){
+      .a = (adjusted << 4) | (lo & 0x0f),
+      .n = hi << 4,
+      .v = ~(a ^ b) & (a ^ (hi << 4)),
+      .c = adjusted >> 4,
+  };
+}
+
+// A decimal SBC sets the flags from the binary difference.
+static inline u8 decimal_sbc(u8 a, u8 b, u8 c) {
+  u8 lo = decimal_sub[((a & 0x0f) - (b & 0x0f) - !c) & 0x1f];
+  u8 hi = decimal_sub[((a >> 4) - (b >> 4) - (lo >> 4)) & 0x1f];
+  return (hi << 4) | (lo & 0x0f);
+}
+
+// The 65C02 adjusts the binary difference instead, by a borrow out of the
+// byte and one out of the low digit. It also sets N and Z from the result
+// and takes an extra cycle for both ADC and SBC in decimal mode.
+static inline u8 cmos_decimal_sbc(u8 a, u8 b, u8 c) {
+  u16 d = a - b - !c;
+  if (a < b + !c) {
+    d -= 0x60;
+  }
+
+  if ((a & 0x0f) < (b & 0x0f) + !c) {
+    d -= 0x06;
+  }
+
+  return d & 0x00ff;
+}
+
+static inline u8 pack_flags(const struct Cpu* cpu) {
+  return (cpu->p & ~kLazyFlags) | (cpu->flag_n & 0x80) |
+         ((cpu->flag_v & 0x80) >> 1) | ((cpu->flag_z == 0x00) << 1) |
+         (cpu->flag_c & 0x01);
+}
+
+static inline void unpack_flags(struct Cpu* cpu, u8 p) {
+  cpu->p = p & ~kLazyFlags;
+  cpu->flag_n = p;
+  cpu->flag_z = ~p & kFlagZero;
+  cpu->flag_c = p & kFlagCarry;
+  cpu->flag_v = p << 1;
+}
+
+// A bit per address. Only pages with a bit set have a bitmap.
+struct AddrSet {
+  u32* pages[256];
+  u16 num_pages;
+};
+
+static inline bool addr_set_has(const struct AddrSet* set, u16 addr) {
+  const u32* bits = set->pages[addr >> 8];
+  return bits && (bits[(addr & 0x00ff) >> 5] >> (addr & 31) & 1);
+}
+
+struct HostTrap {
+  u16 addr;
+  HostTrapFn fn;
+  void* ctx;
+};
+
+// See stop.c. Breakpoints and host traps are both in exec, which the cores
+// check after every instruction, and stop there. The run loop then calls the
+// host trap or ends the run at the breakpoint.
+//
+// While watchpoints are set, runs go through the table core with the CPU on
+// watch_bus. That is a copy of the host's bus without the watched pages in
+// its page table, so only accesses to those take the callbacks that check
+// for hits.
+struct StopPoints {
+  struct AddrSet exec;
+  struct AddrSet breakpoints;
+  struct AddrSet watch_read;
+  struct AddrSet watch_write;
+
+  struct HostTrap* traps;
+  size_t num_traps;
+  size_t trap_capacity;
+
+  struct Bus watch_bus;
+  struct Bus* host_bus;
+  // The first access that hit a watchpoint since the run or step started.
+  u8 hit_access;
+  u16 hit_addr;
+};
+
+static inline bool watching(const struct Cpu* cpu) {
+  const struct StopPoints* stops = cpu->stops;
+  return stops && (stops->watch_read.num_pages || stops->watch_write.num_pages);
+}
+
+// Predecoded basic blocks of the block core, see block.c. Pages that blocks
+// were decoded from are flagged in code, a write to such a page bumps its
+// generation which invalidates all blocks decoded from it.
+struct BlockCache {
+  bool code[256];
+  u32 generation[256];
+  struct Block* blocks;
+  struct Jit* jit;
+};
+
+static inline void note_callback_read(struct Cpu* cpu, u16 addr) {
+  u64 n = cpu->num_callback_reads++;
+  cpu->callback_reads[n & (kMaxCallbackReads - 1)] = addr;
+}
+
+// Whether the reads through the callback since num_callback_reads was cleared
+// were all of addresses marked with bus_add_pure_read().
+bool callback_reads_pure(const struct Cpu* cpu);
+
+// The hint keeps the callback path out of line in the ops and block.c.
+static inline u8 bus_load(struct Cpu* cpu, u16 addr) {
+  const u8* page = cpu->bus->read_pages[addr >> 8];
+  if (__builtin_expect(page != NULL, 1)) {
+    return page[addr & 0x00ff];
+  }
+
+  note_callback_read(cpu, addr);
+  return cpu->bus->read(cpu->bus->ctx, addr);
+}
+
+static inline void bus_store(const struct Cpu* cpu, u16 addr, u8 data) {
+  struct BlockCache* cache = cpu->blocks;
+  if (cache && cache->code[addr >> 8]) {
+    cache->code[addr >> 8] = false;
+    ++cache->generation[addr >> 8];
+  }
+
+  cpu->bus->dirty[addr >> 8] = true;
+  u8* page = cpu->bus->write_pages[addr >> 8];
+  if (page) {
+    page[addr & 0x00ff] = data;
+    return;
+  }
+
+  cpu->bus->write(cpu->bus->ctx, addr, data);
+}
+
+// Called by the control flow ops, from is the address after the instruction.
+static inline void cover(const struct Cpu* cpu, u16 from, u16 to) {
+  if (cpu->coverage) {
+    ++cpu->coverage[(from >> 1 ^ to) & (kCoverageSize - 1)];
+  }
+}
+
+// NMIs are taken right away, IRQs only while I is clear in p.
+static inline bool interrupt_ready(const struct Cpu* cpu, u8 p) {
+  return cpu->interrupts != kInterruptTypeNone &&
+         ((cpu->interrupts & kInterruptTypeNmi) || !(p & kFlagInterrupt));
+}
+
+// Checks made by every run loop before the first instruction. max_cycles is
+// an absolute deadline for the cycle counter. The cores stop at the limit
+// when an interrupt is ready, run_until() takes it and carries on.
+static inline bool run_should_start(const struct Cpu* cpu, u8 p, u64 cycles,
+                                    u64 max_instructions, u64 max_cycles,
+                                    struct RunResult* result) {
+  if (result->instructions >= max_instructions || cycles >= max_cycles ||
+      interrupt_ready(cpu, p)) {
+    result->reason = kStopReasonLimit;
+    return true;
+  }
+
+  return false;
+}
+
+// Checks made by every run loop after each instruction other than BRK. The
+// trap is checked after executing so that a run started at the trap address
+// resumes instead of stopping right away.
+static inline bool run_should_stop(const struct Cpu* cpu, u8 p, u16 pc,
+                                   u64 cycles, u64 max_instructions,
+                                   u64 max_cycles, struct RunResult* result) {
+  if (cpu->stop_requested) {
+    result->reason = cpu->jammed ? kStopReasonIllegal : kStopReasonHost;
+    return true;
+  }
+
+  if (cpu->trap_enabled && pc == cpu->trap) {
+    result->reason = kStopReasonTrap;
+    return true;
+  }
+
+  const struct StopPoints* stops = cpu->stops;
+  if (stops && stops->hit_access != kAccessTypeNone) {
+    result->reason = kStopReasonWatchpoint;
+    return true;
+  }
+
+  if (stops && addr_set_has(&stops->exec, pc)) {
+    result->reason = kStopReasonBreakpoint;
+    return true;
+  }
+
+  return run_should_start(cpu, p, cycles, max_instructions, max_cycles,
+                          result);
+}
+
+// Binary min-heap ordered by deadline, then by order of scheduling.
+struct Event {
+  u64 cycles;
+  u64 sequence;
+  EventFn fn;
+  void* ctx;
+};
+
+struct EventQueue {
+  struct Event* heap;
+  size_t size;
+  size_t capacity;
+  u64 sequence;
+};
+
+static inline u64 next_event(const struct Cpu* cpu) {
+  const struct EventQueue* events = cpu->events;
+  return events && events->size > 0 ? events->heap[0].cycles : UINT64_MAX;
+}
+
+// Fires every event due by the cycle counter.
+void fire_events(struct Cpu* cpu);
+
+void event_queue_free(struct EventQueue* events);
+
+// Calls the host trap at the PC, if any. Returns false if there is none or if
+// it left the PC unchanged without stopping the run, the guest code runs then.
+bool call_host_trap(struct Cpu* cpu);
+
+void stop_points_free(struct StopPoints* stops);
+
+// Put the CPU on the watch bus and back, see StopPoints.
+void watch_begin(struct Cpu* cpu);
+
+void watch_end(struct Cpu* cpu);
+
+// cpu_run() with both limits, max_cycles is an absolute deadline.
+struct RunResult run_until(struct Cpu* cpu, u64 max_instructions,
+                           u64 max_cycles);
+
+struct RunResult fused_run(struct Cpu* cpu, u64 max_instructions,
+                           u64 max_cycles);
+
+struct RunResult block_run(struct Cpu* cpu, u64 max_instructions,
+                           u64 max_cycles);
+
+// Ops that only read memory, their result depends on nothing but the
+// registers and what they read.
+bool reads_only(void (*op)(struct Cpu* cpu, u16 addr, bool implied),
+                enum AddrMode addr_mode);
+
+#define kIdleRejects 8
+
+// The last polling loop closed by a taken backward branch in the table or
+// fused core, see idle_branch().
+struct IdleLoop {
+  // Targets of branches that close other loops, by their low bits and tagged
+  // with bit 16, so that each is only scanned once.
+  u32 rejected[kIdleRejects];
+  u16 target;
+  // Instructions from the target up to the branch, 0 until a polling loop
+  // was found.
+  u8 count;
+  u8 regs[5];
+  u64 cycles;
+  u64 instructions;
+  // Set once iterations were skipped.
+  bool idle;
+};
+
+static inline bool idle_candidate(const struct IdleLoop* loop, u16 target) {
+  return loop->rejected[target % kIdleRejects] != (0x10000u | target);
+}
+
+// Called after a branch was taken back to the PC, with the instructions run
+// so far including the branch. Returns the number of instructions skipped.
+u64 idle_branch(struct Cpu* cpu, struct IdleLoop* loop, u64 instructions,
+                u64 max_instructions, u64 max_cycles);
 
-void set_flag(struct Cpu* cpu, enum Flag flag, bool value);
+// Called around every instruction run with a tracer attached.
+void trace_begin(struct Tracer* tracer, const struct Cpu* cpu);
 
-u8 read(const struct Cpu* cpu, u16 addr);
+void trace_end(struct Tracer* tracer, const struct Cpu* cpu);
 
-void write(const struct Cpu* cpu, u16 addr, u8 data);
+// Follow the call graph on JSR and RTS, see profile_count().
+void profile_call(struct Profile* profile, const struct Cpu* cpu, u16 site,
+                  u64 start_cycles);
+
+void profile_return(struct Profile* profile, const struct Cpu* cpu);
+
+// Called after every instruction run with a profile attached.
+static inline void profile_count(struct Profile* profile,
+                                 const struct Cpu* cpu, u16 pc, u8 opcode,
+                                 u64 start_cycles) {
+  ++profile->instructions[pc];
+  ++profile->opcodes[opcode];
+  if (profile->count_cycles) {
+    profile->cycles[pc] += cpu->cycles - start_cycles;
+  }
+
+  if (opcode == 0x20) {
+    profile_call(profile, cpu, pc, start_cycles);
+  } else if (opcode == 0x60) {
+    profile_return(profile, cpu);
+  }
+}
+
+struct BlockCache* block_cache_new(void);
+
+void block_cache_free(struct BlockCache* cache);
+
+void block_cache_flush(struct BlockCache* cache);
+
+// Allocates or frees the translator of the JIT core.
+bool block_cache_set_jit(struct BlockCache* cache, bool enabled);
+
+#define kMaxBlockInstructions 16
+
+struct BlockInstruction {
+  void (*op_impl)(struct Cpu* cpu, u16 addr, bool implied);
+  // The effective address for modes that do not depend on registers or
+  // memory, the raw operand otherwise.
+  u16 operand;
+  u8 addr_mode;
+  u8 length;
+  u8 cycles;
+  bool page_cycle;
+};
+
+// Native code of the JIT core for a prefix of a block. Returns the number of
+// instructions it executed.
+typedef u32 (*NativeCode)(struct Cpu* cpu);
+
+struct Block {
+  const u8* page;
+  u32 generation;
+  u16 pc;
+  u8 count;
+  // Upper bound including page crossing and branch penalties.
+  u16 max_cycles;
+
+  NativeCode native;
+  u16 executions;
+  bool translated;
+
+  // Ends in a branch back to pc and only reads memory, see skip_idle().
+  bool may_idle;
+  u64 idle_cycles;
+  u8 idle_regs[5];
+
+  struct BlockInstruction instructions[kMaxBlockInstructions];
+};
+
+#if defined(E6502_JIT)
+struct Jit* jit_new(void);
+
+void jit_free(struct Jit* jit);
+
+// Drops all translated code. The caller has to forget the native pointers.
+void jit_reset(struct Jit* jit);
+
+// Returns NULL when the first instruction cannot be translated or when the
+// code buffer is full, see jit_full().
+NativeCode jit_translate(struct Jit* jit, const struct Block* block,
+                         enum CpuVariant variant);
+
+bool jit_full(const struct Jit* jit);
+#endif
 
 struct Instruction {
-  const char* name;
   void (*op_impl)(struct Cpu* cpu, u16 addr, bool implied);
-  void (*addr_mode)(struct Cpu* cpu, u16* addr);
+  // Returns true when indexing crossed a page boundary.
+  bool (*addr_mode)(struct Cpu* cpu, u16* addr);
+  u8 cycles;
+  // Read instructions take an extra cycle when indexing crosses a page.
+  bool page_cycle;
 };
 
-extern struct Instruction instructions[256];
+// Indexed by variant and opcode, cpu_init() points the CPU at its table.
+extern const struct Instruction instructions[kNumCpuVariants][256];
+
+// Fetches, decodes and executes a single instruction through the table.
+static inline u8 execute(struct Cpu* cpu) {
+  u8 opcode = bus_load(cpu, cpu->pc++);
+
+  const struct Instruction* instr = cpu->instructions + opcode;
+  bool implied = !instr->addr_mode;
+  cpu->cycles += instr->cycles;
+
+  u16 addr = 0;
+  if (!implied && instr->addr_mode(cpu, &addr) && instr->page_cycle) {
+    ++cpu->cycles;
+  }
+
+  instr->op_impl(cpu, addr, implied);
+  return opcode;
+}
 
 void op_adc(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_alr(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_anc(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_and(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_ane(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_arr(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_asl(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_bbr0(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr1(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr2(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr3(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr4(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr5(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr6(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbr7(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs0(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs1(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs2(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs3(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs4(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs5(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs6(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_bbs7(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_bcc(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_bcs(struct Cpu* cpu, u16 addr, bool implied);
@@ -45,12 +534,16 @@ void op_beq(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_bit(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_bit_imm(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_bmi(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_bne(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_bpl(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_bra(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_brk(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_bvc(struct Cpu* cpu, u16 addr, bool implied);
@@ -71,6 +564,8 @@ void op_cpx(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_cpy(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_dcp(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_dec(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_dex(struct Cpu* cpu, u16 addr, bool implied);
@@ -85,10 +580,18 @@ void op_inx(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_iny(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_isc(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_jam(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_jmp(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_jsr(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_las(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_lax(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_lda(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_ldx(struct Cpu* cpu, u16 addr, bool implied);
@@ -97,6 +600,8 @@ void op_ldy(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_lsr(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_lxa(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_nop(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_ora(struct Cpu* cpu, u16 addr, bool implied);
@@ -105,36 +610,102 @@ void op_pha(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_php(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_phx(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_phy(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_pla(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_plp(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_plx(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_ply(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rla(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb0(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb1(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb2(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb3(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb4(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb5(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb6(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_rmb7(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_rol(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_ror(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_rra(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_rti(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_rts(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_sax(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_sbc(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_sbx(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_sec(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_sed(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_sei(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_sha(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_shx(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_shy(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_slo(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb0(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb1(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb2(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb3(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb4(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb5(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb6(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_smb7(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_sre(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_sta(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_stx(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_sty(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_stz(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_tas(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_tax(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_tay(struct Cpu* cpu, u16 addr, bool implied);
 
+void op_trb(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_tsb(struct Cpu* cpu, u16 addr, bool implied);
+
 void op_tsx(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_txa(struct Cpu* cpu, u16 addr, bool implied);
@@ -142,3 +713,5 @@ void op_txa(struct Cpu* cpu, u16 addr, bool implied);
 void op_txs(struct Cpu* cpu, u16 addr, bool implied);
 
 void op_tya(struct Cpu* cpu, u16 addr, bool implied);
+
+void op_wai(struct Cpu* cpu, u16 addr, bool implied);
@@ -0,0 +1,120 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+static bool before(const struct Event* a, const struct Event* b) {
+  return a->cycles < b->cycles ||
+         (a->cycles == b->cycles && a->sequence < b->sequence);
+}
+
+static void sift_up(struct Event* heap, size_t i) {
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!before(heap + i, heap + parent)) {
+      break;
+    }
+
+    struct Event tmp = heap[i];
+    heap[i] = heap[parent];
+    heap[parent] = tmp;
+    i = parent;
+  }
+}
+
+static void sift_down(struct Event* heap, size_t size, size_t i) {
+  for (;;) {
+    size_t first = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < size && before(heap + left, heap + first)) {
+      first = left;
+    }
+
+    if (right < size && before(heap + right, heap + first)) {
+      first = right;
+    }
+
+    if (first == i) {
+      break;
+    }
+
+    struct Event tmp = heap[i];
+    heap[i] = heap[first];
+    heap[first] = tmp;
+    i = first;
+  }
+}
+
+bool cpu_schedule(struct Cpu* cpu, u64 cycles, EventFn fn, void* ctx) {
+  struct EventQueue* events = cpu->events;
+  if (!events) {
+    events = calloc(1, sizeof(struct EventQueue));
+    if (!events) {
+      return false;
+    }
+
+    cpu->events = events;
+  }
+
+  if (events->size == events->capacity) {
+    size_t capacity = events->capacity ? 2 * events->capacity : 16;
+    struct Event* heap = realloc(events->heap, capacity * sizeof(struct Event));
+    if (!heap) {
+      return false;
+    }
+
+    events->heap = heap;
+    events->capacity = capacity;
+  }
+
+  events->heap[events->size] = (struct Event){
+      .cycles = cycles,
+      .sequence = events->sequence++,
+      .fn = fn,
+      .ctx = ctx,
+  };
+
+  sift_up(events->heap, events->size++);
+  return true;
+}
+
+void cpu_cancel(struct Cpu* cpu, EventFn fn, void* ctx) {
+  struct EventQueue* events = cpu->events;
+  if (!events) {
+    return;
+  }
+
+  size_t size = 0;
+  for (size_t i = 0; i < events->size; ++i) {
+    if (events->heap[i].fn != fn || events->heap[i].ctx != ctx) {
+      events->heap[size++] = events->heap[i];
+    }
+  }
+
+  events->size = size;
+  for (size_t i = size / 2; i-- > 0;) {
+    sift_down(events->heap, size, i);
+  }
+}
+
+void fire_events(struct Cpu* cpu) {
+  struct EventQueue* events = cpu->events;
+  while (events && events->size > 0 && events->heap[0].cycles <= cpu->cycles) {
+    struct Event event = events->heap[0];
+    events->heap[0] = events->heap[--events->size];
+    sift_down(events->heap, events->size, 0);
+
+    // The callback may schedule or cancel events.
+    event.fn(cpu, event.ctx);
+  }
+}
+
+void event_queue_free(struct EventQueue* events) {
+  if (!events) {
+    return;
+  }
+
+  free(events->heap);
+  free(events);
+}
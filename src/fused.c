@@ -0,0 +1,1436 @@
+#include <stdbool.h>
+
+#include "cpu.h"
+#include "opcodes.h"
+
+// Specialized interpreter core. Every opcode is a single case with the
+// addressing mode and operation inlined, dispatched through computed goto when
+// the compiler supports it and through a switch otherwise. The instruction
+// table in instr.c is the reference implementation and the two have to agree
+// on every observable effect.
+
+// Registers live in a local copy for the duration of a run so the compiler can
+// keep them in host registers. They are written back to the Cpu before every
+// bus callback and at the end of the run.
+struct State {
+  struct Cpu* cpu;
+  struct Bus* bus;
+  u16 pc;
+  u8 a;
+  u8 x;
+  u8 y;
+  u8 s;
+  u8 p;
+  u8 n;
+  u8 z;
+  u8 c;
+  u8 v;
+  u64 cycles;
+
+  // Running a 65C02 variant, only checked where it differs from the 6502.
+  bool cmos;
+};
+
+#if defined(__GNUC__)
+#define INLINE static inline __attribute__((always_inline))
+#else
+#define INLINE static inline
+#endif
+
+INLINE void sync_out(struct State* st) {
+  st->cpu->pc = st->pc;
+  st->cpu->a = st->a;
+  st->cpu->x = st->x;
+  st->cpu->y = st->y;
+  st->cpu->s = st->s;
+  st->cpu->p = st->p;
+  st->cpu->flag_n = st->n;
+  st->cpu->flag_z = st->z;
+  st->cpu->flag_c = st->c;
+  st->cpu->flag_v = st->v;
+  st->cpu->cycles = st->cycles;
+}
+
+INLINE void sync_in(struct State* st) {
+  st->pc = st->cpu->pc;
+  st->a = st->cpu->a;
+  st->x = st->cpu->x;
+  st->y = st->cpu->y;
+  st->s = st->cpu->s;
+  st->p = st->cpu->p;
+  st->n = st->cpu->flag_n;
+  st->z = st->cpu->flag_z;
+  st->c = st->cpu->flag_c;
+  st->v = st->cpu->flag_v;
+  st->cycles = st->cpu->cycles;
+}
+
+INLINE u8 load(struct State* st, u16 addr) {
+  const u8* page = st->bus->read_pages[addr >> 8];
+  if (page) {
+    return page[addr & 0x00ff];
+  }
+
+  sync_out(st);
+  note_callback_read(st->cpu, addr);
+  u8 data = st->bus->read(st->bus->ctx, addr);
+  sync_in(st);
+  return data;
+}
+
+INLINE void store(struct State* st, u16 addr, u8 data) {
+  st->bus->dirty[addr >> 8] = true;
+  u8* page = st->bus->write_pages[addr >> 8];
+  if (page) {
+    page[addr & 0x00ff] = data;
+    return;
+  }
+
+  sync_out(st);
+  st->bus->write(st->bus->ctx, addr, data);
+  sync_in(st);
+}
+
+// Flags use the same lazy representation as the Cpu, see cpu.h.
+INLINE bool get_p(const struct State* st, enum Flag flag) {
+  switch (flag) {
+    case kFlagCarry:
+      return st->c;
+    case kFlagZero:
+      return st->z == 0x00;
+    case kFlagOverflow:
+      return st->v & 0x80;
+    case kFlagNegative:
+      return st->n & 0x80;
+    default:
+      return (st->p & flag) != 0;
+  }
+}
+
+INLINE void set_p(struct State* st, enum Flag flag, bool value) {
+  switch (flag) {
+    case kFlagCarry:
+      st->c = value;
+      break;
+    case kFlagZero:
+      st->z = !value;
+      break;
+    case kFlagOverflow:
+      st->v = value ? 0x80 : 0x00;
+      break;
+    case kFlagNegative:
+      st->n = value ? 0x80 : 0x00;
+      break;
+    default:
+      if (value) {
+        st->p |= flag;
+      } else {
+        st->p &= ~flag;
+      }
+  }
+}
+
+INLINE u8 pack_p(const struct State* st) {
+  return (st->p & ~kLazyFlags) | (st->n & 0x80) | ((st->v & 0x80) >> 1) |
+         ((st->z == 0x00) << 1) | (st->c & 0x01);
+}
+
+INLINE void unpack_p(struct State* st, u8 p) {
+  st->p = p & ~kLazyFlags;
+  st->n = p;
+  st->z = ~p & kFlagZero;
+  st->c = p & kFlagCarry;
+  st->v = p << 1;
+}
+
+INLINE u8 fetch(struct State* st) { return load(st, st->pc++); }
+
+INLINE u16 fetch_word(struct State* st) {
+  u16 lo = fetch(st);
+  u16 hi = fetch(st);
+  return (hi << 8) | lo;
+}
+
+INLINE u16 addr_zp(struct State* st) { return fetch(st); }
+
+INLINE u16 addr_zpx(struct State* st) {
+  return (fetch(st) + st->x) & 0x00ff;
+}
+
+INLINE u16 addr_zpy(struct State* st) {
+  return (fetch(st) + st->y) & 0x00ff;
+}
+
+INLINE u16 addr_abs(struct State* st) { return fetch_word(st); }
+
+INLINE u16 addr_abx(struct State* st) { return fetch_word(st) + st->x; }
+
+INLINE u16 addr_aby(struct State* st) { return fetch_word(st) + st->y; }
+
+// The 6502 wraps the pointer within its page, the 65C02 takes a cycle more to
+// read across.
+INLINE u16 addr_ind(struct State* st) {
+  u16 a = fetch_word(st);
+  u16 b = a + 1;
+  if (st->cmos) {
+    ++st->cycles;
+  } else {
+    b = (a & 0xff00) | (b & 0x00ff);
+  }
+
+  return (load(st, b) << 8) | load(st, a);
+}
+
+INLINE u16 addr_izx(struct State* st) {
+  u16 a = fetch(st);
+  u16 lo = load(st, (a + st->x) & 0x00ff);
+  u16 hi = load(st, (a + st->x + 1) & 0x00ff);
+  return (hi << 8) | lo;
+}
+
+INLINE u16 addr_izy(struct State* st) {
+  u16 a = fetch(st);
+  u16 lo = load(st, a);
+  u16 hi = load(st, (a + 1) & 0x00ff);
+  return ((hi << 8) | lo) + st->y;
+}
+
+INLINE void push(struct State* st, u8 data) {
+  store(st, 0x0100 + st->s--, data);
+}
+
+INLINE void push_word(struct State* st, u16 data) {
+  push(st, (data >> 8) & 0x00ff);
+  push(st, data & 0x00ff);
+}
+
+INLINE u8 pull(struct State* st) { return load(st, 0x0100 + ++st->s); }
+
+INLINE u16 pull_word(struct State* st) {
+  u16 lo = pull(st);
+  u16 hi = pull(st);
+  return (hi << 8) | lo;
+}
+
+INLINE void set_p_nz(struct State* st, u8 value) {
+  st->n = value;
+  st->z = value;
+}
+
+// Indexed reads take an extra cycle when the index carries into the high
+// byte, writes and read-modify-write instructions always pay for it.
+INLINE u16 page_cycle(struct State* st, u16 base, u16 addr) {
+  st->cycles += ((base ^ addr) & 0xff00) != 0;
+  return addr;
+}
+
+INLINE u16 read_abx(struct State* st) {
+  u16 base = fetch_word(st);
+  return page_cycle(st, base, base + st->x);
+}
+
+INLINE u16 read_aby(struct State* st) {
+  u16 base = fetch_word(st);
+  return page_cycle(st, base, base + st->y);
+}
+
+// The 65C02 saves a cycle on shifts and rotates when the index does not carry.
+INLINE u16 shift_abx(struct State* st) {
+  u16 base = fetch_word(st);
+  u16 addr = base + st->x;
+  if (st->cmos) {
+    st->cycles -= ((base ^ addr) & 0xff00) == 0;
+  }
+
+  return addr;
+}
+
+INLINE u16 read_izy(struct State* st) {
+  u16 a = fetch(st);
+  u16 lo = load(st, a);
+  u16 hi = load(st, (a + 1) & 0x00ff);
+  u16 base = (hi << 8) | lo;
+  return page_cycle(st, base, base + st->y);
+}
+
+INLINE void alu_adc(struct State* st, u8 value) {
+  u16 a = st->a;
+  u16 b = value;
+  u16 d = a + b + st->c;
+
+  if (get_p(st, kFlagDecimal)) {
+    struct DecimalSum sum = decimal_adc(a, b, st->c);
+    st->n = sum.n;
+    st->z = d & 0x00ff;
+    st->v = sum.v;
+    st->c = sum.c;
+    st->a = sum.a;
+    if (st->cmos) {
+      set_p_nz(st, sum.a);
+      ++st->cycles;
+    }
+
+    return;
+  }
+
+  st->c = d >> 8;
+  st->v = ~(a ^ b) & (a ^ d);
+  set_p_nz(st, d & 0x00ff);
+
+  st->a = d & 0x00ff;
+}
+
+INLINE void alu_sbc(struct State* st, u8 value) {
+  u16 a = st->a;
+  u16 c = value ^ 0x00ff;
+  u16 e = a + c + st->c;
+
+  u8 carry = st->c;
+  st->c = e >> 8;
+  st->v = (e ^ a) & (e ^ c);
+  set_p_nz(st, e & 0x00ff);
+
+  if (!get_p(st, kFlagDecimal)) {
+    st->a = e & 0x00ff;
+  } else if (!st->cmos) {
+    st->a = decimal_sbc(a, value, carry);
+  } else {
+    st->a = cmos_decimal_sbc(a, value, carry);
+    set_p_nz(st, st->a);
+    ++st->cycles;
+  }
+}
+
+INLINE void alu_and(struct State* st, u8 value) {
+  st->a &= value;
+  set_p_nz(st, st->a);
+}
+
+INLINE void alu_ora(struct State* st, u8 value) {
+  st->a |= value;
+  set_p_nz(st, st->a);
+}
+
+INLINE void alu_eor(struct State* st, u8 value) {
+  st->a ^= value;
+  set_p_nz(st, st->a);
+}
+
+INLINE void alu_bit(struct State* st, u8 value) {
+  st->n = value;
+  st->z = st->a & value;
+  st->v = value << 1;
+}
+
+INLINE void alu_cmp(struct State* st, u8 reg, u8 value) {
+  st->c = reg >= value;
+  set_p_nz(st, reg - value);
+}
+
+INLINE u8 alu_asl(struct State* st, u8 value) {
+  st->c = value >> 7;
+  value <<= 1;
+  set_p_nz(st, value);
+  return value;
+}
+
+INLINE u8 alu_lsr(struct State* st, u8 value) {
+  st->c = value & 0x01;
+  value >>= 1;
+  set_p_nz(st, value);
+  return value;
+}
+
+INLINE u8 alu_rol(struct State* st, u8 value) {
+  u8 c = (value << 1) | st->c;
+  st->c = value >> 7;
+  set_p_nz(st, c);
+  return c;
+}
+
+INLINE u8 alu_ror(struct State* st, u8 value) {
+  u8 c = (st->c << 7) | (value >> 1);
+  st->c = value & 0x01;
+  set_p_nz(st, c);
+  return c;
+}
+
+// Returns true if the branch was taken back to or before itself, closing a
+// loop.
+INLINE bool branch(struct State* st, bool taken) {
+  u16 offset = fetch(st);
+  if (offset & 0x0080) {
+    offset |= 0xff00;
+  }
+
+  if (!taken) {
+    return false;
+  }
+
+  u16 target = st->pc + offset;
+  st->cycles += ((target ^ st->pc) & 0xff00) ? 2 : 1;
+  st->pc = target;
+  return offset >= 0xff80 && offset <= 0xfffe;
+}
+
+INLINE void brk(struct State* st) {
+  ++st->pc;
+
+  push_word(st, st->pc);
+  push(st, pack_p(st) | kFlagBreak);
+  set_p(st, kFlagBreak, false);
+  set_p(st, kFlagInterrupt, true);
+  if (st->cmos) {
+    set_p(st, kFlagDecimal, false);
+  }
+
+  u16 lo = load(st, 0xfffe);
+  u16 hi = load(st, 0xffff);
+  st->pc = (hi << 8) | lo;
+}
+
+// The rest of the undocumented opcodes, and the opcodes new to the 65C02, go
+// through the table core.
+INLINE void undocumented(struct State* st) {
+  --st->pc;
+  sync_out(st);
+  execute(st->cpu);
+  sync_in(st);
+}
+
+// The cycles of the NMOS opcodes from the matrix, where the 65C02 differs the
+// ops add their own.
+#define BASE_CYCLES(code, mnemonic, op, mode, cycles, page, acc, doc, stab) \
+  kBaseCycles##code = cycles,
+
+enum { OPCODES(BASE_CYCLES) };
+
+#if defined(E6502_COMPUTED_GOTO)
+
+#define CASE(opcode) \
+  op_##opcode:       \
+  st->cycles += kBaseCycles##opcode;
+#define NEXT                                                      \
+  do {                                                            \
+    ++result.instructions;                                        \
+    if (run_should_stop(cpu, st->p, st->pc, st->cycles,           \
+                        max_instructions, max_cycles, &result)) { \
+      goto out;                                                   \
+    }                                                             \
+    goto* kDispatch[fetch(st)];                                   \
+  } while (0)
+#define DISPATCH goto* kDispatch[fetch(st)]
+
+#else
+
+#define CASE(opcode) \
+  case opcode:       \
+    st->cycles += kBaseCycles##opcode;
+#define NEXT break
+#define DISPATCH continue
+
+#endif
+
+// A taken branch back closes a loop, which may idle once the branch passed
+// the stop checks, see idle_branch(). Not wrapped in do while so that
+// DISPATCH continues the switch loop.
+#define NEXT_LOOP                                                         \
+  {                                                                       \
+    ++result.instructions;                                                \
+    if (run_should_stop(cpu, st->p, st->pc, st->cycles, max_instructions, \
+                        max_cycles, &result)) {                           \
+      goto out;                                                           \
+    }                                                                     \
+    if (idle_candidate(&loop, st->pc)) {                                  \
+      sync_out(st);                                                       \
+      result.instructions += idle_branch(cpu, &loop, result.instructions, \
+                                         max_instructions, max_cycles);   \
+      sync_in(st);                                                        \
+    }                                                                     \
+    DISPATCH;                                                             \
+  }
+
+struct RunResult fused_run(struct Cpu* cpu, u64 max_instructions,
+                           u64 max_cycles) {
+  struct RunResult result = {
+      .instructions = 0,
+      .cycles = 0,
+      .reason = kStopReasonLimit,
+  };
+
+  if (run_should_start(cpu, cpu->p, cpu->cycles, max_instructions,
+                       max_cycles, &result)) {
+    return result;
+  }
+
+  struct State state = {
+      .cpu = cpu,
+      .bus = cpu->bus,
+      .cmos = cpu->variant != kCpuVariantNmos,
+  };
+
+  struct State* st = &state;
+  sync_in(st);
+  u64 start_cycles = st->cycles;
+  struct IdleLoop loop = {0};
+
+#if defined(E6502_COMPUTED_GOTO)
+  static const void* const kDispatch[256] = {
+      &&op_0x00, &&op_0x01, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x05, &&op_0x06, &&op_undocumented,
+      &&op_0x08, &&op_0x09, &&op_0x0a, &&op_undocumented,
+      &&op_undocumented, &&op_0x0d, &&op_0x0e, &&op_undocumented,
+      &&op_0x10, &&op_0x11, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x15, &&op_0x16, &&op_undocumented,
+      &&op_0x18, &&op_0x19, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x1d, &&op_0x1e, &&op_undocumented,
+      &&op_0x20, &&op_0x21, &&op_undocumented, &&op_undocumented,
+      &&op_0x24, &&op_0x25, &&op_0x26, &&op_undocumented,
+      &&op_0x28, &&op_0x29, &&op_0x2a, &&op_undocumented,
+      &&op_0x2c, &&op_0x2d, &&op_0x2e, &&op_undocumented,
+      &&op_0x30, &&op_0x31, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x35, &&op_0x36, &&op_undocumented,
+      &&op_0x38, &&op_0x39, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x3d, &&op_0x3e, &&op_undocumented,
+      &&op_0x40, &&op_0x41, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x45, &&op_0x46, &&op_undocumented,
+      &&op_0x48, &&op_0x49, &&op_0x4a, &&op_undocumented,
+      &&op_0x4c, &&op_0x4d, &&op_0x4e, &&op_undocumented,
+      &&op_0x50, &&op_0x51, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x55, &&op_0x56, &&op_undocumented,
+      &&op_0x58, &&op_0x59, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x5d, &&op_0x5e, &&op_undocumented,
+      &&op_0x60, &&op_0x61, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x65, &&op_0x66, &&op_undocumented,
+      &&op_0x68, &&op_0x69, &&op_0x6a, &&op_undocumented,
+      &&op_0x6c, &&op_0x6d, &&op_0x6e, &&op_undocumented,
+      &&op_0x70, &&op_0x71, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x75, &&op_0x76, &&op_undocumented,
+      &&op_0x78, &&op_0x79, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0x7d, &&op_0x7e, &&op_undocumented,
+      &&op_undocumented, &&op_0x81, &&op_undocumented, &&op_undocumented,
+      &&op_0x84, &&op_0x85, &&op_0x86, &&op_undocumented,
+      &&op_0x88, &&op_undocumented, &&op_0x8a, &&op_undocumented,
+      &&op_0x8c, &&op_0x8d, &&op_0x8e, &&op_undocumented,
+      &&op_0x90, &&op_0x91, &&op_undocumented, &&op_undocumented,
+      &&op_0x94, &&op_0x95, &&op_0x96, &&op_undocumented,
+      &&op_0x98, &&op_0x99, &&op_0x9a, &&op_undocumented,
+      &&op_undocumented, &&op_0x9d, &&op_undocumented, &&op_undocumented,
+      &&op_0xa0, &&op_0xa1, &&op_0xa2, &&op_undocumented,
+      &&op_0xa4, &&op_0xa5, &&op_0xa6, &&op_undocumented,
+      &&op_0xa8, &&op_0xa9, &&op_0xaa, &&op_undocumented,
+      &&op_0xac, &&op_0xad, &&op_0xae, &&op_undocumented,
+      &&op_0xb0, &&op_0xb1, &&op_undocumented, &&op_undocumented,
+      &&op_0xb4, &&op_0xb5, &&op_0xb6, &&op_undocumented,
+      &&op_0xb8, &&op_0xb9, &&op_0xba, &&op_undocumented,
+      &&op_0xbc, &&op_0xbd, &&op_0xbe, &&op_undocumented,
+      &&op_0xc0, &&op_0xc1, &&op_undocumented, &&op_undocumented,
+      &&op_0xc4, &&op_0xc5, &&op_0xc6, &&op_undocumented,
+      &&op_0xc8, &&op_0xc9, &&op_0xca, &&op_undocumented,
+      &&op_0xcc, &&op_0xcd, &&op_0xce, &&op_undocumented,
+      &&op_0xd0, &&op_0xd1, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0xd5, &&op_0xd6, &&op_undocumented,
+      &&op_0xd8, &&op_0xd9, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0xdd, &&op_0xde, &&op_undocumented,
+      &&op_0xe0, &&op_0xe1, &&op_undocumented, &&op_undocumented,
+      &&op_0xe4, &&op_0xe5, &&op_0xe6, &&op_undocumented,
+      &&op_0xe8, &&op_0xe9, &&op_0xea, &&op_0xeb,
+      &&op_0xec, &&op_0xed, &&op_0xee, &&op_undocumented,
+      &&op_0xf0, &&op_0xf1, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0xf5, &&op_0xf6, &&op_undocumented,
+      &&op_0xf8, &&op_0xf9, &&op_undocumented, &&op_undocumented,
+      &&op_undocumented, &&op_0xfd, &&op_0xfe, &&op_undocumented,
+  };
+
+  goto* kDispatch[fetch(st)];
+#else
+  for (;;) {
+    switch (fetch(st)) {
+#endif
+
+  CASE(0x00) {  // BRK
+    brk(st);
+    ++result.instructions;
+    result.reason = kStopReasonBrk;
+    goto out;
+  }
+
+  CASE(0x01) {  // ORA izx
+    alu_ora(st, load(st, addr_izx(st)));
+    NEXT;
+  }
+
+  CASE(0x05) {  // ORA zp
+    alu_ora(st, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0x06) {  // ASL zp
+    u16 addr = addr_zp(st);
+    store(st, addr, alu_asl(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x08) {  // PHP
+    push(st, pack_p(st) | kFlagBreak | KFlagUnused);
+    set_p(st, kFlagBreak, false);
+    NEXT;
+  }
+
+  CASE(0x09) {  // ORA imm
+    alu_ora(st, fetch(st));
+    NEXT;
+  }
+
+  CASE(0x0a) {  // ASL
+    st->a = alu_asl(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x0d) {  // ORA abs
+    alu_ora(st, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0x0e) {  // ASL abs
+    u16 addr = addr_abs(st);
+    store(st, addr, alu_asl(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x10) {  // BPL rel
+    if (branch(st, !get_p(st, kFlagNegative))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0x11) {  // ORA izy
+    alu_ora(st, load(st, read_izy(st)));
+    NEXT;
+  }
+
+  CASE(0x15) {  // ORA zpx
+    alu_ora(st, load(st, addr_zpx(st)));
+    NEXT;
+  }
+
+  CASE(0x16) {  // ASL zpx
+    u16 addr = addr_zpx(st);
+    store(st, addr, alu_asl(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x18) {  // CLC
+    set_p(st, kFlagCarry, false);
+    NEXT;
+  }
+
+  CASE(0x19) {  // ORA aby
+    alu_ora(st, load(st, read_aby(st)));
+    NEXT;
+  }
+
+  CASE(0x1d) {  // ORA abx
+    alu_ora(st, load(st, read_abx(st)));
+    NEXT;
+  }
+
+  CASE(0x1e) {  // ASL abx
+    u16 addr = shift_abx(st);
+    store(st, addr, alu_asl(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x20) {  // JSR abs
+    u16 addr = addr_abs(st);
+    push_word(st, st->pc - 1);
+    st->pc = addr;
+    NEXT;
+  }
+
+  CASE(0x21) {  // AND izx
+    alu_and(st, load(st, addr_izx(st)));
+    NEXT;
+  }
+
+  CASE(0x24) {  // BIT zp
+    alu_bit(st, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0x25) {  // AND zp
+    alu_and(st, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0x26) {  // ROL zp
+    u16 addr = addr_zp(st);
+    store(st, addr, alu_rol(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x28) {  // PLP
+    unpack_p(st, pull(st));
+    set_p(st, KFlagUnused, true);
+    NEXT;
+  }
+
+  CASE(0x29) {  // AND imm
+    alu_and(st, fetch(st));
+    NEXT;
+  }
+
+  CASE(0x2a) {  // ROL
+    st->a = alu_rol(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x2c) {  // BIT abs
+    alu_bit(st, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0x2d) {  // AND abs
+    alu_and(st, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0x2e) {  // ROL abs
+    u16 addr = addr_abs(st);
+    store(st, addr, alu_rol(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x30) {  // BMI rel
+    if (branch(st, get_p(st, kFlagNegative))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0x31) {  // AND izy
+    alu_and(st, load(st, read_izy(st)));
+    NEXT;
+  }
+
+  CASE(0x35) {  // AND zpx
+    alu_and(st, load(st, addr_zpx(st)));
+    NEXT;
+  }
+
+  CASE(0x36) {  // ROL zpx
+    u16 addr = addr_zpx(st);
+    store(st, addr, alu_rol(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x38) {  // SEC
+    set_p(st, kFlagCarry, true);
+    NEXT;
+  }
+
+  CASE(0x39) {  // AND aby
+    alu_and(st, load(st, read_aby(st)));
+    NEXT;
+  }
+
+  CASE(0x3d) {  // AND abx
+    alu_and(st, load(st, read_abx(st)));
+    NEXT;
+  }
+
+  CASE(0x3e) {  // ROL abx
+    u16 addr = shift_abx(st);
+    store(st, addr, alu_rol(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x40) {  // RTI
+    unpack_p(st, pull(st));
+    set_p(st, kFlagBreak, false);
+    set_p(st, KFlagUnused, true);
+    st->pc = pull_word(st);
+    NEXT;
+  }
+
+  CASE(0x41) {  // EOR izx
+    alu_eor(st, load(st, addr_izx(st)));
+    NEXT;
+  }
+
+  CASE(0x45) {  // EOR zp
+    alu_eor(st, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0x46) {  // LSR zp
+    u16 addr = addr_zp(st);
+    store(st, addr, alu_lsr(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x48) {  // PHA
+    push(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x49) {  // EOR imm
+    alu_eor(st, fetch(st));
+    NEXT;
+  }
+
+  CASE(0x4a) {  // LSR
+    st->a = alu_lsr(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x4c) {  // JMP abs
+    st->pc = addr_abs(st);
+    NEXT;
+  }
+
+  CASE(0x4d) {  // EOR abs
+    alu_eor(st, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0x4e) {  // LSR abs
+    u16 addr = addr_abs(st);
+    store(st, addr, alu_lsr(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x50) {  // BVC rel
+    if (branch(st, !get_p(st, kFlagOverflow))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0x51) {  // EOR izy
+    alu_eor(st, load(st, read_izy(st)));
+    NEXT;
+  }
+
+  CASE(0x55) {  // EOR zpx
+    alu_eor(st, load(st, addr_zpx(st)));
+    NEXT;
+  }
+
+  CASE(0x56) {  // LSR zpx
+    u16 addr = addr_zpx(st);
+    store(st, addr, alu_lsr(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x58) {  // CLI
+    set_p(st, kFlagInterrupt, false);
+    NEXT;
+  }
+
+  CASE(0x59) {  // EOR aby
+    alu_eor(st, load(st, read_aby(st)));
+    NEXT;
+  }
+
+  CASE(0x5d) {  // EOR abx
+    alu_eor(st, load(st, read_abx(st)));
+    NEXT;
+  }
+
+  CASE(0x5e) {  // LSR abx
+    u16 addr = shift_abx(st);
+    store(st, addr, alu_lsr(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x60) {  // RTS
+    st->pc = pull_word(st) + 1;
+    NEXT;
+  }
+
+  CASE(0x61) {  // ADC izx
+    alu_adc(st, load(st, addr_izx(st)));
+    NEXT;
+  }
+
+  CASE(0x65) {  // ADC zp
+    alu_adc(st, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0x66) {  // ROR zp
+    u16 addr = addr_zp(st);
+    store(st, addr, alu_ror(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x68) {  // PLA
+    st->a = pull(st);
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x69) {  // ADC imm
+    alu_adc(st, fetch(st));
+    NEXT;
+  }
+
+  CASE(0x6a) {  // ROR
+    st->a = alu_ror(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x6c) {  // JMP ind
+    st->pc = addr_ind(st);
+    NEXT;
+  }
+
+  CASE(0x6d) {  // ADC abs
+    alu_adc(st, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0x6e) {  // ROR abs
+    u16 addr = addr_abs(st);
+    store(st, addr, alu_ror(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x70) {  // BVS rel
+    if (branch(st, get_p(st, kFlagOverflow))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0x71) {  // ADC izy
+    alu_adc(st, load(st, read_izy(st)));
+    NEXT;
+  }
+
+  CASE(0x75) {  // ADC zpx
+    alu_adc(st, load(st, addr_zpx(st)));
+    NEXT;
+  }
+
+  CASE(0x76) {  // ROR zpx
+    u16 addr = addr_zpx(st);
+    store(st, addr, alu_ror(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x78) {  // SEI
+    set_p(st, kFlagInterrupt, true);
+    NEXT;
+  }
+
+  CASE(0x79) {  // ADC aby
+    alu_adc(st, load(st, read_aby(st)));
+    NEXT;
+  }
+
+  CASE(0x7d) {  // ADC abx
+    alu_adc(st, load(st, read_abx(st)));
+    NEXT;
+  }
+
+  CASE(0x7e) {  // ROR abx
+    u16 addr = shift_abx(st);
+    store(st, addr, alu_ror(st, load(st, addr)));
+    NEXT;
+  }
+
+  CASE(0x81) {  // STA izx
+    store(st, addr_izx(st), st->a);
+    NEXT;
+  }
+
+  CASE(0x84) {  // STY zp
+    store(st, addr_zp(st), st->y);
+    NEXT;
+  }
+
+  CASE(0x85) {  // STA zp
+    store(st, addr_zp(st), st->a);
+    NEXT;
+  }
+
+  CASE(0x86) {  // STX zp
+    store(st, addr_zp(st), st->x);
+    NEXT;
+  }
+
+  CASE(0x88) {  // DEY
+    --st->y;
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0x8a) {  // TXA
+    st->a = st->x;
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x8c) {  // STY abs
+    store(st, addr_abs(st), st->y);
+    NEXT;
+  }
+
+  CASE(0x8d) {  // STA abs
+    store(st, addr_abs(st), st->a);
+    NEXT;
+  }
+
+  CASE(0x8e) {  // STX abs
+    store(st, addr_abs(st), st->x);
+    NEXT;
+  }
+
+  CASE(0x90) {  // BCC rel
+    if (branch(st, !get_p(st, kFlagCarry))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0x91) {  // STA izy
+    store(st, addr_izy(st), st->a);
+    NEXT;
+  }
+
+  CASE(0x94) {  // STY zpx
+    store(st, addr_zpx(st), st->y);
+    NEXT;
+  }
+
+  CASE(0x95) {  // STA zpx
+    store(st, addr_zpx(st), st->a);
+    NEXT;
+  }
+
+  CASE(0x96) {  // STX zpy
+    store(st, addr_zpy(st), st->x);
+    NEXT;
+  }
+
+  CASE(0x98) {  // TYA
+    st->a = st->y;
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0x99) {  // STA aby
+    store(st, addr_aby(st), st->a);
+    NEXT;
+  }
+
+  CASE(0x9a) {  // TXS
+    st->s = st->x;
+    NEXT;
+  }
+
+  CASE(0x9d) {  // STA abx
+    store(st, addr_abx(st), st->a);
+    NEXT;
+  }
+
+  CASE(0xa0) {  // LDY imm
+    st->y = fetch(st);
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xa1) {  // LDA izx
+    st->a = load(st, addr_izx(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xa2) {  // LDX imm
+    st->x = fetch(st);
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xa4) {  // LDY zp
+    st->y = load(st, addr_zp(st));
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xa5) {  // LDA zp
+    st->a = load(st, addr_zp(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xa6) {  // LDX zp
+    st->x = load(st, addr_zp(st));
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xa8) {  // TAY
+    st->y = st->a;
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xa9) {  // LDA imm
+    st->a = fetch(st);
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xaa) {  // TAX
+    st->x = st->a;
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xac) {  // LDY abs
+    st->y = load(st, addr_abs(st));
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xad) {  // LDA abs
+    st->a = load(st, addr_abs(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xae) {  // LDX abs
+    st->x = load(st, addr_abs(st));
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xb0) {  // BCS rel
+    if (branch(st, get_p(st, kFlagCarry))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0xb1) {  // LDA izy
+    st->a = load(st, read_izy(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xb4) {  // LDY zpx
+    st->y = load(st, addr_zpx(st));
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xb5) {  // LDA zpx
+    st->a = load(st, addr_zpx(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xb6) {  // LDX zpy
+    st->x = load(st, addr_zpy(st));
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xb8) {  // CLV
+    set_p(st, kFlagOverflow, false);
+    NEXT;
+  }
+
+  CASE(0xb9) {  // LDA aby
+    st->a = load(st, read_aby(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xba) {  // TSX
+    st->x = st->s;
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xbc) {  // LDY abx
+    st->y = load(st, read_abx(st));
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xbd) {  // LDA abx
+    st->a = load(st, read_abx(st));
+    set_p_nz(st, st->a);
+    NEXT;
+  }
+
+  CASE(0xbe) {  // LDX aby
+    st->x = load(st, read_aby(st));
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xc0) {  // CPY imm
+    alu_cmp(st, st->y, fetch(st));
+    NEXT;
+  }
+
+  CASE(0xc1) {  // CMP izx
+    alu_cmp(st, st->a, load(st, addr_izx(st)));
+    NEXT;
+  }
+
+  CASE(0xc4) {  // CPY zp
+    alu_cmp(st, st->y, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0xc5) {  // CMP zp
+    alu_cmp(st, st->a, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0xc6) {  // DEC zp
+    u16 addr = addr_zp(st);
+    u8 value = load(st, addr) - 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xc8) {  // INY
+    ++st->y;
+    set_p_nz(st, st->y);
+    NEXT;
+  }
+
+  CASE(0xc9) {  // CMP imm
+    alu_cmp(st, st->a, fetch(st));
+    NEXT;
+  }
+
+  CASE(0xca) {  // DEX
+    --st->x;
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xcc) {  // CPY abs
+    alu_cmp(st, st->y, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0xcd) {  // CMP abs
+    alu_cmp(st, st->a, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0xce) {  // DEC abs
+    u16 addr = addr_abs(st);
+    u8 value = load(st, addr) - 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xd0) {  // BNE rel
+    if (branch(st, !get_p(st, kFlagZero))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0xd1) {  // CMP izy
+    alu_cmp(st, st->a, load(st, read_izy(st)));
+    NEXT;
+  }
+
+  CASE(0xd5) {  // CMP zpx
+    alu_cmp(st, st->a, load(st, addr_zpx(st)));
+    NEXT;
+  }
+
+  CASE(0xd6) {  // DEC zpx
+    u16 addr = addr_zpx(st);
+    u8 value = load(st, addr) - 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xd8) {  // CLD
+    set_p(st, kFlagDecimal, false);
+    NEXT;
+  }
+
+  CASE(0xd9) {  // CMP aby
+    alu_cmp(st, st->a, load(st, read_aby(st)));
+    NEXT;
+  }
+
+  CASE(0xdd) {  // CMP abx
+    alu_cmp(st, st->a, load(st, read_abx(st)));
+    NEXT;
+  }
+
+  CASE(0xde) {  // DEC abx
+    u16 addr = addr_abx(st);
+    u8 value = load(st, addr) - 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xe0) {  // CPX imm
+    alu_cmp(st, st->x, fetch(st));
+    NEXT;
+  }
+
+  CASE(0xe1) {  // SBC izx
+    alu_sbc(st, load(st, addr_izx(st)));
+    NEXT;
+  }
+
+  CASE(0xe4) {  // CPX zp
+    alu_cmp(st, st->x, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0xe5) {  // SBC zp
+    alu_sbc(st, load(st, addr_zp(st)));
+    NEXT;
+  }
+
+  CASE(0xe6) {  // INC zp
+    u16 addr = addr_zp(st);
+    u8 value = load(st, addr) + 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xe8) {  // INX
+    ++st->x;
+    set_p_nz(st, st->x);
+    NEXT;
+  }
+
+  CASE(0xe9) {  // SBC imm
+    alu_sbc(st, fetch(st));
+    NEXT;
+  }
+
+  CASE(0xea) {  // NOP
+    NEXT;
+  }
+
+  CASE(0xeb) {  // SBC imm, undocumented
+    if (st->cmos) {
+      st->cycles -= 2;
+      undocumented(st);
+      NEXT;
+    }
+
+    alu_sbc(st, fetch(st));
+    NEXT;
+  }
+
+  CASE(0xec) {  // CPX abs
+    alu_cmp(st, st->x, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0xed) {  // SBC abs
+    alu_sbc(st, load(st, addr_abs(st)));
+    NEXT;
+  }
+
+  CASE(0xee) {  // INC abs
+    u16 addr = addr_abs(st);
+    u8 value = load(st, addr) + 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xf0) {  // BEQ rel
+    if (branch(st, get_p(st, kFlagZero))) {
+      NEXT_LOOP;
+    }
+    NEXT;
+  }
+
+  CASE(0xf1) {  // SBC izy
+    alu_sbc(st, load(st, read_izy(st)));
+    NEXT;
+  }
+
+  CASE(0xf5) {  // SBC zpx
+    alu_sbc(st, load(st, addr_zpx(st)));
+    NEXT;
+  }
+
+  CASE(0xf6) {  // INC zpx
+    u16 addr = addr_zpx(st);
+    u8 value = load(st, addr) + 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+  CASE(0xf8) {  // SED
+    set_p(st, kFlagDecimal, true);
+    NEXT;
+  }
+
+  CASE(0xf9) {  // SBC aby
+    alu_sbc(st, load(st, read_aby(st)));
+    NEXT;
+  }
+
+  CASE(0xfd) {  // SBC abx
+    alu_sbc(st, load(st, read_abx(st)));
+    NEXT;
+  }
+
+  CASE(0xfe) {  // INC abx
+    u16 addr = addr_abx(st);
+    u8 value = load(st, addr) + 1;
+    store(st, addr, value);
+    set_p_nz(st, value);
+    NEXT;
+  }
+
+#if defined(E6502_COMPUTED_GOTO)
+op_undocumented:
+  undocumented(st);
+  NEXT;
+#else
+      default:
+        undocumented(st);
+        break;
+    }
+
+    ++result.instructions;
+    if (run_should_stop(cpu, st->p, st->pc, st->cycles,
+                        max_instructions, max_cycles, &result)) {
+      goto out;
+    }
+  }
+#endif
+
+out:
+  // Running into a limit while idle tells the host that it may wait for I/O.
+  if (loop.idle && result.reason == kStopReasonLimit) {
+    result.reason = kStopReasonIdle;
+  }
+
+  result.cycles = st->cycles - start_cycles;
+  sync_out(st);
+  return result;
+}
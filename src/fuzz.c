@@ -0,0 +1,138 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+#define kRamSize 0x10000
+#define kInputAddr 0xffe0
+
+// Only the pages the bus flagged dirty are copied back from the baseline
+// between runs.
+struct Fuzzer {
+  struct Bus bus;
+  struct Cpu cpu;
+
+  u8* ram;
+  u8* baseline;
+
+  const u8* input;
+  size_t input_size;
+  size_t input_pos;
+};
+
+static u8 input_read(struct Fuzzer* fuzzer, u8 reg) {
+  size_t left = fuzzer->input_size - fuzzer->input_pos;
+  switch (reg) {
+    case kSerialData:
+      if (left == 0) {
+        cpu_stop(&fuzzer->cpu);
+        return 0;
+      }
+
+      return fuzzer->input[fuzzer->input_pos++];
+    case kSerialRxDepth:
+      return left > 0xff ? 0xff : left;
+    default:
+      return 0;
+  }
+}
+
+static u8 fuzzer_read(void* ctx, u16 addr) {
+  struct Fuzzer* fuzzer = ctx;
+  if (addr >= kInputAddr && addr < kInputAddr + kSerialNumRegisters) {
+    return input_read(fuzzer, addr - kInputAddr);
+  }
+
+  return fuzzer->ram[addr];
+}
+
+// Output and writes to pages rom_load() mapped from the image are dropped.
+static void fuzzer_write(void* ctx, u16 addr, u8 data) {
+  struct Fuzzer* fuzzer = ctx;
+  if (addr >> 8 == 0xff &&
+      (addr < kInputAddr || addr >= kInputAddr + kSerialNumRegisters)) {
+    fuzzer->ram[addr] = data;
+  }
+}
+
+struct Fuzzer* fuzzer_new(const struct Rom* rom, enum CpuVariant variant,
+                          u8* coverage) {
+  struct Fuzzer* fuzzer = calloc(1, sizeof(struct Fuzzer));
+  if (!fuzzer) {
+    return NULL;
+  }
+
+  fuzzer->ram = calloc(kRamSize, sizeof(u8));
+  fuzzer->baseline = malloc(kRamSize);
+  if (!fuzzer->ram || !fuzzer->baseline) {
+    free(fuzzer->ram);
+    free(fuzzer->baseline);
+    free(fuzzer);
+    return NULL;
+  }
+
+  fuzzer->bus = (struct Bus){
+      .ctx = fuzzer,
+      .read = fuzzer_read,
+      .write = fuzzer_write,
+  };
+
+  // The same machine as the e6502 app, with the input device in place of the
+  // serial one.
+  bus_map_ram(&fuzzer->bus, 0x00, 0xff, fuzzer->ram);
+  rom_load(rom, &fuzzer->bus, fuzzer->ram);
+  memcpy(fuzzer->baseline, fuzzer->ram, kRamSize);
+
+  cpu_init(&fuzzer->cpu, &fuzzer->bus, variant);
+  cpu_set_coverage(&fuzzer->cpu, coverage);
+  return fuzzer;
+}
+
+void fuzzer_free(struct Fuzzer* fuzzer) {
+  if (!fuzzer) {
+    return;
+  }
+
+  cpu_destroy(&fuzzer->cpu);
+  free(fuzzer->ram);
+  free(fuzzer->baseline);
+  free(fuzzer);
+}
+
+static void fuzzer_reset(struct Fuzzer* fuzzer) {
+  struct Bus* bus = &fuzzer->bus;
+  struct Cpu* cpu = &fuzzer->cpu;
+
+  // Blocks decoded from what the last run wrote go stale once restored.
+  struct BlockCache* cache = cpu->blocks;
+  for (int page = 0; cache && page < 256; ++page) {
+    if (bus->dirty[page] && cache->code[page]) {
+      cache->code[page] = false;
+      ++cache->generation[page];
+    }
+  }
+
+  bus_reset_dirty(bus, fuzzer->baseline);
+  if (bus->dirty[0xff]) {
+    memcpy(fuzzer->ram + 0xff00, fuzzer->baseline + 0xff00, 0x100);
+  }
+
+  bus_clear_dirty(bus);
+
+  cpu->interrupts = kInterruptTypeNone;
+  cpu->stop_requested = false;
+  cpu->jammed = false;
+  cpu->cycles = 0;
+  cpu_reset(cpu);
+}
+
+struct RunResult fuzzer_run(struct Fuzzer* fuzzer, const u8* input,
+                            size_t size, u64 max_cycles) {
+  fuzzer_reset(fuzzer);
+  fuzzer->input = input;
+  fuzzer->input_size = size;
+  fuzzer->input_pos = 0;
+  return run_until(&fuzzer->cpu, UINT64_MAX,
+                   max_cycles ? max_cycles : UINT64_MAX);
+}
@@ -0,0 +1,140 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "cpu.h"
+
+// Idle loop detection of the table and fused cores. The block core does the
+// same on its decoded blocks, see skip_idle() in block.c.
+
+#define kMaxLoopInstructions 16
+
+bool reads_only(void (*op)(struct Cpu* cpu, u16 addr, bool implied),
+                enum AddrMode addr_mode) {
+  if (op == op_asl || op == op_lsr || op == op_rol || op == op_ror) {
+    return addr_mode == kAddrModeImplied;
+  }
+
+  return op == op_lda || op == op_ldx || op == op_ldy || op == op_cmp ||
+         op == op_cpx || op == op_cpy || op == op_bit || op == op_and ||
+         op == op_ora || op == op_eor || op == op_adc || op == op_sbc ||
+         op == op_tax || op == op_tay || op == op_txa || op == op_tya ||
+         op == op_tsx || op == op_inx || op == op_iny || op == op_dex ||
+         op == op_dey || op == op_clc || op == op_sec || op == op_clv ||
+         op == op_nop || op == op_bit_imm;
+}
+
+bool callback_reads_pure(const struct Cpu* cpu) {
+  if (cpu->num_callback_reads > kMaxCallbackReads) {
+    return false;
+  }
+
+  const struct Bus* bus = cpu->bus;
+  for (u64 i = 0; i < cpu->num_callback_reads; ++i) {
+    bool pure = false;
+    for (u8 j = 0; j < bus->num_pure_reads && !pure; ++j) {
+      pure = bus->pure_reads[j] == cpu->callback_reads[i];
+    }
+
+    if (!pure) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Code is only scanned from pages in the read page table, fetching it through
+// the callback could have side effects.
+static bool peek(const struct Bus* bus, u16 addr, u8* data) {
+  const u8* page = bus->read_pages[addr >> 8];
+  if (!page) {
+    return false;
+  }
+
+  *data = page[addr & 0x00ff];
+  return true;
+}
+
+// Returns the number of instructions from target up to and including the
+// first branch if it branches back to target and all the others only read
+// memory, 0 otherwise.
+static u8 polling_loop(const struct Cpu* cpu, u16 target) {
+  u16 addr = target;
+  for (u8 count = 1; count <= kMaxLoopInstructions; ++count) {
+    u8 opcode;
+    if (!peek(cpu->bus, addr, &opcode)) {
+      return 0;
+    }
+
+    const struct OpcodeInfo* info = opcode_info(cpu->variant, opcode);
+    u16 end = addr + info->bytes;
+    if (info->addr_mode == kAddrModeRel || info->addr_mode == kAddrModeZpr) {
+      u8 offset;
+      if (!peek(cpu->bus, end - 1, &offset)) {
+        return 0;
+      }
+
+      u16 back = end + (offset & 0x80 ? offset | 0xff00 : offset);
+      return back == target ? count : 0;
+    }
+
+    if (!reads_only(cpu->instructions[opcode].op_impl, info->addr_mode)) {
+      return 0;
+    }
+
+    addr = end;
+  }
+
+  return 0;
+}
+
+// Once an iteration of a loop that only polls memory leaves the registers as
+// the previous one did, and read nothing through the callback other than
+// addresses marked with bus_add_pure_read(), every further iteration does the
+// same until a device or the host changes what the loop reads. Such
+// iterations are skipped, stopping short of the limits so that the run ends
+// exactly where it would have. The caller has made the stop checks after the
+// branch, a trap or breakpoint within the loop stops it before it gets here.
+// The loop is scanned again before skipping in case its code was changed.
+u64 idle_branch(struct Cpu* cpu, struct IdleLoop* loop, u64 instructions,
+                u64 max_instructions, u64 max_cycles) {
+  u16 target = cpu->pc;
+  u8 regs[5] = {cpu->a, cpu->x, cpu->y, cpu->s, pack_flags(cpu)};
+  bool idle = false;
+  if (loop->count > 0 && loop->target == target) {
+    idle = callback_reads_pure(cpu) &&
+           instructions - loop->instructions == loop->count &&
+           memcmp(regs, loop->regs, sizeof(regs)) == 0 &&
+           polling_loop(cpu, target) == loop->count;
+  } else {
+    u8 count = polling_loop(cpu, target);
+    if (count == 0) {
+      loop->rejected[target % kIdleRejects] = 0x10000u | target;
+      return 0;
+    }
+
+    loop->target = target;
+    loop->count = count;
+  }
+
+  u64 cycles = cpu->cycles - loop->cycles;
+  loop->cycles = cpu->cycles;
+  loop->instructions = instructions;
+  memcpy(loop->regs, regs, sizeof(regs));
+  cpu->num_callback_reads = 0;
+  if (!idle) {
+    return 0;
+  }
+
+  loop->idle = true;
+  u64 skip = (max_cycles - cpu->cycles - 1) / cycles;
+  u64 iterations = (max_instructions - instructions - 1) / loop->count;
+  if (iterations < skip) {
+    skip = iterations;
+  }
+
+  cpu->cycles += skip * cycles;
+  loop->cycles = cpu->cycles;
+  loop->instructions += skip * loop->count;
+  return skip * loop->count;
+}
@@ -2,328 +2,282 @@
 #include <stdlib.h>
 
 #include "cpu.h"
+#include "opcodes.h"
 
-static void addr_mode_imm(struct Cpu* cpu, u16* addr) { *addr = cpu->pc++; }
+static bool addr_mode_imm(struct Cpu* cpu, u16* addr) {
+  *addr = cpu->pc++;
+  return false;
+}
 
-static void addr_mode_zp(struct Cpu* cpu, u16* addr) {
-  *addr = read(cpu, cpu->pc++) & 0x00ff;
+static bool addr_mode_zp(struct Cpu* cpu, u16* addr) {
+  *addr = bus_load(cpu, cpu->pc++) & 0x00ff;
+  return false;
 }
 
-static void addr_mode_zpx(struct Cpu* cpu, u16* addr) {
-  *addr = (read(cpu, cpu->pc++) + cpu->x) & 0x00ff;
+static bool addr_mode_zpx(struct Cpu* cpu, u16* addr) {
+  *addr = (bus_load(cpu, cpu->pc++) + cpu->x) & 0x00ff;
+  return false;
 }
 
-static void addr_mode_zpy(struct Cpu* cpu, u16* addr) {
-  *addr = (read(cpu, cpu->pc++) + cpu->y) & 0x00ff;
+static bool addr_mode_zpy(struct Cpu* cpu, u16* addr) {
+  *addr = (bus_load(cpu, cpu->pc++) + cpu->y) & 0x00ff;
+  return false;
 }
 
-static void addr_mode_rel(struct Cpu* cpu, u16* addr) {
-  *addr = read(cpu, cpu->pc++);
+// The branch ops account for their own taken and page crossing cycles.
+static bool addr_mode_rel(struct Cpu* cpu, u16* addr) {
+  *addr = bus_load(cpu, cpu->pc++);
   if (*addr & 0x0080) {
     *addr |= 0xff00;
   }
+
+  return false;
 }
 
-static void addr_mode_abs(struct Cpu* cpu, u16* addr) {
-  u16 lo = read(cpu, cpu->pc++);
-  u16 hi = read(cpu, cpu->pc++);
+static bool addr_mode_abs(struct Cpu* cpu, u16* addr) {
+  u16 lo = bus_load(cpu, cpu->pc++);
+  u16 hi = bus_load(cpu, cpu->pc++);
   *addr = (hi << 8) | lo;
+  return false;
 }
 
-static void addr_mode_abx(struct Cpu* cpu, u16* addr) {
-  u16 lo = read(cpu, cpu->pc++);
-  u16 hi = read(cpu, cpu->pc++);
+static bool addr_mode_abx(struct Cpu* cpu, u16* addr) {
+  u16 lo = bus_load(cpu, cpu->pc++);
+  u16 hi = bus_load(cpu, cpu->pc++);
   *addr = ((hi << 8) | lo) + cpu->x;
+  return (*addr & 0xff00) != (hi << 8);
 }
 
-static void addr_mode_aby(struct Cpu* cpu, u16* addr) {
-  u16 lo = read(cpu, cpu->pc++);
-  u16 hi = read(cpu, cpu->pc++);
+static bool addr_mode_aby(struct Cpu* cpu, u16* addr) {
+  u16 lo = bus_load(cpu, cpu->pc++);
+  u16 hi = bus_load(cpu, cpu->pc++);
   *addr = ((hi << 8) | lo) + cpu->y;
+  return (*addr & 0xff00) != (hi << 8);
 }
 
-static void addr_mode_ind(struct Cpu* cpu, u16* addr) {
-  u16 lo = read(cpu, cpu->pc++);
-  u16 hi = read(cpu, cpu->pc++);
+// The NMOS chip does not carry into the high byte of the pointer.
+static bool addr_mode_ind(struct Cpu* cpu, u16* addr) {
+  u16 lo = bus_load(cpu, cpu->pc++);
+  u16 hi = bus_load(cpu, cpu->pc++);
   u16 a = (hi << 8) | lo;
-  if (lo == 0x00ff) {
-    *addr = (read(cpu, a & 0xff00) << 8) | read(cpu, a);
+  if (lo == 0x00ff && cpu->variant == kCpuVariantNmos) {
+    *addr = (bus_load(cpu, a & 0xff00) << 8) | bus_load(cpu, a);
   } else {
-    *addr = (read(cpu, a + 1) << 8) | read(cpu, a);
+    *addr = (bus_load(cpu, a + 1) << 8) | bus_load(cpu, a);
   }
+
+  return false;
 }
 
-static void addr_mode_izx(struct Cpu* cpu, u16* addr) {
-  u16 a = read(cpu, cpu->pc++);
-  u16 lo = read(cpu, (a + cpu->x) & 0x00ff);
-  u16 hi = read(cpu, (a + cpu->x + 1) & 0x00ff);
+static bool addr_mode_izx(struct Cpu* cpu, u16* addr) {
+  u16 a = bus_load(cpu, cpu->pc++);
+  u16 lo = bus_load(cpu, (a + cpu->x) & 0x00ff);
+  u16 hi = bus_load(cpu, (a + cpu->x + 1) & 0x00ff);
   *addr = (hi << 8) | lo;
+  return false;
 }
 
-static void addr_mode_izy(struct Cpu* cpu, u16* addr) {
-  u16 a = read(cpu, cpu->pc++);
-  u16 lo = read(cpu, a & 0x00ff);
-  u16 hi = read(cpu, (a + 1) & 0x00ff);
+static bool addr_mode_izy(struct Cpu* cpu, u16* addr) {
+  u16 a = bus_load(cpu, cpu->pc++);
+  u16 lo = bus_load(cpu, a & 0x00ff);
+  u16 hi = bus_load(cpu, (a + 1) & 0x00ff);
   *addr = ((hi << 8) | lo) + cpu->y;
+  return (*addr & 0xff00) != (hi << 8);
+}
+
+static bool addr_mode_izp(struct Cpu* cpu, u16* addr) {
+  u16 a = bus_load(cpu, cpu->pc++);
+  u16 lo = bus_load(cpu, a);
+  u16 hi = bus_load(cpu, (a + 1) & 0x00ff);
+  *addr = (hi << 8) | lo;
+  return false;
+}
+
+static bool addr_mode_iax(struct Cpu* cpu, u16* addr) {
+  u16 lo = bus_load(cpu, cpu->pc++);
+  u16 hi = bus_load(cpu, cpu->pc++);
+  u16 a = ((hi << 8) | lo) + cpu->x;
+  *addr = (bus_load(cpu, a + 1) << 8) | bus_load(cpu, a);
+  return false;
+}
+
+// BBR and BBS get the zero page address in the low byte and the branch offset
+// in the high byte, as the block core decodes the operand.
+static bool addr_mode_zpr(struct Cpu* cpu, u16* addr) {
+  u16 lo = bus_load(cpu, cpu->pc++);
+  u16 hi = bus_load(cpu, cpu->pc++);
+  *addr = (hi << 8) | lo;
+  return false;
 }
 
-static void op_xxx(struct Cpu* cpu, u16 addr, bool implied) {}
-
-struct Instruction instructions[256] = {
-    {.name = "BRK", .op_impl = op_brk, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_zp},
-    {.name = "ASL", .op_impl = op_asl, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "PHP", .op_impl = op_php, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_imm},
-    {.name = "ASL", .op_impl = op_asl, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_abs},
-    {.name = "ASL", .op_impl = op_asl, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BPL", .op_impl = op_bpl, .addr_mode = addr_mode_rel},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_zpx},
-    {.name = "ASL", .op_impl = op_asl, .addr_mode = addr_mode_zpx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CLC", .op_impl = op_clc, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_aby},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ORA", .op_impl = op_ora, .addr_mode = addr_mode_abx},
-    {.name = "ASL", .op_impl = op_asl, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "JSR", .op_impl = op_jsr, .addr_mode = addr_mode_abs},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BIT", .op_impl = op_bit, .addr_mode = addr_mode_zp},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_zp},
-    {.name = "ROL", .op_impl = op_rol, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "PLP", .op_impl = op_plp, .addr_mode = NULL},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_imm},
-    {.name = "ROL", .op_impl = op_rol, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BIT", .op_impl = op_bit, .addr_mode = addr_mode_abs},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_abs},
-    {.name = "ROL", .op_impl = op_rol, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BMI", .op_impl = op_bmi, .addr_mode = addr_mode_rel},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_zpx},
-    {.name = "ROL", .op_impl = op_rol, .addr_mode = addr_mode_zpx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "SEC", .op_impl = op_sec, .addr_mode = NULL},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_aby},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "AND", .op_impl = op_and, .addr_mode = addr_mode_abx},
-    {.name = "ROL", .op_impl = op_rol, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "RTI", .op_impl = op_rti, .addr_mode = NULL},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_zp},
-    {.name = "LSR", .op_impl = op_lsr, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "PHA", .op_impl = op_pha, .addr_mode = NULL},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_imm},
-    {.name = "LSR", .op_impl = op_lsr, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "JMP", .op_impl = op_jmp, .addr_mode = addr_mode_abs},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_abs},
-    {.name = "LSR", .op_impl = op_lsr, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BVC", .op_impl = op_bvc, .addr_mode = addr_mode_rel},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_zpx},
-    {.name = "LSR", .op_impl = op_lsr, .addr_mode = addr_mode_zpx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CLI", .op_impl = op_cli, .addr_mode = NULL},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_aby},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "EOR", .op_impl = op_eor, .addr_mode = addr_mode_abx},
-    {.name = "LSR", .op_impl = op_lsr, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "RTS", .op_impl = op_rts, .addr_mode = NULL},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_zp},
-    {.name = "ROR", .op_impl = op_ror, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "PLA", .op_impl = op_pla, .addr_mode = NULL},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_imm},
-    {.name = "ROR", .op_impl = op_ror, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "JMP", .op_impl = op_jmp, .addr_mode = addr_mode_ind},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_abs},
-    {.name = "ROR", .op_impl = op_ror, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BVS", .op_impl = op_bvs, .addr_mode = addr_mode_rel},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_zpx},
-    {.name = "ROR", .op_impl = op_ror, .addr_mode = addr_mode_zpx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "SEI", .op_impl = op_sei, .addr_mode = NULL},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_aby},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "ADC", .op_impl = op_adc, .addr_mode = addr_mode_abx},
-    {.name = "ROR", .op_impl = op_ror, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "STY", .op_impl = op_sty, .addr_mode = addr_mode_zp},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_zp},
-    {.name = "STX", .op_impl = op_stx, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "DEY", .op_impl = op_dey, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "TXA", .op_impl = op_txa, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "STY", .op_impl = op_sty, .addr_mode = addr_mode_abs},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_abs},
-    {.name = "STX", .op_impl = op_stx, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BCC", .op_impl = op_bcc, .addr_mode = addr_mode_rel},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "STY", .op_impl = op_sty, .addr_mode = addr_mode_zpx},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_zpx},
-    {.name = "STX", .op_impl = op_stx, .addr_mode = addr_mode_zpy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "TYA", .op_impl = op_tya, .addr_mode = NULL},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_aby},
-    {.name = "TXS", .op_impl = op_txs, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "STA", .op_impl = op_sta, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "LDY", .op_impl = op_ldy, .addr_mode = addr_mode_imm},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_izx},
-    {.name = "LDX", .op_impl = op_ldx, .addr_mode = addr_mode_imm},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "LDY", .op_impl = op_ldy, .addr_mode = addr_mode_zp},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_zp},
-    {.name = "LDX", .op_impl = op_ldx, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "TAY", .op_impl = op_tay, .addr_mode = NULL},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_imm},
-    {.name = "TAX", .op_impl = op_tax, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "LDY", .op_impl = op_ldy, .addr_mode = addr_mode_abs},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_abs},
-    {.name = "LDX", .op_impl = op_ldx, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BCS", .op_impl = op_bcs, .addr_mode = addr_mode_rel},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "LDY", .op_impl = op_ldy, .addr_mode = addr_mode_zpx},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_zpx},
-    {.name = "LDX", .op_impl = op_ldx, .addr_mode = addr_mode_zpy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CLV", .op_impl = op_clv, .addr_mode = NULL},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_aby},
-    {.name = "TSX", .op_impl = op_tsx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "LDY", .op_impl = op_ldy, .addr_mode = addr_mode_abx},
-    {.name = "LDA", .op_impl = op_lda, .addr_mode = addr_mode_abx},
-    {.name = "LDX", .op_impl = op_ldx, .addr_mode = addr_mode_aby},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CPY", .op_impl = op_cpy, .addr_mode = addr_mode_imm},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CPY", .op_impl = op_cpy, .addr_mode = addr_mode_zp},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_zp},
-    {.name = "DEC", .op_impl = op_dec, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "INY", .op_impl = op_iny, .addr_mode = NULL},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_imm},
-    {.name = "DEX", .op_impl = op_dex, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CPY", .op_impl = op_cpy, .addr_mode = addr_mode_abs},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_abs},
-    {.name = "DEC", .op_impl = op_dec, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BNE", .op_impl = op_bne, .addr_mode = addr_mode_rel},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_zpx},
-    {.name = "DEC", .op_impl = op_dec, .addr_mode = addr_mode_zpx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CLD", .op_impl = op_cld, .addr_mode = NULL},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_aby},
-    {.name = "NOP", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "CMP", .op_impl = op_cmp, .addr_mode = addr_mode_abx},
-    {.name = "DEC", .op_impl = op_dec, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CPX", .op_impl = op_cpx, .addr_mode = addr_mode_imm},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_izx},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "CPX", .op_impl = op_cpx, .addr_mode = addr_mode_zp},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_zp},
-    {.name = "INC", .op_impl = op_inc, .addr_mode = addr_mode_zp},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "INX", .op_impl = op_inx, .addr_mode = NULL},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_imm},
-    {.name = "NOP", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_sbc, .addr_mode = NULL},
-    {.name = "CPX", .op_impl = op_cpx, .addr_mode = addr_mode_abs},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_abs},
-    {.name = "INC", .op_impl = op_inc, .addr_mode = addr_mode_abs},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "BEQ", .op_impl = op_beq, .addr_mode = addr_mode_rel},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_izy},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_zpx},
-    {.name = "INC", .op_impl = op_inc, .addr_mode = addr_mode_zpx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "SED", .op_impl = op_sed, .addr_mode = NULL},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_aby},
-    {.name = "NOP", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
-    {.name = "???", .op_impl = op_nop, .addr_mode = NULL},
-    {.name = "SBC", .op_impl = op_sbc, .addr_mode = addr_mode_abx},
-    {.name = "INC", .op_impl = op_inc, .addr_mode = addr_mode_abx},
-    {.name = "???", .op_impl = op_xxx, .addr_mode = NULL},
+// Per addressing mode: the function, the length and the cycles of a read,
+// and whether indexing can cross a page.
+#define MODE_Implied(F) F(NULL, 1, 2, 0)
+#define MODE_Imm(F) F(addr_mode_imm, 2, 2, 0)
+#define MODE_Zp(F) F(addr_mode_zp, 2, 3, 0)
+#define MODE_Zpx(F) F(addr_mode_zpx, 2, 4, 0)
+#define MODE_Zpy(F) F(addr_mode_zpy, 2, 4, 0)
+#define MODE_Rel(F) F(addr_mode_rel, 2, 2, 0)
+#define MODE_Abs(F) F(addr_mode_abs, 3, 4, 0)
+#define MODE_Abx(F) F(addr_mode_abx, 3, 4, 1)
+#define MODE_Aby(F) F(addr_mode_aby, 3, 4, 1)
+#define MODE_Ind(F) F(addr_mode_ind, 3, 5, 0)
+#define MODE_Izx(F) F(addr_mode_izx, 2, 6, 0)
+#define MODE_Izy(F) F(addr_mode_izy, 2, 5, 1)
+#define MODE_Izp(F) F(addr_mode_izp, 2, 5, 0)
+#define MODE_Iax(F) F(addr_mode_iax, 3, 6, 0)
+#define MODE_Zpr(F) F(addr_mode_zpr, 3, 5, 0)
+
+#define MODE_FN(fn, bytes, cycles, indexed) fn
+#define MODE_BYTES(fn, bytes, cycles, indexed) bytes
+#define MODE_CYCLES(fn, bytes, cycles, indexed) cycles
+#define MODE_INDEXED(fn, bytes, cycles, indexed) indexed
+
+#define INSTRUCTION(code, mnemonic, op, mode, base_cycles, page, acc, doc, \
+                    stab)                                                  \
+  [code] = {                                                               \
+      .op_impl = op_##op,                                                  \
+      .addr_mode = MODE_##mode(MODE_FN),                                   \
+      .cycles = base_cycles,                                               \
+      .page_cycle = page,                                                  \
+  },
+
+// The 65C02 runs the W65C02 rows of the CMOS matrix as single byte NOPs.
+#define ROW_65C02(X, code, mnemonic, op, mode, base_cycles, page, acc, doc, \
+                  wdc)                                                     \
+  ROW_65C02_##wdc(X, code, mnemonic, op, mode, base_cycles, page, acc, doc)
+#define ROW_65C02_0(X, code, mnemonic, op, mode, base_cycles, page, acc, doc) \
+  X(code, mnemonic, op, mode, base_cycles, page, acc, doc, 1)
+#define ROW_65C02_1(X, code, mnemonic, op, mode, base_cycles, page, acc, doc) \
+  X(code, "NOP", nop, Implied, 1, 0, None, 0, 1)
+#define ROW_W65C02(X, code, mnemonic, op, mode, base_cycles, page, acc, doc, \
+                   wdc)                                                     \
+  X(code, mnemonic, op, mode, base_cycles, page, acc, doc, 1)
+
+#define INSTRUCTION_65C02(...) ROW_65C02(INSTRUCTION, __VA_ARGS__)
+#define INSTRUCTION_W65C02(...) ROW_W65C02(INSTRUCTION, __VA_ARGS__)
+
+const struct Instruction instructions[kNumCpuVariants][256] = {
+    [kCpuVariantNmos] = {OPCODES(INSTRUCTION)},
+    [kCpuVariant65c02] = {OPCODES_CMOS(INSTRUCTION_65C02)},
+    [kCpuVariantW65c02] = {OPCODES_CMOS(INSTRUCTION_W65C02)},
 };
+
+#define OPCODE_INFO(code, mnemonic, op, mode, base_cycles, page, acc, doc, \
+                    stab)                                                  \
+  [code] = {                                                               \
+      .name = mnemonic,                                                    \
+      .addr_mode = kAddrMode##mode,                                        \
+      .access = kOpcodeAccess##acc,                                        \
+      .bytes = MODE_##mode(MODE_BYTES),                                    \
+      .cycles = base_cycles,                                               \
+      .page_cycle = page,                                                  \
+      .documented = doc,                                                   \
+      .stable = stab,                                                      \
+  },
+
+#define OPCODE_INFO_65C02(...) ROW_65C02(OPCODE_INFO, __VA_ARGS__)
+#define OPCODE_INFO_W65C02(...) ROW_W65C02(OPCODE_INFO, __VA_ARGS__)
+
+static const struct OpcodeInfo opcode_infos[kNumCpuVariants][256] = {
+    [kCpuVariantNmos] = {OPCODES(OPCODE_INFO)},
+    [kCpuVariant65c02] = {OPCODES_CMOS(OPCODE_INFO_65C02)},
+    [kCpuVariantW65c02] = {OPCODES_CMOS(OPCODE_INFO_W65C02)},
+};
+
+// https://www.pagetable.com/c64ref/6502/
+// https://www.nesdev.org/wiki/Visual6502wiki/6502_all_256_Opcodes
+#define LO(opcode) ((opcode) & 0x0f)
+#define HI(opcode) ((opcode) >> 4)
+
+#define NMOS_BYTES(opcode)                                                \
+  (LO(opcode) == 0x00                                                     \
+       ? ((opcode) == 0x20                       ? 3                      \
+          : HI(opcode) >= 0x07 || HI(opcode) & 1 ? 2                      \
+                                                 : 1)                     \
+   : LO(opcode) == 0x01 || (LO(opcode) >= 0x03 && LO(opcode) <= 0x07) ? 2 \
+   : LO(opcode) == 0x02 ? (HI(opcode) <= 0x07 || HI(opcode) & 1 ? 1 : 2)  \
+   : LO(opcode) == 0x08 || LO(opcode) == 0x0a ? 1                         \
+   : LO(opcode) == 0x09 || LO(opcode) == 0x0b ? (HI(opcode) & 1 ? 3 : 2)  \
+                                              : 3)
+
+// Writes always take the indexing cycle, read-modify-writes add a read and
+// a write on top.
+#define ACCESS_CYCLES(acc, mode)                                           \
+  (MODE_##mode(MODE_CYCLES) +                                              \
+   (kOpcodeAccess##acc != kOpcodeAccessRead) * MODE_##mode(MODE_INDEXED) + \
+   2 * (kOpcodeAccess##acc == kOpcodeAccessRmw))
+
+#define ROW(code, mnemonic, op, mode, base_cycles, page, acc, doc, stab) \
+  kOpcodeRow##code,
+
+enum { OPCODES(ROW) kNumOpcodeRows };
+
+_Static_assert(kNumOpcodeRows == 256, "one row per opcode");
+
+#define CHECK(code, mnemonic, op, mode, base_cycles, page, acc, doc, stab) \
+  _Static_assert(kOpcodeRow##code == code, "row out of order");            \
+  _Static_assert(MODE_##mode(MODE_BYTES) == NMOS_BYTES(code),              \
+                 "length of " mnemonic);                                   \
+  _Static_assert(page == (kOpcodeAccess##acc == kOpcodeAccessRead &&       \
+                          MODE_##mode(MODE_INDEXED)),                      \
+                 "page crossing cycle of " mnemonic);                      \
+  _Static_assert(kOpcodeAccess##acc == kOpcodeAccessNone ||                \
+                     base_cycles == ACCESS_CYCLES(acc, mode),              \
+                 "cycles of " mnemonic);                                   \
+  _Static_assert(!doc || stab, "documented " mnemonic " is stable");
+
+OPCODES(CHECK)
+
+// The 65C02 fills the gaps of the matrix with one, two and three byte NOPs and
+// has three byte BBR and BBS in column 0x0f.
+#define CMOS_BYTES(opcode)                                                \
+  (LO(opcode) == 0x00 ? NMOS_BYTES(opcode)                                \
+   : LO(opcode) == 0x03 || LO(opcode) == 0x08 || LO(opcode) == 0x0a ||    \
+           LO(opcode) == 0x0b                                             \
+       ? 1                                                                \
+   : LO(opcode) == 0x09 ? (HI(opcode) & 1 ? 3 : 2)                        \
+   : LO(opcode) >= 0x0c ? 3                                               \
+                        : 2)
+
+#define CMOS_ROW(code, mnemonic, op, mode, base_cycles, page, acc, doc, wdc) \
+  kCmosRow##code,
+
+enum { OPCODES_CMOS(CMOS_ROW) kNumCmosRows };
+
+_Static_assert(kNumCmosRows == 256, "one row per opcode");
+
+// Shifts and rotates of an indexed address only take the indexing cycle when
+// the index crosses a page on the 65C02.
+#define CMOS_CHECK(code, mnemonic, op, mode, base_cycles, page, acc, doc, \
+                   wdc)                                                   \
+  _Static_assert(kCmosRow##code == code, "row out of order");             \
+  _Static_assert(MODE_##mode(MODE_BYTES) == CMOS_BYTES(code),             \
+                 "length of " mnemonic);                                  \
+  _Static_assert(!page || MODE_##mode(MODE_INDEXED),                      \
+                 "page crossing cycle of " mnemonic);                     \
+  _Static_assert(kOpcodeAccess##acc == kOpcodeAccessNone ||               \
+                     base_cycles ==                                       \
+                         ACCESS_CYCLES(acc, mode) -                       \
+                             (page &&                                     \
+                              kOpcodeAccess##acc == kOpcodeAccessRmw),    \
+                 "cycles of " mnemonic);                                  \
+  _Static_assert(!wdc || doc, "W65C02 " mnemonic " is documented");
+
+OPCODES_CMOS(CMOS_CHECK)
+
+const struct OpcodeInfo* opcode_info(enum CpuVariant variant, u8 opcode) {
+  return opcode_infos[variant] + opcode;
+}
+
+const char* opcode_name(enum CpuVariant variant, u8 opcode) {
+  return opcode_infos[variant][opcode].name;
+}
+
+enum AddrMode opcode_addr_mode(enum CpuVariant variant, u8 opcode) {
+  return opcode_infos[variant][opcode].addr_mode;
+}
+
+u8 opcode_bytes(enum CpuVariant variant, u8 opcode) {
+  return opcode_infos[variant][opcode].bytes;
+}
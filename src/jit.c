@@ -0,0 +1,1171 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "cpu.h"
+
+// x86-64 translator for hot blocks of the block core. The native code keeps
+// the 6502 registers in host registers, zero extended to 32 bits, and uses the
+// same lazy flag representation as the interpreter. It accesses memory only
+// through the page tables. An access to an unmapped page (MMIO), a write to a
+// page that blocks were decoded from or an instruction it does not translate
+// makes it store the registers and return, and the interpreter continues from
+// that instruction.
+
+#define kJitBufferSize (4 << 20)
+#define kMaxExits 128
+
+enum Reg {
+  kRax,
+  kRcx,
+  kRdx,
+  kRbx,
+  kRsp,
+  kRbp,
+  kRsi,
+  kRdi,
+  kR8,
+  kR9,
+  kR10,
+  kR11,
+  kR12,
+  kR13,
+  kR14,
+  kR15,
+};
+
+// Register map of the native code.
+#define kRegCpu kRdi
+#define kRegReadPages kRsi
+#define kRegWritePages kRdx
+#define kRegCode kRcx
+#define kRegA kR8
+#define kRegX kR9
+#define kRegY kR10
+#define kRegS kR11
+#define kRegN kRbx
+#define kRegZ kRbp
+#define kRegC kR12
+#define kRegV kR13
+#define kRegValue kR14
+#define kRegPage kR15
+#define kRegAddr kRax
+
+#define kNoIndex -1
+
+enum AluOp {
+  kAluAdd = 0,
+  kAluOr = 1,
+  kAluAnd = 4,
+  kAluSub = 5,
+  kAluXor = 6,
+  kAluCmp = 7,
+};
+
+enum Cond {
+  kCondZ = 0x4,
+  kCondNz = 0x5,
+};
+
+struct Jit {
+  u8* buffer;
+  size_t used;
+  bool full;
+};
+
+struct Emitter {
+  u8* code;
+  size_t size;
+  size_t capacity;
+  bool overflow;
+
+  // The page of the block being translated.
+  const u8* page;
+
+  // Translating for a 65C02 variant.
+  bool cmos;
+
+  // Jumps to the side exit of an instruction, patched once the exits are
+  // emitted.
+  size_t exit_patches[kMaxExits];
+  u8 exit_instructions[kMaxExits];
+  size_t num_exits;
+};
+
+struct Jit* jit_new(void) {
+  struct Jit* jit = calloc(1, sizeof(struct Jit));
+  if (!jit) {
+    return NULL;
+  }
+
+  // Never writable and executable at once, jit_translate() makes the buffer
+  // writable only while it emits.
+  jit->buffer = mmap(NULL, kJitBufferSize, PROT_READ | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (jit->buffer == MAP_FAILED) {
+    free(jit);
+    return NULL;
+  }
+
+  return jit;
+}
+
+void jit_free(struct Jit* jit) {
+  if (jit) {
+    munmap(jit->buffer, kJitBufferSize);
+    free(jit);
+  }
+}
+
+void jit_reset(struct Jit* jit) {
+  jit->used = 0;
+  jit->full = false;
+}
+
+bool jit_full(const struct Jit* jit) { return jit->full; }
+
+static void emit8(struct Emitter* e, u8 byte) {
+  if (e->size < e->capacity) {
+    e->code[e->size++] = byte;
+  } else {
+    e->overflow = true;
+  }
+}
+
+static void emit32(struct Emitter* e, u32 value) {
+  for (int i = 0; i < 4; ++i) {
+    emit8(e, value >> (i * 8));
+  }
+}
+
+static void patch32(struct Emitter* e, size_t at, u32 value) {
+  if (at + 4 <= e->size) {
+    for (int i = 0; i < 4; ++i) {
+      e->code[at + i] = value >> (i * 8);
+    }
+  }
+}
+
+// Byte operations always get a prefix so that 4-7 mean SPL-DIL, not AH-BH.
+static void emit_rex(struct Emitter* e, bool wide, int reg, int index,
+                     int base, bool byte) {
+  u8 rex = 0x40 | (wide << 3) | ((reg >> 3) & 1) << 2 |
+           ((index >> 3) & 1) << 1 | ((base >> 3) & 1);
+  if (rex != 0x40 || byte) {
+    emit8(e, rex);
+  }
+}
+
+// ModRM and SIB for [base + index * scale + disp32].
+static void emit_mem(struct Emitter* e, int reg, int base, int index,
+                     int scale, int32_t disp) {
+  if (index == kNoIndex && (base & 7) != kRsp) {
+    emit8(e, 0x80 | (reg & 7) << 3 | (base & 7));
+  } else {
+    u8 ss = scale == 8 ? 3 : 0;
+    emit8(e, 0x84 | (reg & 7) << 3);
+    emit8(e, ss << 6 | ((index == kNoIndex ? kRsp : index) & 7) << 3 |
+                 (base & 7));
+  }
+
+  emit32(e, disp);
+}
+
+static void emit_modrm_reg(struct Emitter* e, int reg, int rm) {
+  emit8(e, 0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// op r/m, reg with both operands registers.
+static void emit_rr(struct Emitter* e, u8 opcode, bool wide, int rm,
+                    int reg) {
+  emit_rex(e, wide, reg, 0, rm, false);
+  emit8(e, opcode);
+  emit_modrm_reg(e, reg, rm);
+}
+
+static void emit_mov_rr(struct Emitter* e, int dst, int src) {
+  emit_rr(e, 0x89, false, dst, src);
+}
+
+static void emit_alu_rr(struct Emitter* e, enum AluOp op, int dst, int src) {
+  emit_rr(e, (op << 3) | 0x01, false, dst, src);
+}
+
+static void emit_alu_ri(struct Emitter* e, enum AluOp op, bool wide, int dst,
+                        u32 imm) {
+  emit_rex(e, wide, 0, 0, dst, false);
+  emit8(e, 0x81);
+  emit_modrm_reg(e, op, dst);
+  emit32(e, imm);
+}
+
+static void emit_mov_ri(struct Emitter* e, int dst, u32 imm) {
+  emit_rex(e, false, 0, 0, dst, false);
+  emit8(e, 0xb8 | (dst & 7));
+  emit32(e, imm);
+}
+
+// mov dst, imm64
+static void emit_mov_ri64(struct Emitter* e, int dst, u64 imm) {
+  emit_rex(e, true, 0, 0, dst, false);
+  emit8(e, 0xb8 | (dst & 7));
+  emit32(e, imm);
+  emit32(e, imm >> 32);
+}
+
+static void emit_shift_ri(struct Emitter* e, bool left, int dst, u8 imm) {
+  emit_rex(e, false, 0, 0, dst, false);
+  emit8(e, 0xc1);
+  emit_modrm_reg(e, left ? 4 : 5, dst);
+  emit8(e, imm);
+}
+
+static void emit_not(struct Emitter* e, int dst) {
+  emit_rex(e, false, 0, 0, dst, false);
+  emit8(e, 0xf7);
+  emit_modrm_reg(e, 2, dst);
+}
+
+static void emit_test_ri(struct Emitter* e, int dst, u32 imm) {
+  emit_rex(e, false, 0, 0, dst, false);
+  emit8(e, 0xf7);
+  emit_modrm_reg(e, 0, dst);
+  emit32(e, imm);
+}
+
+static void emit_test64_rr(struct Emitter* e, int dst, int src) {
+  emit_rr(e, 0x85, true, dst, src);
+}
+
+// movzx dst, src8
+static void emit_movzx_rr(struct Emitter* e, int dst, int src) {
+  emit_rex(e, false, dst, 0, src, true);
+  emit8(e, 0x0f);
+  emit8(e, 0xb6);
+  emit_modrm_reg(e, dst, src);
+}
+
+// setae dst8
+static void emit_setae(struct Emitter* e, int dst) {
+  emit_rex(e, false, 0, 0, dst, true);
+  emit8(e, 0x0f);
+  emit8(e, 0x93);
+  emit_modrm_reg(e, 0, dst);
+}
+
+// movzx dst, byte [base + index + disp]
+static void emit_load8(struct Emitter* e, int dst, int base, int index,
+                       int32_t disp) {
+  emit_rex(e, false, dst, index == kNoIndex ? 0 : index, base, false);
+  emit8(e, 0x0f);
+  emit8(e, 0xb6);
+  emit_mem(e, dst, base, index, 1, disp);
+}
+
+// mov byte [base + index + disp], src8
+static void emit_store8(struct Emitter* e, int src, int base, int index,
+                        int32_t disp) {
+  emit_rex(e, false, src, index == kNoIndex ? 0 : index, base, true);
+  emit8(e, 0x88);
+  emit_mem(e, src, base, index, 1, disp);
+}
+
+// mov dst, qword [base + index * 8 + disp]
+static void emit_load64(struct Emitter* e, int dst, int base, int index,
+                        int32_t disp) {
+  emit_rex(e, true, dst, index == kNoIndex ? 0 : index, base, false);
+  emit8(e, 0x8b);
+  emit_mem(e, dst, base, index, 8, disp);
+}
+
+// cmp reg, qword [base + index * 8]
+static void emit_cmp64_mem(struct Emitter* e, int reg, int base, int index) {
+  emit_rex(e, true, reg, index, base, false);
+  emit8(e, 0x3b);
+  emit_mem(e, reg, base, index, 8, 0);
+}
+
+// op byte [base + index + disp], imm8
+static void emit_alu8_mi(struct Emitter* e, enum AluOp op, int base,
+                         int index, int32_t disp, u8 imm) {
+  emit_rex(e, false, 0, index == kNoIndex ? 0 : index, base, false);
+  emit8(e, 0x80);
+  emit_mem(e, op, base, index, 1, disp);
+  emit8(e, imm);
+}
+
+// test byte [base + index + disp], imm8
+static void emit_test8_mi(struct Emitter* e, int base, int index,
+                          int32_t disp, u8 imm) {
+  emit_rex(e, false, 0, index == kNoIndex ? 0 : index, base, false);
+  emit8(e, 0xf6);
+  emit_mem(e, 0, base, index, 1, disp);
+  emit8(e, imm);
+}
+
+// mov byte [base + index + disp], imm8
+static void emit_store8_mi(struct Emitter* e, int base, int index,
+                           int32_t disp, u8 imm) {
+  emit_rex(e, false, 0, index == kNoIndex ? 0 : index, base, false);
+  emit8(e, 0xc6);
+  emit_mem(e, 0, base, index, 1, disp);
+  emit8(e, imm);
+}
+
+// add qword [cpu + disp], imm32
+static void emit_add_cpu64(struct Emitter* e, int32_t disp, u32 imm) {
+  emit_rex(e, true, 0, 0, kRegCpu, false);
+  emit8(e, 0x81);
+  emit_mem(e, 0, kRegCpu, kNoIndex, 1, disp);
+  emit32(e, imm);
+}
+
+// mov word [cpu + disp], imm16
+static void emit_store_cpu16_imm(struct Emitter* e, int32_t disp, u16 imm) {
+  emit8(e, 0x66);
+  emit_rex(e, false, 0, 0, kRegCpu, false);
+  emit8(e, 0xc7);
+  emit_mem(e, 0, kRegCpu, kNoIndex, 1, disp);
+  emit8(e, imm);
+  emit8(e, imm >> 8);
+}
+
+// mov word [cpu + disp], src16
+static void emit_store_cpu16(struct Emitter* e, int32_t disp, int src) {
+  emit8(e, 0x66);
+  emit_rex(e, false, src, 0, kRegCpu, false);
+  emit8(e, 0x89);
+  emit_mem(e, src, kRegCpu, kNoIndex, 1, disp);
+}
+
+static void emit_push(struct Emitter* e, int reg) {
+  emit_rex(e, false, 0, 0, reg, false);
+  emit8(e, 0x50 | (reg & 7));
+}
+
+static void emit_pop(struct Emitter* e, int reg) {
+  emit_rex(e, false, 0, 0, reg, false);
+  emit8(e, 0x58 | (reg & 7));
+}
+
+// Emits a jcc rel32 and returns the position of the displacement.
+static size_t emit_jcc(struct Emitter* e, enum Cond cond) {
+  emit8(e, 0x0f);
+  emit8(e, 0x80 | cond);
+  emit32(e, 0);
+  return e->size - 4;
+}
+
+static size_t emit_jmp(struct Emitter* e) {
+  emit8(e, 0xe9);
+  emit32(e, 0);
+  return e->size - 4;
+}
+
+static void bind(struct Emitter* e, size_t patch) {
+  patch32(e, patch, e->size - (patch + 4));
+}
+
+static void emit_exit_jcc(struct Emitter* e, enum Cond cond, u8 instruction) {
+  size_t patch = emit_jcc(e, cond);
+  if (e->num_exits < kMaxExits) {
+    e->exit_patches[e->num_exits] = patch;
+    e->exit_instructions[e->num_exits] = instruction;
+    ++e->num_exits;
+  } else {
+    e->overflow = true;
+  }
+}
+
+static const u8 kSavedRegs[] = {kRbx, kRbp, kR12, kR13, kR14, kR15};
+
+static const struct {
+  int reg;
+  size_t offset;
+} kCpuRegs[] = {
+    {kRegA, offsetof(struct Cpu, a)},
+    {kRegX, offsetof(struct Cpu, x)},
+    {kRegY, offsetof(struct Cpu, y)},
+    {kRegS, offsetof(struct Cpu, s)},
+    {kRegN, offsetof(struct Cpu, flag_n)},
+    {kRegZ, offsetof(struct Cpu, flag_z)},
+    {kRegC, offsetof(struct Cpu, flag_c)},
+    {kRegV, offsetof(struct Cpu, flag_v)},
+};
+
+#define kNumCpuRegs (sizeof(kCpuRegs) / sizeof(kCpuRegs[0]))
+
+static void emit_prologue(struct Emitter* e) {
+  for (size_t i = 0; i < sizeof(kSavedRegs); ++i) {
+    emit_push(e, kSavedRegs[i]);
+  }
+
+  emit_load64(e, kRegReadPages, kRegCpu, kNoIndex, offsetof(struct Cpu, bus));
+  emit_rr(e, 0x89, true, kRegWritePages, kRegReadPages);
+  emit_alu_ri(e, kAluAdd, true, kRegReadPages,
+              offsetof(struct Bus, read_pages));
+  emit_alu_ri(e, kAluAdd, true, kRegWritePages,
+              offsetof(struct Bus, write_pages));
+  emit_load64(e, kRegCode, kRegCpu, kNoIndex, offsetof(struct Cpu, blocks));
+
+  for (size_t i = 0; i < kNumCpuRegs; ++i) {
+    emit_load8(e, kCpuRegs[i].reg, kRegCpu, kNoIndex, kCpuRegs[i].offset);
+  }
+}
+
+// Expects the number of executed instructions in eax.
+static void emit_epilogue(struct Emitter* e) {
+  for (size_t i = 0; i < kNumCpuRegs; ++i) {
+    emit_store8(e, kCpuRegs[i].reg, kRegCpu, kNoIndex, kCpuRegs[i].offset);
+  }
+
+  for (size_t i = sizeof(kSavedRegs); i > 0; --i) {
+    emit_pop(e, kSavedRegs[i - 1]);
+  }
+
+  emit8(e, 0xc3);
+}
+
+static void emit_set_nz(struct Emitter* e, int reg) {
+  emit_mov_rr(e, kRegN, reg);
+  emit_mov_rr(e, kRegZ, reg);
+}
+
+// Leaves the page pointer for reading the address in eax in r15.
+static void emit_read_page(struct Emitter* e, u8 instruction) {
+  emit_mov_rr(e, kRegPage, kRegAddr);
+  emit_shift_ri(e, false, kRegPage, 8);
+  emit_load64(e, kRegPage, kRegReadPages, kRegPage, 0);
+  emit_test64_rr(e, kRegPage, kRegPage);
+  emit_exit_jcc(e, kCondZ, instruction);
+}
+
+// Bus.dirty relative to the write page table.
+#define kDirtyDisp \
+  (offsetof(struct Bus, dirty) - offsetof(struct Bus, write_pages))
+
+// Leaves the page pointer for writing the address in eax in r15, exits on
+// pages with blocks and, for read-modify-write, on pages mapped differently
+// for reading. Flags the page dirty. Clobbers r14.
+static void emit_write_page(struct Emitter* e, u8 instruction, bool rmw) {
+  emit_mov_rr(e, kRegValue, kRegAddr);
+  emit_shift_ri(e, false, kRegValue, 8);
+  emit_alu8_mi(e, kAluCmp, kRegCode, kRegValue,
+               offsetof(struct BlockCache, code), 0);
+  emit_exit_jcc(e, kCondNz, instruction);
+  emit_load64(e, kRegPage, kRegWritePages, kRegValue, 0);
+  emit_test64_rr(e, kRegPage, kRegPage);
+  emit_exit_jcc(e, kCondZ, instruction);
+  if (rmw) {
+    emit_cmp64_mem(e, kRegPage, kRegReadPages, kRegValue);
+    emit_exit_jcc(e, kCondNz, instruction);
+  }
+
+  emit_store8_mi(e, kRegWritePages, kRegValue, kDirtyDisp, 1);
+}
+
+// Stack page variants of the above.
+static void emit_stack_read_page(struct Emitter* e, u8 instruction) {
+  emit_load64(e, kRegPage, kRegReadPages, kNoIndex, 8);
+  emit_test64_rr(e, kRegPage, kRegPage);
+  emit_exit_jcc(e, kCondZ, instruction);
+}
+
+static void emit_stack_write_page(struct Emitter* e, u8 instruction) {
+  emit_alu8_mi(e, kAluCmp, kRegCode, kNoIndex,
+               offsetof(struct BlockCache, code) + 1, 0);
+  emit_exit_jcc(e, kCondNz, instruction);
+  emit_load64(e, kRegPage, kRegWritePages, kNoIndex, 8);
+  emit_test64_rr(e, kRegPage, kRegPage);
+  emit_exit_jcc(e, kCondZ, instruction);
+  emit_store8_mi(e, kRegWritePages, kNoIndex, kDirtyDisp + 1, 1);
+}
+
+static void emit_push_reg(struct Emitter* e, int reg) {
+  emit_store8(e, reg, kRegPage, kRegS, 0);
+  emit_alu_ri(e, kAluSub, false, kRegS, 1);
+  emit_alu_ri(e, kAluAnd, false, kRegS, 0xff);
+}
+
+static void emit_pull(struct Emitter* e, int dst) {
+  emit_alu_ri(e, kAluAdd, false, kRegS, 1);
+  emit_alu_ri(e, kAluAnd, false, kRegS, 0xff);
+  emit_load8(e, dst, kRegPage, kRegS, 0);
+}
+
+// Computes the effective address into eax. For the modes with a page crossing
+// penalty the base address is left in r14. Indirect modes read their pointer
+// and may exit.
+static void emit_addr(struct Emitter* e, const struct BlockInstruction* instr,
+                      u8 instruction) {
+  u16 operand = instr->operand;
+  switch (instr->addr_mode) {
+    case kAddrModeZpx:
+    case kAddrModeZpy:
+      emit_mov_rr(e, kRegAddr,
+                  instr->addr_mode == kAddrModeZpx ? kRegX : kRegY);
+      emit_alu_ri(e, kAluAdd, false, kRegAddr, operand);
+      emit_alu_ri(e, kAluAnd, false, kRegAddr, 0xff);
+      break;
+    case kAddrModeAbx:
+    case kAddrModeAby:
+      emit_mov_ri(e, kRegValue, operand);
+      emit_mov_rr(e, kRegAddr,
+                  instr->addr_mode == kAddrModeAbx ? kRegX : kRegY);
+      emit_alu_rr(e, kAluAdd, kRegAddr, kRegValue);
+      emit_alu_ri(e, kAluAnd, false, kRegAddr, 0xffff);
+      break;
+    case kAddrModeIzx:
+      emit_load64(e, kRegPage, kRegReadPages, kNoIndex, 0);
+      emit_test64_rr(e, kRegPage, kRegPage);
+      emit_exit_jcc(e, kCondZ, instruction);
+      emit_mov_rr(e, kRegValue, kRegX);
+      emit_alu_ri(e, kAluAdd, false, kRegValue, operand);
+      emit_alu_ri(e, kAluAnd, false, kRegValue, 0xff);
+      emit_load8(e, kRegAddr, kRegPage, kRegValue, 0);
+      emit_alu_ri(e, kAluAdd, false, kRegValue, 1);
+      emit_alu_ri(e, kAluAnd, false, kRegValue, 0xff);
+      emit_load8(e, kRegValue, kRegPage, kRegValue, 0);
+      emit_shift_ri(e, true, kRegValue, 8);
+      emit_alu_rr(e, kAluOr, kRegAddr, kRegValue);
+      break;
+    case kAddrModeIzp:
+      emit_load64(e, kRegPage, kRegReadPages, kNoIndex, 0);
+      emit_test64_rr(e, kRegPage, kRegPage);
+      emit_exit_jcc(e, kCondZ, instruction);
+      emit_load8(e, kRegAddr, kRegPage, kNoIndex, operand & 0xff);
+      emit_load8(e, kRegValue, kRegPage, kNoIndex, (operand + 1) & 0xff);
+      emit_shift_ri(e, true, kRegValue, 8);
+      emit_alu_rr(e, kAluOr, kRegAddr, kRegValue);
+      break;
+    case kAddrModeIzy:
+      emit_load64(e, kRegPage, kRegReadPages, kNoIndex, 0);
+      emit_test64_rr(e, kRegPage, kRegPage);
+      emit_exit_jcc(e, kCondZ, instruction);
+      emit_load8(e, kRegAddr, kRegPage, kNoIndex, operand & 0xff);
+      emit_load8(e, kRegValue, kRegPage, kNoIndex, (operand + 1) & 0xff);
+      emit_shift_ri(e, true, kRegValue, 8);
+      emit_alu_rr(e, kAluOr, kRegValue, kRegAddr);
+      emit_mov_rr(e, kRegAddr, kRegValue);
+      emit_alu_rr(e, kAluAdd, kRegAddr, kRegY);
+      emit_alu_ri(e, kAluAnd, false, kRegAddr, 0xffff);
+      break;
+    default:
+      emit_mov_ri(e, kRegAddr, operand);
+      break;
+  }
+}
+
+// Adds the page crossing cycle, expects the base address in r14 and the
+// effective address in eax. Clobbers r14.
+static void emit_page_cycle(struct Emitter* e) {
+  emit_alu_rr(e, kAluXor, kRegValue, kRegAddr);
+  emit_test_ri(e, kRegValue, 0xff00);
+  size_t skip = emit_jcc(e, kCondZ);
+  emit_add_cpu64(e, offsetof(struct Cpu, cycles), 1);
+  bind(e, skip);
+}
+
+static bool has_page_cycle(const struct BlockInstruction* instr) {
+  return instr->page_cycle && (instr->addr_mode == kAddrModeAbx ||
+                               instr->addr_mode == kAddrModeAby ||
+                               instr->addr_mode == kAddrModeIzy);
+}
+
+// Loads the operand of a read instruction into r14.
+static void emit_read_operand(struct Emitter* e,
+                              const struct BlockInstruction* instr,
+                              u8 instruction) {
+  switch (instr->addr_mode) {
+    case kAddrModeImplied:
+      emit_mov_rr(e, kRegValue, kRegA);
+      return;
+    case kAddrModeImm:
+      // Blocks are invalidated when their code changes, the immediate byte
+      // can be baked in.
+      emit_mov_ri(e, kRegValue, e->page[instr->operand & 0x00ff]);
+      return;
+    default:
+      break;
+  }
+
+  emit_addr(e, instr, instruction);
+  emit_read_page(e, instruction);
+  if (has_page_cycle(instr)) {
+    emit_page_cycle(e);
+  }
+
+  emit_movzx_rr(e, kRegAddr, kRegAddr);
+  emit_load8(e, kRegValue, kRegPage, kRegAddr, 0);
+}
+
+static void emit_store(struct Emitter* e, const struct BlockInstruction* instr,
+                       u8 instruction, int src) {
+  emit_addr(e, instr, instruction);
+  emit_write_page(e, instruction, false);
+  emit_movzx_rr(e, kRegAddr, kRegAddr);
+  emit_store8(e, src, kRegPage, kRegAddr, 0);
+}
+
+enum Shift {
+  kShiftAsl,
+  kShiftLsr,
+  kShiftRol,
+  kShiftRor,
+};
+
+// Shifts the byte in reg and sets the flags like op.c.
+static void emit_shift(struct Emitter* e, enum Shift shift, int reg) {
+  switch (shift) {
+    case kShiftAsl:
+      emit_mov_rr(e, kRegC, reg);
+      emit_shift_ri(e, false, kRegC, 7);
+      emit_shift_ri(e, true, reg, 1);
+      emit_alu_ri(e, kAluAnd, false, reg, 0xff);
+      break;
+    case kShiftLsr:
+      emit_mov_rr(e, kRegC, reg);
+      emit_alu_ri(e, kAluAnd, false, kRegC, 1);
+      emit_shift_ri(e, false, reg, 1);
+      break;
+    case kShiftRol:
+      emit_shift_ri(e, true, reg, 1);
+      emit_alu_rr(e, kAluOr, reg, kRegC);
+      emit_mov_rr(e, kRegC, reg);
+      emit_shift_ri(e, false, kRegC, 8);
+      emit_alu_ri(e, kAluAnd, false, reg, 0xff);
+      break;
+    case kShiftRor:
+      emit_shift_ri(e, true, kRegC, 8);
+      emit_alu_rr(e, kAluOr, reg, kRegC);
+      emit_mov_rr(e, kRegC, reg);
+      emit_alu_ri(e, kAluAnd, false, kRegC, 1);
+      emit_shift_ri(e, false, reg, 1);
+      break;
+  }
+
+  emit_set_nz(e, reg);
+}
+
+static void emit_step(struct Emitter* e, int reg, int delta) {
+  emit_alu_ri(e, kAluAdd, false, reg, delta);
+  emit_alu_ri(e, kAluAnd, false, reg, 0xff);
+  emit_set_nz(e, reg);
+}
+
+static void emit_rmw(struct Emitter* e, const struct BlockInstruction* instr,
+                     u8 instruction, enum Shift shift, int delta) {
+  if (instr->addr_mode == kAddrModeImplied) {
+    if (delta) {
+      emit_step(e, kRegA, delta);
+    } else {
+      emit_shift(e, shift, kRegA);
+    }
+
+    return;
+  }
+
+  emit_addr(e, instr, instruction);
+  emit_write_page(e, instruction, true);
+  if (has_page_cycle(instr)) {
+    // The 65C02 shifts, emit_write_page() clobbered the base.
+    emit_mov_ri(e, kRegValue, instr->operand);
+    emit_page_cycle(e);
+  }
+
+  emit_movzx_rr(e, kRegAddr, kRegAddr);
+  emit_load8(e, kRegValue, kRegPage, kRegAddr, 0);
+  if (delta) {
+    emit_alu_ri(e, kAluAdd, false, kRegValue, delta);
+    emit_alu_ri(e, kAluAnd, false, kRegValue, 0xff);
+    emit_set_nz(e, kRegValue);
+  } else {
+    emit_shift(e, shift, kRegValue);
+  }
+
+  emit_store8(e, kRegValue, kRegPage, kRegAddr, 0);
+}
+
+static void emit_adc(struct Emitter* e, bool decimal) {
+  if (decimal) {
+    // See decimal_adc() in cpu.h, z is the binary sum.
+    emit_mov_rr(e, kRegZ, kRegA);
+    emit_alu_rr(e, kAluAdd, kRegZ, kRegValue);
+    emit_alu_rr(e, kAluAdd, kRegZ, kRegC);
+    emit_alu_ri(e, kAluAnd, false, kRegZ, 0xff);
+    emit_mov_rr(e, kRegAddr, kRegA);
+    emit_alu_ri(e, kAluAnd, false, kRegAddr, 0x0f);
+    emit_mov_rr(e, kRegPage, kRegValue);
+    emit_alu_ri(e, kAluAnd, false, kRegPage, 0x0f);
+    emit_alu_rr(e, kAluAdd, kRegAddr, kRegPage);
+    emit_alu_rr(e, kAluAdd, kRegAddr, kRegC);
+    emit_mov_ri64(e, kRegV, (uintptr_t)decimal_add);
+    emit_load8(e, kRegAddr, kRegV, kRegAddr, 0);
+    emit_mov_rr(e, kRegPage, kRegA);
+    emit_shift_ri(e, false, kRegPage, 4);
+    emit_mov_rr(e, kRegN, kRegValue);
+    emit_shift_ri(e, false, kRegN, 4);
+    emit_alu_rr(e, kAluAdd, kRegPage, kRegN);
+    emit_mov_rr(e, kRegC, kRegAddr);
+    emit_shift_ri(e, false, kRegC, 4);
+    emit_alu_rr(e, kAluAdd, kRegPage, kRegC);
+    emit_mov_rr(e, kRegN, kRegPage);
+    emit_shift_ri(e, true, kRegN, 4);
+    emit_alu_ri(e, kAluAnd, false, kRegN, 0xff);
+    emit_load8(e, kRegPage, kRegV, kRegPage, 0);
+    emit_mov_rr(e, kRegV, kRegA);
+    emit_alu_rr(e, kAluXor, kRegV, kRegValue);
+    emit_not(e, kRegV);
+    emit_mov_rr(e, kRegC, kRegA);
+    emit_alu_rr(e, kAluXor, kRegC, kRegN);
+    emit_alu_rr(e, kAluAnd, kRegV, kRegC);
+    emit_alu_ri(e, kAluAnd, false, kRegV, 0xff);
+    emit_mov_rr(e, kRegC, kRegPage);
+    emit_shift_ri(e, false, kRegC, 4);
+    emit_shift_ri(e, true, kRegPage, 4);
+    emit_alu_ri(e, kAluAnd, false, kRegPage, 0xf0);
+    emit_alu_ri(e, kAluAnd, false, kRegAddr, 0x0f);
+    emit_alu_rr(e, kAluOr, kRegAddr, kRegPage);
+    emit_mov_rr(e, kRegA, kRegAddr);
+    return;
+  }
+
+  // d = a + b + c, v = ~(a ^ b) & (a ^ d)
+  emit_mov_rr(e, kRegAddr, kRegA);
+  emit_alu_rr(e, kAluAdd, kRegAddr, kRegValue);
+  emit_alu_rr(e, kAluAdd, kRegAddr, kRegC);
+  emit_mov_rr(e, kRegV, kRegA);
+  emit_alu_rr(e, kAluXor, kRegV, kRegValue);
+  emit_not(e, kRegV);
+  emit_mov_rr(e, kRegPage, kRegA);
+  emit_alu_rr(e, kAluXor, kRegPage, kRegAddr);
+  emit_alu_rr(e, kAluAnd, kRegV, kRegPage);
+  emit_alu_ri(e, kAluAnd, false, kRegV, 0xff);
+  emit_mov_rr(e, kRegC, kRegAddr);
+  emit_shift_ri(e, false, kRegC, 8);
+  emit_alu_ri(e, kAluAnd, false, kRegAddr, 0xff);
+  emit_mov_rr(e, kRegA, kRegAddr);
+  emit_set_nz(e, kRegA);
+}
+
+static void emit_sbc(struct Emitter* e, bool decimal) {
+  if (decimal) {
+    // See decimal_sbc() in cpu.h, the result is kept in rbx until the flags
+    // are done.
+    emit_mov_rr(e, kRegAddr, kRegA);
+    emit_alu_ri(e, kAluAnd, false, kRegAddr, 0x0f);
+    emit_mov_rr(e, kRegPage, kRegValue);
+    emit_alu_ri(e, kAluAnd, false, kRegPage, 0x0f);
+    emit_alu_rr(e, kAluSub, kRegAddr, kRegPage);
+    emit_alu_rr(e, kAluAdd, kRegAddr, kRegC);
+    emit_alu_ri(e, kAluSub, false, kRegAddr, 1);
+    emit_alu_ri(e, kAluAnd, false, kRegAddr, 0x1f);
+    emit_mov_ri64(e, kRegV, (uintptr_t)decimal_sub);
+    emit_load8(e, kRegAddr, kRegV, kRegAddr, 0);
+    emit_mov_rr(e, kRegPage, kRegA);
+    emit_shift_ri(e, false, kRegPage, 4);
+    emit_mov_rr(e, kRegN, kRegValue);
+    emit_shift_ri(e, false, kRegN, 4);
+    emit_alu_rr(e, kAluSub, kRegPage, kRegN);
+    emit_mov_rr(e, kRegN, kRegAddr);
+    emit_shift_ri(e, false, kRegN, 4);
+    emit_alu_rr(e, kAluSub, kRegPage, kRegN);
+    emit_alu_ri(e, kAluAnd, false, kRegPage, 0x1f);
+    emit_load8(e, kRegN, kRegV, kRegPage, 0);
+    emit_shift_ri(e, true, kRegN, 4);
+    emit_alu_ri(e, kAluAnd, false, kRegN, 0xf0);
+    emit_alu_ri(e, kAluAnd, false, kRegAddr, 0x0f);
+    emit_alu_rr(e, kAluOr, kRegN, kRegAddr);
+  }
+
+  // c = b ^ 0xff, e = a + c + carry, v = (e ^ a) & (e ^ c)
+  emit_alu_ri(e, kAluXor, false, kRegValue, 0xff);
+  emit_mov_rr(e, kRegAddr, kRegA);
+  emit_alu_rr(e, kAluAdd, kRegAddr, kRegValue);
+  emit_alu_rr(e, kAluAdd, kRegAddr, kRegC);
+  emit_mov_rr(e, kRegV, kRegAddr);
+  emit_alu_rr(e, kAluXor, kRegV, kRegA);
+  emit_mov_rr(e, kRegPage, kRegAddr);
+  emit_alu_rr(e, kAluXor, kRegPage, kRegValue);
+  emit_alu_rr(e, kAluAnd, kRegV, kRegPage);
+  emit_alu_ri(e, kAluAnd, false, kRegV, 0xff);
+  emit_mov_rr(e, kRegC, kRegAddr);
+  emit_shift_ri(e, false, kRegC, 8);
+  emit_alu_ri(e, kAluAnd, false, kRegAddr, 0xff);
+  emit_mov_rr(e, kRegA, decimal ? kRegN : kRegAddr);
+  emit_set_nz(e, kRegAddr);
+}
+
+// Emits both the binary and the decimal form, D picks one at run time.
+static void emit_arith(struct Emitter* e,
+                       void (*emit)(struct Emitter* e, bool decimal)) {
+  emit_test8_mi(e, kRegCpu, kNoIndex, offsetof(struct Cpu, p), kFlagDecimal);
+  size_t decimal = emit_jcc(e, kCondNz);
+  emit(e, false);
+  size_t done = emit_jmp(e);
+  bind(e, decimal);
+  emit(e, true);
+  bind(e, done);
+}
+
+static void emit_compare(struct Emitter* e, int reg) {
+  emit_alu_rr(e, kAluXor, kRegC, kRegC);
+  emit_alu_rr(e, kAluCmp, reg, kRegValue);
+  emit_setae(e, kRegC);
+  emit_mov_rr(e, kRegN, reg);
+  emit_alu_rr(e, kAluSub, kRegN, kRegValue);
+  emit_alu_ri(e, kAluAnd, false, kRegN, 0xff);
+  emit_mov_rr(e, kRegZ, kRegN);
+}
+
+static void emit_transfer(struct Emitter* e, int dst, int src, bool flags) {
+  emit_mov_rr(e, dst, src);
+  if (flags) {
+    emit_set_nz(e, dst);
+  }
+}
+
+static void emit_set_p(struct Emitter* e, enum Flag flag, bool value) {
+  emit_alu8_mi(e, value ? kAluOr : kAluAnd, kRegCpu, kNoIndex,
+               offsetof(struct Cpu, p), value ? flag : (u8)~flag);
+}
+
+// Leaves the block, pc and cycles are static.
+static void emit_leave(struct Emitter* e, u16 pc, u32 cycles, u8 count,
+                       size_t* epilogue_patch) {
+  emit_store_cpu16_imm(e, offsetof(struct Cpu, pc), pc);
+  if (cycles) {
+    emit_add_cpu64(e, offsetof(struct Cpu, cycles), cycles);
+  }
+
+  emit_mov_ri(e, kRax, count);
+  if (epilogue_patch) {
+    *epilogue_patch = emit_jmp(e);
+  }
+}
+
+// Translates the instruction unless it needs the interpreter. Control flow
+// instructions end the block and emit their own exit.
+static bool emit_instruction(struct Emitter* e,
+                             const struct BlockInstruction* instr, u8 index,
+                             u16 pc, u32 cycles, size_t* epilogue_patch) {
+  void (*op)(struct Cpu*, u16, bool) = instr->op_impl;
+  u16 next = pc + instr->length;
+  u32 done = cycles + instr->cycles;
+  bool implied = instr->addr_mode == kAddrModeImplied;
+
+  // None of these have an implied form, leave any such entry to op.c.
+  if (implied && (op == op_lda || op == op_ldx || op == op_ldy ||
+                  op == op_sta || op == op_stx || op == op_sty)) {
+    return false;
+  }
+
+  // The decimal mode of the 65C02 is left to the interpreter, D is tested
+  // before the operand read can add a page crossing cycle.
+  if (e->cmos && (op == op_adc || op == op_sbc)) {
+    emit_test8_mi(e, kRegCpu, kNoIndex, offsetof(struct Cpu, p),
+                  kFlagDecimal);
+    emit_exit_jcc(e, kCondNz, index);
+    emit_read_operand(e, instr, index);
+    if (op == op_adc) {
+      emit_adc(e, false);
+    } else {
+      emit_sbc(e, false);
+    }
+
+    return true;
+  }
+
+  if (op == op_lda || op == op_ldx || op == op_ldy) {
+    int reg = op == op_lda ? kRegA : op == op_ldx ? kRegX : kRegY;
+    emit_read_operand(e, instr, index);
+    emit_mov_rr(e, reg, kRegValue);
+    emit_set_nz(e, reg);
+  } else if (op == op_sta || op == op_stx || op == op_sty) {
+    emit_store(e, instr, index,
+               op == op_sta ? kRegA : op == op_stx ? kRegX : kRegY);
+  } else if (op == op_adc) {
+    emit_read_operand(e, instr, index);
+    emit_arith(e, emit_adc);
+  } else if (op == op_sbc) {
+    emit_read_operand(e, instr, index);
+    emit_arith(e, emit_sbc);
+  } else if (op == op_and || op == op_ora || op == op_eor) {
+    emit_read_operand(e, instr, index);
+    emit_alu_rr(e, op == op_and ? kAluAnd : op == op_ora ? kAluOr : kAluXor,
+                kRegA, kRegValue);
+    emit_set_nz(e, kRegA);
+  } else if (op == op_bit) {
+    emit_read_operand(e, instr, index);
+    emit_mov_rr(e, kRegN, kRegValue);
+    emit_mov_rr(e, kRegV, kRegValue);
+    emit_shift_ri(e, true, kRegV, 1);
+    emit_alu_ri(e, kAluAnd, false, kRegV, 0xff);
+    emit_alu_rr(e, kAluAnd, kRegValue, kRegA);
+    emit_mov_rr(e, kRegZ, kRegValue);
+  } else if (op == op_bit_imm) {
+    emit_read_operand(e, instr, index);
+    emit_alu_rr(e, kAluAnd, kRegValue, kRegA);
+    emit_mov_rr(e, kRegZ, kRegValue);
+  } else if (op == op_stz) {
+    emit_addr(e, instr, index);
+    emit_write_page(e, index, false);
+    emit_movzx_rr(e, kRegAddr, kRegAddr);
+    emit_mov_ri(e, kRegValue, 0);
+    emit_store8(e, kRegValue, kRegPage, kRegAddr, 0);
+  } else if (op == op_tsb || op == op_trb) {
+    // Z from A & M, TRB clears the bits of A with an or and an xor.
+    emit_addr(e, instr, index);
+    emit_write_page(e, index, true);
+    emit_movzx_rr(e, kRegAddr, kRegAddr);
+    emit_load8(e, kRegValue, kRegPage, kRegAddr, 0);
+    emit_mov_rr(e, kRegZ, kRegValue);
+    emit_alu_rr(e, kAluAnd, kRegZ, kRegA);
+    emit_alu_rr(e, kAluOr, kRegValue, kRegA);
+    if (op == op_trb) {
+      emit_alu_rr(e, kAluXor, kRegValue, kRegA);
+    }
+
+    emit_store8(e, kRegValue, kRegPage, kRegAddr, 0);
+  } else if (op == op_cmp || op == op_cpx || op == op_cpy) {
+    emit_read_operand(e, instr, index);
+    emit_compare(e, op == op_cmp ? kRegA : op == op_cpx ? kRegX : kRegY);
+  } else if (op == op_asl) {
+    emit_rmw(e, instr, index, kShiftAsl, 0);
+  } else if (op == op_lsr) {
+    emit_rmw(e, instr, index, kShiftLsr, 0);
+  } else if (op == op_rol) {
+    emit_rmw(e, instr, index, kShiftRol, 0);
+  } else if (op == op_ror) {
+    emit_rmw(e, instr, index, kShiftRor, 0);
+  } else if (op == op_inc) {
+    emit_rmw(e, instr, index, kShiftAsl, 1);
+  } else if (op == op_dec) {
+    emit_rmw(e, instr, index, kShiftAsl, -1);
+  } else if (op == op_inx || op == op_iny) {
+    emit_step(e, op == op_inx ? kRegX : kRegY, 1);
+  } else if (op == op_dex || op == op_dey) {
+    emit_step(e, op == op_dex ? kRegX : kRegY, -1);
+  } else if (op == op_tax) {
+    emit_transfer(e, kRegX, kRegA, true);
+  } else if (op == op_tay) {
+    emit_transfer(e, kRegY, kRegA, true);
+  } else if (op == op_txa) {
+    emit_transfer(e, kRegA, kRegX, true);
+  } else if (op == op_tya) {
+    emit_transfer(e, kRegA, kRegY, true);
+  } else if (op == op_tsx) {
+    emit_transfer(e, kRegX, kRegS, true);
+  } else if (op == op_txs) {
+    emit_transfer(e, kRegS, kRegX, false);
+  } else if (op == op_clc || op == op_sec) {
+    emit_mov_ri(e, kRegC, op == op_sec);
+  } else if (op == op_clv) {
+    emit_mov_ri(e, kRegV, 0);
+  } else if (op == op_sei) {
+    // CLI is left to the interpreter, which takes a held IRQ right after it.
+    emit_set_p(e, kFlagInterrupt, true);
+  } else if (op == op_cld || op == op_sed) {
+    emit_set_p(e, kFlagDecimal, op == op_sed);
+  } else if (op == op_nop) {
+    if (!implied) {
+      emit_read_operand(e, instr, index);
+    }
+  } else if (op == op_pha || op == op_phx || op == op_phy) {
+    emit_stack_write_page(e, index);
+    emit_push_reg(e, op == op_pha ? kRegA : op == op_phx ? kRegX : kRegY);
+  } else if (op == op_pla || op == op_plx || op == op_ply) {
+    int reg = op == op_pla ? kRegA : op == op_plx ? kRegX : kRegY;
+    emit_stack_read_page(e, index);
+    emit_pull(e, reg);
+    emit_set_nz(e, reg);
+  } else if (op == op_jmp && instr->addr_mode == kAddrModeAbs) {
+    emit_leave(e, instr->operand, done, index + 1, epilogue_patch);
+  } else if (op == op_jmp && instr->addr_mode == kAddrModeInd &&
+             (!e->cmos || (instr->operand & 0x00ff) != 0x00ff)) {
+    // JMP ($xxFF) wraps within the page on the 6502, so both bytes are on one
+    // page. The 65C02 reads across it and is left to the interpreter.
+    u16 lo = instr->operand;
+    u16 hi = (lo & 0xff00) | ((lo + 1) & 0x00ff);
+    emit_mov_ri(e, kRegAddr, lo);
+    emit_read_page(e, index);
+    emit_load8(e, kRegAddr, kRegPage, kNoIndex, lo & 0xff);
+    emit_load8(e, kRegValue, kRegPage, kNoIndex, hi & 0xff);
+    emit_shift_ri(e, true, kRegValue, 8);
+    emit_alu_rr(e, kAluOr, kRegAddr, kRegValue);
+    emit_store_cpu16(e, offsetof(struct Cpu, pc), kRegAddr);
+    emit_add_cpu64(e, offsetof(struct Cpu, cycles), done);
+    emit_mov_ri(e, kRax, index + 1);
+    *epilogue_patch = emit_jmp(e);
+  } else if (op == op_jsr) {
+    u16 ret = next - 1;
+    emit_stack_write_page(e, index);
+    emit_mov_ri(e, kRegValue, ret >> 8);
+    emit_push_reg(e, kRegValue);
+    emit_mov_ri(e, kRegValue, ret & 0xff);
+    emit_push_reg(e, kRegValue);
+    emit_leave(e, instr->operand, done, index + 1, epilogue_patch);
+  } else if (op == op_rts) {
+    emit_stack_read_page(e, index);
+    emit_pull(e, kRegAddr);
+    emit_pull(e, kRegValue);
+    emit_shift_ri(e, true, kRegValue, 8);
+    emit_alu_rr(e, kAluOr, kRegAddr, kRegValue);
+    emit_alu_ri(e, kAluAdd, false, kRegAddr, 1);
+    emit_store_cpu16(e, offsetof(struct Cpu, pc), kRegAddr);
+    emit_add_cpu64(e, offsetof(struct Cpu, cycles), done);
+    emit_mov_ri(e, kRax, index + 1);
+    *epilogue_patch = emit_jmp(e);
+  } else if (op == op_bra) {
+    u16 target = next + instr->operand;
+    u32 penalty = ((target ^ next) & 0xff00) ? 2 : 1;
+    emit_leave(e, target, done + penalty, index + 1, epilogue_patch);
+  } else if (instr->addr_mode == kAddrModeRel) {
+    int reg;
+    u32 mask;
+    bool taken_if_set;
+    if (op == op_bpl || op == op_bmi) {
+      reg = kRegN;
+      mask = 0x80;
+      taken_if_set = op == op_bmi;
+    } else if (op == op_bvc || op == op_bvs) {
+      reg = kRegV;
+      mask = 0x80;
+      taken_if_set = op == op_bvs;
+    } else if (op == op_bcc || op == op_bcs) {
+      reg = kRegC;
+      mask = 0x01;
+      taken_if_set = op == op_bcs;
+    } else {
+      // Z is set when flag_z is zero.
+      reg = kRegZ;
+      mask = 0xff;
+      taken_if_set = op == op_bne;
+    }
+
+    u16 target = next + instr->operand;
+    u32 penalty = ((target ^ next) & 0xff00) ? 2 : 1;
+    emit_test_ri(e, reg, mask);
+    size_t not_taken = emit_jcc(e, taken_if_set ? kCondZ : kCondNz);
+    emit_leave(e, target, done + penalty, index + 1, epilogue_patch);
+    bind(e, not_taken);
+    emit_leave(e, next, done, index + 1, NULL);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+static bool ends_native_block(const struct BlockInstruction* instr) {
+  return instr->addr_mode == kAddrModeRel || instr->op_impl == op_jmp ||
+         instr->op_impl == op_jsr || instr->op_impl == op_rts;
+}
+
+static NativeCode emit_block(struct Jit* jit, const struct Block* block,
+                             enum CpuVariant variant) {
+  struct Emitter e = {
+      .code = jit->buffer + jit->used,
+      .capacity = kJitBufferSize - jit->used,
+      .page = block->page,
+      .cmos = variant != kCpuVariantNmos,
+  };
+
+  u16 pcs[kMaxBlockInstructions + 1];
+  u32 cycles[kMaxBlockInstructions + 1];
+  pcs[0] = block->pc;
+  cycles[0] = 0;
+
+  emit_prologue(&e);
+
+  // A branch ends with two exits of its own, falling through the not taken
+  // one into the epilogue. Everything else jumps to the epilogue.
+  size_t epilogue_patches[2];
+  size_t num_epilogue_patches = 0;
+  u8 count = 0;
+  while (count < block->count) {
+    const struct BlockInstruction* instr = block->instructions + count;
+    size_t patch = SIZE_MAX;
+    size_t start = e.size;
+    size_t num_exits = e.num_exits;
+    if (!emit_instruction(&e, instr, count, pcs[count], cycles[count],
+                          &patch)) {
+      e.size = start;
+      e.num_exits = num_exits;
+      break;
+    }
+
+    pcs[count + 1] = pcs[count] + instr->length;
+    cycles[count + 1] = cycles[count] + instr->cycles;
+    ++count;
+
+    if (ends_native_block(instr)) {
+      if (patch != SIZE_MAX) {
+        epilogue_patches[num_epilogue_patches++] = patch;
+      }
+
+      break;
+    }
+  }
+
+  if (count == 0) {
+    return NULL;
+  }
+
+  const struct BlockInstruction* last = block->instructions + count - 1;
+  if (!ends_native_block(last)) {
+    emit_leave(&e, pcs[count], cycles[count], count, NULL);
+  }
+
+  for (size_t i = 0; i < num_epilogue_patches; ++i) {
+    bind(&e, epilogue_patches[i]);
+  }
+
+  size_t epilogue = e.size;
+  emit_epilogue(&e);
+
+  // Side exits, the instruction has not changed any state yet.
+  for (u8 i = 0; i < count; ++i) {
+    size_t stub = e.size;
+    bool used = false;
+    for (size_t j = 0; j < e.num_exits; ++j) {
+      if (e.exit_instructions[j] == i) {
+        patch32(&e, e.exit_patches[j], stub - (e.exit_patches[j] + 4));
+        used = true;
+      }
+    }
+
+    if (used) {
+      emit_leave(&e, pcs[i], cycles[i], i, NULL);
+      size_t jump = emit_jmp(&e);
+      patch32(&e, jump, epilogue - (jump + 4));
+    }
+  }
+
+  if (e.overflow) {
+    jit->full = true;
+    return NULL;
+  }
+
+  NativeCode native = (NativeCode)(e.code);
+  jit->used += (e.size + 15) & ~(size_t)15;
+  return native;
+}
+
+NativeCode jit_translate(struct Jit* jit, const struct Block* block,
+                         enum CpuVariant variant) {
+  if (mprotect(jit->buffer, kJitBufferSize, PROT_READ | PROT_WRITE)) {
+    return NULL;
+  }
+
+  NativeCode native = emit_block(jit, block, variant);
+  if (mprotect(jit->buffer, kJitBufferSize, PROT_READ | PROT_EXEC)) {
+    // None of the code can run, a full buffer makes the caller drop it all.
+    jit->full = true;
+    return NULL;
+  }
+
+  return native;
+}
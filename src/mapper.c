@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "e6502.h"
+
+#define kMapperMaxWindows 8
+
+struct MapperWindow {
+  u8 first_page;
+  u8 num_pages;
+  u16 control;
+  bool writable;
+  size_t num_banks;
+
+  // As last written to the control registers, banks past the end of the
+  // storage wrap around.
+  u16 bank;
+};
+
+struct Mapper {
+  struct Bus* bus;
+  u8* storage;
+  size_t size;
+
+  struct MapperWindow windows[kMapperMaxWindows];
+  size_t num_windows;
+};
+
+struct Mapper* mapper_new(struct Bus* bus, int fd, size_t size) {
+  if (size == 0) {
+    return NULL;
+  }
+
+  // Mapping past the end of the file would fault on access.
+  struct stat st;
+  if (fd >= 0 && (fstat(fd, &st) || (size_t)st.st_size < size)) {
+    return NULL;
+  }
+
+  struct Mapper* mapper = calloc(1, sizeof(struct Mapper));
+  if (!mapper) {
+    return NULL;
+  }
+
+  // Pages are only backed by host memory once touched, or shared with the
+  // page cache until written.
+  if (fd >= 0) {
+    mapper->storage = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                           fd, 0);
+  } else {
+    mapper->storage =
+        mmap(NULL, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+
+  if (mapper->storage == MAP_FAILED) {
+    free(mapper);
+    return NULL;
+  }
+
+  mapper->bus = bus;
+  mapper->size = size;
+  return mapper;
+}
+
+void mapper_free(struct Mapper* mapper) {
+  if (mapper) {
+    munmap(mapper->storage, mapper->size);
+    free(mapper);
+  }
+}
+
+u8* mapper_storage(const struct Mapper* mapper) { return mapper->storage; }
+
+size_t mapper_size(const struct Mapper* mapper) { return mapper->size; }
+
+static void map_window(struct Mapper* mapper,
+                       const struct MapperWindow* window) {
+  size_t window_size = (size_t)window->num_pages << 8;
+  u8* bank = mapper->storage + window->bank % window->num_banks * window_size;
+  if (window->writable) {
+    bus_map_ram(mapper->bus, window->first_page, window->num_pages, bank);
+  } else {
+    bus_map_rom(mapper->bus, window->first_page, window->num_pages, bank);
+  }
+}
+
+int mapper_add_window(struct Mapper* mapper, u8 first_page, u8 num_pages,
+                      u16 control, bool writable) {
+  size_t window_size = (size_t)num_pages << 8;
+  if (mapper->num_windows == kMapperMaxWindows || num_pages == 0 ||
+      first_page + num_pages > 256 || window_size > mapper->size) {
+    return -1;
+  }
+
+  struct MapperWindow* window = mapper->windows + mapper->num_windows;
+  *window = (struct MapperWindow){
+      .first_page = first_page,
+      .num_pages = num_pages,
+      .control = control,
+      .writable = writable,
+      .bank = 0,
+      .num_banks = mapper->size / window_size,
+  };
+
+  map_window(mapper, window);
+  return mapper->num_windows++;
+}
+
+void mapper_select(struct Mapper* mapper, int window, u16 bank) {
+  struct MapperWindow* w = mapper->windows + window;
+  w->bank = bank;
+  map_window(mapper, w);
+}
+
+u16 mapper_bank(const struct Mapper* mapper, int window) {
+  const struct MapperWindow* w = mapper->windows + window;
+  return w->bank % w->num_banks;
+}
+
+bool mapper_write(struct Mapper* mapper, u16 addr, u8 data) {
+  for (size_t i = 0; i < mapper->num_windows; ++i) {
+    const struct MapperWindow* window = mapper->windows + i;
+    if (addr == window->control) {
+      mapper_select(mapper, i, (window->bank & 0xff00) | data);
+      return true;
+    }
+
+    if (addr == (u16)(window->control + 1)) {
+      mapper_select(mapper, i, (window->bank & 0x00ff) | data << 8);
+      return true;
+    }
+  }
+
+  return false;
+}
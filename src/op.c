@@ -2,114 +2,279 @@
 
 #include "cpu.h"
 
-void op_adc(struct Cpu* cpu, u16 addr, bool implied) {
+// A taken branch costs one cycle, one more if the target is on another page.
+static inline void branch(struct Cpu* cpu, u16 offset, bool taken) {
+  u16 target = taken ? cpu->pc + offset : cpu->pc;
+  cover(cpu, cpu->pc, target);
+  if (!taken) {
+    return;
+  }
+
+  cpu->cycles += ((target ^ cpu->pc) & 0xff00) ? 2 : 1;
+  cpu->pc = target;
+  if (offset >= 0xff80 && offset <= 0xfffe) {
+    cpu->closed_loop = true;
+  }
+}
+
+const u8 decimal_add[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+    0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+};
+
+const u8 decimal_sub[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x10, 0x11,
+    0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19,
+};
+
+// Shared with the undocumented opcodes that add or subtract what they wrote.
+static void adc(struct Cpu* cpu, u8 value) {
   u16 a = cpu->a;
-  u16 b = implied ? cpu->a : read(cpu, addr);
+  u16 b = value;
   u16 c = get_flag(cpu, kFlagCarry);
   u16 d = a + b + c;
 
-  set_flag(cpu, kFlagCarry, d > 0x00ff);
-  set_flag(cpu, kFlagZero, (d & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagOverflow, ~(a ^ b) & (a ^ d) & 0x0080);
-  set_flag(cpu, kFlagNegative, d & 0x0080);
+  if (get_flag(cpu, kFlagDecimal)) {
+    struct DecimalSum sum = decimal_adc(a, b, c);
+    cpu->flag_n = sum.n;
+    cpu->flag_z = d & 0x00ff;
+    cpu->flag_v = sum.v;
+    cpu->flag_c = sum.c;
+    cpu->a = sum.a;
+    if (cpu->variant != kCpuVariantNmos) {
+      set_nz(cpu, sum.a);
+      ++cpu->cycles;
+    }
+
+    return;
+  }
+
+  cpu->flag_c = d >> 8;
+  cpu->flag_v = ~(a ^ b) & (a ^ d);
+  set_nz(cpu, d & 0x00ff);
 
   cpu->a = d & 0x00ff;
 }
 
+static void sbc(struct Cpu* cpu, u8 value) {
+  u16 a = cpu->a;
+  u16 b = value;
+  u16 c = b ^ 0x00ff;
+  u16 d = get_flag(cpu, kFlagCarry);
+  u16 e = a + c + d;
+
+  cpu->flag_c = e >> 8;
+  cpu->flag_v = (e ^ a) & (e ^ c);
+  set_nz(cpu, e & 0x00ff);
+
+  if (!get_flag(cpu, kFlagDecimal)) {
+    cpu->a = e & 0x00ff;
+  } else if (cpu->variant == kCpuVariantNmos) {
+    cpu->a = decimal_sbc(a, b, d);
+  } else {
+    cpu->a = cmos_decimal_sbc(a, b, d);
+    set_nz(cpu, cpu->a);
+    ++cpu->cycles;
+  }
+}
+
+// ANE and LXA mix in bits of A that depend on the chip and its temperature,
+// this is the most common value.
+#define kUnstableMagic 0xee
+
+// SHA, SHX, SHY and TAS store a register ANDed with the high byte of the
+// base address plus one. When indexing crosses a page that value replaces
+// the high byte of the address as well.
+static void store_and_high(struct Cpu* cpu, u16 addr, u8 index, u8 value) {
+  u16 base = addr - index;
+  value &= (base >> 8) + 1;
+  if ((base ^ addr) & 0xff00) {
+    addr = (value << 8) | (addr & 0x00ff);
+  }
+
+  bus_store(cpu, addr, value);
+}
+
+void op_adc(struct Cpu* cpu, u16 addr, bool implied) {
+  adc(cpu, implied ? cpu->a : bus_load(cpu, addr));
+}
+
+void op_alr(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = cpu->a & bus_load(cpu, addr);
+
+  cpu->flag_c = a & 0x01;
+  cpu->a = a >> 1;
+  set_nz(cpu, cpu->a);
+}
+
+void op_anc(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->a &= bus_load(cpu, addr);
+
+  cpu->flag_c = cpu->a >> 7;
+  set_nz(cpu, cpu->a);
+}
+
 void op_and(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->a &= implied ? cpu->a : read(cpu, addr);
+  cpu->a &= implied ? cpu->a : bus_load(cpu, addr);
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
+}
+
+void op_ane(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->a = (cpu->a | kUnstableMagic) & cpu->x & bus_load(cpu, addr);
+
+  set_nz(cpu, cpu->a);
+}
+
+// In decimal mode the result is adjusted like that of ADC, C and V come from
+// the unadjusted digits.
+void op_arr(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = cpu->a & bus_load(cpu, addr);
+  u8 b = (get_flag(cpu, kFlagCarry) << 7) | (a >> 1);
+
+  set_nz(cpu, b);
+  if (!get_flag(cpu, kFlagDecimal)) {
+    cpu->flag_c = (b >> 6) & 0x01;
+    cpu->flag_v = (b ^ (b << 1)) << 1;
+    cpu->a = b;
+    return;
+  }
+
+  cpu->flag_v = (a ^ b) << 1;
+  if ((a & 0x0f) + (a & 0x01) > 0x05) {
+    b = (b & 0xf0) | ((b + 0x06) & 0x0f);
+  }
+
+  cpu->flag_c = (a & 0xf0) + (a & 0x10) > 0x50;
+  if (cpu->flag_c) {
+    b += 0x60;
+  }
+
+  cpu->a = b;
 }
 
 void op_asl(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = implied ? cpu->a : read(cpu, addr);
+  u16 a = implied ? cpu->a : bus_load(cpu, addr);
   a <<= 1;
 
-  set_flag(cpu, kFlagCarry, (a & 0xff00) != 0x0000);
-  set_flag(cpu, kFlagZero, (a & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, a & 0x0080);
+  cpu->flag_c = a >> 8;
+  set_nz(cpu, a & 0x00ff);
 
   if (implied) {
     cpu->a = a & 0x00ff;
   } else {
-    write(cpu, addr, a & 0x00ff);
+    bus_store(cpu, addr, a & 0x00ff);
   }
 }
 
-void op_bcc(struct Cpu* cpu, u16 addr, bool implied) {
-  if (!get_flag(cpu, kFlagCarry)) {
-    cpu->pc += addr;
+// BBR and BBS branch on a bit of a zero page byte, RMB and SMB clear and set
+// it. There is one op per bit.
+static void branch_on_bit(struct Cpu* cpu, u16 addr, u8 mask, bool set) {
+  u16 offset = addr >> 8;
+  if (offset & 0x0080) {
+    offset |= 0xff00;
   }
+
+  branch(cpu, offset, ((bus_load(cpu, addr & 0x00ff) & mask) != 0) == set);
+}
+
+#define BIT_OPS(bit)                                          \
+  void op_bbr##bit(struct Cpu* cpu, u16 addr, bool implied) { \
+    branch_on_bit(cpu, addr, 1 << bit, false);                \
+  }                                                           \
+                                                              \
+  void op_bbs##bit(struct Cpu* cpu, u16 addr, bool implied) { \
+    branch_on_bit(cpu, addr, 1 << bit, true);                 \
+  }                                                           \
+                                                              \
+  void op_rmb##bit(struct Cpu* cpu, u16 addr, bool implied) { \
+    bus_store(cpu, addr, bus_load(cpu, addr) & ~(1 << bit));  \
+  }                                                           \
+                                                              \
+  void op_smb##bit(struct Cpu* cpu, u16 addr, bool implied) { \
+    bus_store(cpu, addr, bus_load(cpu, addr) | 1 << bit);     \
+  }
+
+BIT_OPS(0)
+BIT_OPS(1)
+BIT_OPS(2)
+BIT_OPS(3)
+BIT_OPS(4)
+BIT_OPS(5)
+BIT_OPS(6)
+BIT_OPS(7)
+
+void op_bcc(struct Cpu* cpu, u16 addr, bool implied) {
+  branch(cpu, addr, !get_flag(cpu, kFlagCarry));
 }
 
 void op_bcs(struct Cpu* cpu, u16 addr, bool implied) {
-  if (get_flag(cpu, kFlagCarry)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, get_flag(cpu, kFlagCarry));
 }
 
 void op_beq(struct Cpu* cpu, u16 addr, bool implied) {
-  if (get_flag(cpu, kFlagZero)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, get_flag(cpu, kFlagZero));
 }
 
+// N and V are bits 7 and 6 of the operand, not of the AND.
 void op_bit(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = cpu->a;
-  u16 b = implied ? cpu->a : read(cpu, addr);
-  u16 c = a & b;
+  u8 b = implied ? cpu->a : bus_load(cpu, addr);
+
+  cpu->flag_n = b;
+  cpu->flag_z = cpu->a & b;
+  cpu->flag_v = b << 1;
+}
 
-  set_flag(cpu, kFlagZero, (c & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagOverflow, c & (1 << 6));
-  set_flag(cpu, kFlagNegative, c & (1 << 7));
+// The immediate form only sets Z.
+void op_bit_imm(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->flag_z = cpu->a & bus_load(cpu, addr);
 }
 
 void op_bmi(struct Cpu* cpu, u16 addr, bool implied) {
-  if (get_flag(cpu, kFlagNegative)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, get_flag(cpu, kFlagNegative));
 }
 
 void op_bne(struct Cpu* cpu, u16 addr, bool implied) {
-  if (!get_flag(cpu, kFlagZero)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, !get_flag(cpu, kFlagZero));
 }
 
 void op_bpl(struct Cpu* cpu, u16 addr, bool implied) {
-  if (!get_flag(cpu, kFlagNegative)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, !get_flag(cpu, kFlagNegative));
+}
+
+void op_bra(struct Cpu* cpu, u16 addr, bool implied) {
+  branch(cpu, addr, true);
 }
 
 void op_brk(struct Cpu* cpu, u16 addr, bool implied) {
   ++cpu->pc;  // TODO: Should this be increments twice?
 
-  write(cpu, 0x0100 + cpu->s--, (cpu->pc >> 8) & 0x00ff);
-  write(cpu, 0x0100 + cpu->s--, cpu->pc & 0x00ff);
+  bus_store(cpu, 0x0100 + cpu->s--, (cpu->pc >> 8) & 0x00ff);
+  bus_store(cpu, 0x0100 + cpu->s--, cpu->pc & 0x00ff);
 
   set_flag(cpu, kFlagBreak, true);
-  write(cpu, 0x0100 + cpu->s--, cpu->p);
+  bus_store(cpu, 0x0100 + cpu->s--, pack_flags(cpu));
   set_flag(cpu, kFlagBreak, false);
   set_flag(cpu, kFlagInterrupt, true);
+  if (cpu->variant != kCpuVariantNmos) {
+    set_flag(cpu, kFlagDecimal, false);
+  }
 
-  u16 lo = read(cpu, 0xfffe);
-  u16 hi = read(cpu, 0xffff);
+  u16 lo = bus_load(cpu, 0xfffe);
+  u16 hi = bus_load(cpu, 0xffff);
   cpu->pc = (hi << 8) | lo;
 }
 
 void op_bvc(struct Cpu* cpu, u16 addr, bool implied) {
-  if (!get_flag(cpu, kFlagOverflow)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, !get_flag(cpu, kFlagOverflow));
 }
 
 void op_bvs(struct Cpu* cpu, u16 addr, bool implied) {
-  if (get_flag(cpu, kFlagOverflow)) {
-    cpu->pc += addr;
-  }
+  branch(cpu, addr, get_flag(cpu, kFlagOverflow));
 }
 
 void op_clc(struct Cpu* cpu, u16 addr, bool implied) {
@@ -130,232 +295,318 @@ void op_clv(struct Cpu* cpu, u16 addr, bool implied) {
 
 void op_cmp(struct Cpu* cpu, u16 addr, bool implied) {
   u16 a = cpu->a;
-  u16 b = implied ? cpu->a : read(cpu, addr);
+  u16 b = implied ? cpu->a : bus_load(cpu, addr);
   u16 c = a - b;
 
   set_flag(cpu, kFlagCarry, a >= b);
-  set_flag(cpu, kFlagZero, (c & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, c & 0x0080);
+  set_nz(cpu, c & 0x00ff);
 }
 
 void op_cpx(struct Cpu* cpu, u16 addr, bool implied) {
   u16 a = cpu->x;
-  u16 b = implied ? cpu->a : read(cpu, addr);
+  u16 b = implied ? cpu->a : bus_load(cpu, addr);
   u16 c = a - b;
 
   set_flag(cpu, kFlagCarry, a >= b);
-  set_flag(cpu, kFlagZero, (c & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, c & 0x0080);
+  set_nz(cpu, c & 0x00ff);
 }
 
 void op_cpy(struct Cpu* cpu, u16 addr, bool implied) {
   u16 a = cpu->y;
-  u16 b = implied ? cpu->a : read(cpu, addr);
+  u16 b = implied ? cpu->a : bus_load(cpu, addr);
   u16 c = a - b;
 
   set_flag(cpu, kFlagCarry, a >= b);
-  set_flag(cpu, kFlagZero, (c & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, c & 0x0080);
+  set_nz(cpu, c & 0x00ff);
+}
+
+void op_dcp(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 b = bus_load(cpu, addr) - 1;
+  bus_store(cpu, addr, b);
+
+  set_flag(cpu, kFlagCarry, cpu->a >= b);
+  set_nz(cpu, cpu->a - b);
 }
 
 void op_dec(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = implied ? cpu->a : read(cpu, addr);
+  u16 a = implied ? cpu->a : bus_load(cpu, addr);
   --a;
 
-  write(cpu, addr, a & 0x00ff);
-  set_flag(cpu, kFlagZero, (a & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, a & 0x0080);
+  set_nz(cpu, a & 0x00ff);
+
+  if (implied) {
+    cpu->a = a & 0x00ff;
+  } else {
+    bus_store(cpu, addr, a & 0x00ff);
+  }
 }
 
 void op_dex(struct Cpu* cpu, u16 addr, bool implied) {
   --cpu->x;
 
-  set_flag(cpu, kFlagZero, cpu->x == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->x & 0x80);
+  set_nz(cpu, cpu->x);
 }
 
 void op_dey(struct Cpu* cpu, u16 addr, bool implied) {
   --cpu->y;
 
-  set_flag(cpu, kFlagZero, cpu->y == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->y & 0x80);
+  set_nz(cpu, cpu->y);
 }
 
 void op_eor(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->a ^= implied ? cpu->a : read(cpu, addr);
+  cpu->a ^= implied ? cpu->a : bus_load(cpu, addr);
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
 }
 
 void op_inc(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = implied ? cpu->a : read(cpu, addr);
+  u16 a = implied ? cpu->a : bus_load(cpu, addr);
   a += 1;
 
-  write(cpu, addr, a & 0x00ff);
-  set_flag(cpu, kFlagZero, (a & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, a & 0x0080);
+  set_nz(cpu, a & 0x00ff);
+
+  if (implied) {
+    cpu->a = a & 0x00ff;
+  } else {
+    bus_store(cpu, addr, a & 0x00ff);
+  }
 }
 
 void op_inx(struct Cpu* cpu, u16 addr, bool implied) {
   ++cpu->x;
 
-  set_flag(cpu, kFlagZero, cpu->x == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->x & 0x80);
+  set_nz(cpu, cpu->x);
 }
 
 void op_iny(struct Cpu* cpu, u16 addr, bool implied) {
   ++cpu->y;
 
-  set_flag(cpu, kFlagZero, cpu->y == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->y & 0x80);
+  set_nz(cpu, cpu->y);
+}
+
+void op_isc(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 b = bus_load(cpu, addr) + 1;
+  bus_store(cpu, addr, b);
+
+  sbc(cpu, b);
+}
+
+// The CPU locks up until reset. Leaves the PC at the opcode so that every
+// further run stops there again.
+void op_jam(struct Cpu* cpu, u16 addr, bool implied) {
+  --cpu->pc;
+  cpu->jammed = true;
+  cpu->stop_requested = true;
 }
 
-void op_jmp(struct Cpu* cpu, u16 addr, bool implied) { cpu->pc = addr; }
+void op_jmp(struct Cpu* cpu, u16 addr, bool implied) {
+  cover(cpu, cpu->pc, addr);
+  cpu->pc = addr;
+}
 
 void op_jsr(struct Cpu* cpu, u16 addr, bool implied) {
   u16 pc = cpu->pc - 1;
 
-  write(cpu, 0x0100 + cpu->s--, (pc >> 8) & 0x00ff);
-  write(cpu, 0x0100 + cpu->s--, pc & 0x00ff);
+  bus_store(cpu, 0x0100 + cpu->s--, (pc >> 8) & 0x00ff);
+  bus_store(cpu, 0x0100 + cpu->s--, pc & 0x00ff);
 
+  cover(cpu, cpu->pc, addr);
   cpu->pc = addr;
 }
 
+void op_las(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->s &= bus_load(cpu, addr);
+  cpu->a = cpu->s;
+  cpu->x = cpu->s;
+
+  set_nz(cpu, cpu->s);
+}
+
+void op_lax(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->a = bus_load(cpu, addr);
+  cpu->x = cpu->a;
+
+  set_nz(cpu, cpu->a);
+}
+
 void op_lda(struct Cpu* cpu, u16 addr, bool implied) {
   if (!implied) {
-    cpu->a = read(cpu, addr);
+    cpu->a = bus_load(cpu, addr);
   }
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
 }
 
 void op_ldx(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->x = implied ? cpu->a : read(cpu, addr);
+  cpu->x = implied ? cpu->a : bus_load(cpu, addr);
 
-  set_flag(cpu, kFlagZero, cpu->x == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->x & 0x80);
+  set_nz(cpu, cpu->x);
 }
 
 void op_ldy(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->y = implied ? cpu->a : read(cpu, addr);
+  cpu->y = implied ? cpu->a : bus_load(cpu, addr);
 
-  set_flag(cpu, kFlagZero, cpu->y == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->y & 0x80);
+  set_nz(cpu, cpu->y);
 }
 
 void op_lsr(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = implied ? cpu->a : read(cpu, addr);
+  u16 a = implied ? cpu->a : bus_load(cpu, addr);
   u16 b = a >> 1;
 
-  set_flag(cpu, kFlagCarry, a & 0x0001);
-  set_flag(cpu, kFlagZero, (b & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, b & 0x0080);
+  cpu->flag_c = a & 0x0001;
+  set_nz(cpu, b & 0x00ff);
 
   if (implied) {
     cpu->a = b & 0x00ff;
   } else {
-    write(cpu, addr, b & 0x00ff);
+    bus_store(cpu, addr, b & 0x00ff);
   }
 }
 
-void op_nop(struct Cpu* cpu, u16 addr, bool implied) {}
+void op_lxa(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->a = (cpu->a | kUnstableMagic) & bus_load(cpu, addr);
+  cpu->x = cpu->a;
+
+  set_nz(cpu, cpu->a);
+}
+
+// The undocumented NOPs with an operand read it.
+void op_nop(struct Cpu* cpu, u16 addr, bool implied) {
+  if (!implied) {
+    bus_load(cpu, addr);
+  }
+}
 
 void op_ora(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->a |= implied ? cpu->a : read(cpu, addr);
+  cpu->a |= implied ? cpu->a : bus_load(cpu, addr);
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
 }
 
 void op_pha(struct Cpu* cpu, u16 addr, bool implied) {
-  write(cpu, 0x0100 + cpu->s--, cpu->a);
+  bus_store(cpu, 0x0100 + cpu->s--, cpu->a);
 }
 
 void op_php(struct Cpu* cpu, u16 addr, bool implied) {
-  write(cpu, 0x0100 + cpu->s--, cpu->p | kFlagBreak | KFlagUnused);
+  bus_store(cpu, 0x0100 + cpu->s--, pack_flags(cpu) | kFlagBreak | KFlagUnused);
   set_flag(cpu, kFlagBreak, false);
-  set_flag(cpu, KFlagUnused, false);
+}
+
+void op_phx(struct Cpu* cpu, u16 addr, bool implied) {
+  bus_store(cpu, 0x0100 + cpu->s--, cpu->x);
+}
+
+void op_phy(struct Cpu* cpu, u16 addr, bool implied) {
+  bus_store(cpu, 0x0100 + cpu->s--, cpu->y);
 }
 
 void op_pla(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->a = read(cpu, 0x0100 + ++cpu->s);
+  cpu->a = bus_load(cpu, 0x0100 + ++cpu->s);
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
 }
 
 void op_plp(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->p = read(cpu, 0x0100 + ++cpu->s);
+  unpack_flags(cpu, bus_load(cpu, 0x0100 + ++cpu->s));
 
   set_flag(cpu, KFlagUnused, true);
 }
 
+void op_plx(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->x = bus_load(cpu, 0x0100 + ++cpu->s);
+
+  set_nz(cpu, cpu->x);
+}
+
+void op_ply(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->y = bus_load(cpu, 0x0100 + ++cpu->s);
+
+  set_nz(cpu, cpu->y);
+}
+
+void op_rla(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = bus_load(cpu, addr);
+  u8 b = (a << 1) | get_flag(cpu, kFlagCarry);
+  bus_store(cpu, addr, b);
+
+  cpu->flag_c = a >> 7;
+  cpu->a &= b;
+  set_nz(cpu, cpu->a);
+}
+
 void op_rol(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = implied ? cpu->a : read(cpu, addr);
+  u16 a = implied ? cpu->a : bus_load(cpu, addr);
   u16 b = get_flag(cpu, kFlagCarry);
   u16 c = (a << 1) | b;
 
-  set_flag(cpu, kFlagCarry, c & 0xff00);
-  set_flag(cpu, kFlagZero, (c & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, c & 0x0080);
+  cpu->flag_c = c >> 8;
+  set_nz(cpu, c & 0x00ff);
 
   if (implied) {
     cpu->a = c & 0x00ff;
   } else {
-    write(cpu, addr, c & 0x00ff);
+    bus_store(cpu, addr, c & 0x00ff);
   }
 }
 
 void op_ror(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = implied ? cpu->a : read(cpu, addr);
+  u16 a = implied ? cpu->a : bus_load(cpu, addr);
   u16 b = get_flag(cpu, kFlagCarry);
   u16 c = (b << 7) | (a >> 1);
 
-  set_flag(cpu, kFlagCarry, a & 0x0001);
-  set_flag(cpu, kFlagZero, (c & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagNegative, c & 0x0080);
+  cpu->flag_c = a & 0x0001;
+  set_nz(cpu, c & 0x00ff);
 
   if (implied) {
     cpu->a = c & 0x00ff;
   } else {
-    write(cpu, addr, c & 0x00ff);
+    bus_store(cpu, addr, c & 0x00ff);
   }
 }
 
+void op_rra(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = bus_load(cpu, addr);
+  u8 b = (get_flag(cpu, kFlagCarry) << 7) | (a >> 1);
+  bus_store(cpu, addr, b);
+
+  cpu->flag_c = a & 0x01;
+  adc(cpu, b);
+}
+
 void op_rti(struct Cpu* cpu, u16 addr, bool implied) {
-  cpu->p = read(cpu, 0x0100 + ++cpu->s);
+  unpack_flags(cpu, bus_load(cpu, 0x0100 + ++cpu->s));
 
   set_flag(cpu, kFlagBreak, false);
-  set_flag(cpu, KFlagUnused, false);
+  set_flag(cpu, KFlagUnused, true);
 
-  u16 lo = read(cpu, 0x0100 + ++cpu->s);
-  u16 hi = read(cpu, 0x0100 + ++cpu->s);
+  u16 lo = bus_load(cpu, 0x0100 + ++cpu->s);
+  u16 hi = bus_load(cpu, 0x0100 + ++cpu->s);
 
   cpu->pc = (hi << 8) | lo;
 }
 
 void op_rts(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 lo = read(cpu, 0x0100 + ++cpu->s);
-  u16 hi = read(cpu, 0x0100 + ++cpu->s);
+  u16 lo = bus_load(cpu, 0x0100 + ++cpu->s);
+  u16 hi = bus_load(cpu, 0x0100 + ++cpu->s);
 
   cpu->pc = ((hi << 8) | lo) + 1;
 }
 
+void op_sax(struct Cpu* cpu, u16 addr, bool implied) {
+  bus_store(cpu, addr, cpu->a & cpu->x);
+}
+
 void op_sbc(struct Cpu* cpu, u16 addr, bool implied) {
-  u16 a = cpu->a;
-  u16 b = implied ? cpu->a : read(cpu, addr);
-  u16 c = b ^ 0x00ff;
-  u16 d = get_flag(cpu, kFlagCarry);
-  u16 e = a + c + d;
+  sbc(cpu, implied ? cpu->a : bus_load(cpu, addr));
+}
 
-  set_flag(cpu, kFlagCarry, e & 0xff00);
-  set_flag(cpu, kFlagZero, (e & 0x00ff) == 0x0000);
-  set_flag(cpu, kFlagOverflow, (e ^ a) & (e & c) & 0x0080);
-  set_flag(cpu, kFlagNegative, e & 0x0080);
+void op_sbx(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = cpu->a & cpu->x;
+  u8 b = bus_load(cpu, addr);
 
-  cpu->a = e & 0x00ff;
+  set_flag(cpu, kFlagCarry, a >= b);
+  cpu->x = a - b;
+  set_nz(cpu, cpu->x);
 }
 
 void op_sec(struct Cpu* cpu, u16 addr, bool implied) {
@@ -370,44 +621,96 @@ void op_sei(struct Cpu* cpu, u16 addr, bool implied) {
   set_flag(cpu, kFlagInterrupt, true);
 }
 
+void op_sha(struct Cpu* cpu, u16 addr, bool implied) {
+  store_and_high(cpu, addr, cpu->y, cpu->a & cpu->x);
+}
+
+void op_shx(struct Cpu* cpu, u16 addr, bool implied) {
+  store_and_high(cpu, addr, cpu->y, cpu->x);
+}
+
+void op_shy(struct Cpu* cpu, u16 addr, bool implied) {
+  store_and_high(cpu, addr, cpu->x, cpu->y);
+}
+
+void op_slo(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = bus_load(cpu, addr);
+  u8 b = a << 1;
+  bus_store(cpu, addr, b);
+
+  cpu->flag_c = a >> 7;
+  cpu->a |= b;
+  set_nz(cpu, cpu->a);
+}
+
+void op_sre(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = bus_load(cpu, addr);
+  u8 b = a >> 1;
+  bus_store(cpu, addr, b);
+
+  cpu->flag_c = a & 0x01;
+  cpu->a ^= b;
+  set_nz(cpu, cpu->a);
+}
+
 void op_sta(struct Cpu* cpu, u16 addr, bool implied) {
-  write(cpu, addr, cpu->a);
+  bus_store(cpu, addr, cpu->a);
 }
 
 void op_stx(struct Cpu* cpu, u16 addr, bool implied) {
-  write(cpu, addr, cpu->x);
+  bus_store(cpu, addr, cpu->x);
 }
 
 void op_sty(struct Cpu* cpu, u16 addr, bool implied) {
-  write(cpu, addr, cpu->y);
+  bus_store(cpu, addr, cpu->y);
+}
+
+void op_stz(struct Cpu* cpu, u16 addr, bool implied) {
+  bus_store(cpu, addr, 0x00);
+}
+
+void op_tas(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->s = cpu->a & cpu->x;
+  store_and_high(cpu, addr, cpu->y, cpu->s);
 }
 
 void op_tax(struct Cpu* cpu, u16 addr, bool implied) {
   cpu->x = cpu->a;
 
-  set_flag(cpu, kFlagZero, cpu->x == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->x & 0x80);
+  set_nz(cpu, cpu->x);
 }
 
 void op_tay(struct Cpu* cpu, u16 addr, bool implied) {
   cpu->y = cpu->a;
 
-  set_flag(cpu, kFlagZero, cpu->y == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->y & 0x80);
+  set_nz(cpu, cpu->y);
+}
+
+// TRB and TSB set Z like BIT and clear or set the bits of A in memory.
+void op_trb(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = bus_load(cpu, addr);
+  cpu->flag_z = cpu->a & a;
+
+  bus_store(cpu, addr, a & ~cpu->a);
+}
+
+void op_tsb(struct Cpu* cpu, u16 addr, bool implied) {
+  u8 a = bus_load(cpu, addr);
+  cpu->flag_z = cpu->a & a;
+
+  bus_store(cpu, addr, a | cpu->a);
 }
 
 void op_tsx(struct Cpu* cpu, u16 addr, bool implied) {
   cpu->x = cpu->s;
 
-  set_flag(cpu, kFlagZero, cpu->x == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->x & 0x80);
+  set_nz(cpu, cpu->x);
 }
 
 void op_txa(struct Cpu* cpu, u16 addr, bool implied) {
   cpu->a = cpu->x;
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
 }
 
 void op_txs(struct Cpu* cpu, u16 addr, bool implied) { cpu->s = cpu->x; }
@@ -415,6 +718,11 @@ void op_txs(struct Cpu* cpu, u16 addr, bool implied) { cpu->s = cpu->x; }
 void op_tya(struct Cpu* cpu, u16 addr, bool implied) {
   cpu->a = cpu->y;
 
-  set_flag(cpu, kFlagZero, cpu->a == 0x00);
-  set_flag(cpu, kFlagNegative, cpu->a & 0x80);
+  set_nz(cpu, cpu->a);
+}
+
+// Stops the run, run_until() lets time pass until an interrupt wakes the CPU.
+void op_wai(struct Cpu* cpu, u16 addr, bool implied) {
+  cpu->waiting = true;
+  cpu->stop_requested = true;
 }
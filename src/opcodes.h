@@ -0,0 +1,533 @@
+#pragma once
+
+// The NMOS 6502 opcode matrix, one row per opcode in order. Every table of
+// the library that is indexed by opcode is generated from it or from the
+// 65C02 matrix below, and instr.c checks the rows against the rules of the
+// matrices at compile time.
+//
+// X(opcode, mnemonic, op, addr_mode, cycles, page_cycle, access, documented,
+//   stable)
+//
+// op names the op_ function. cycles excludes the page crossing cycle, which
+// only indexed reads take, and the branch penalties. access is what the
+// instruction does at its effective address. Unstable opcodes depend on the
+// chip or jam it, see cpu_set_strict().
+#define OPCODES(X)                               \
+  X(0x00, "BRK", brk, Implied, 7, 0, None, 1, 1) \
+  X(0x01, "ORA", ora, Izx, 6, 0, Read, 1, 1)     \
+  X(0x02, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x03, "SLO", slo, Izx, 8, 0, Rmw, 0, 1)      \
+  X(0x04, "NOP", nop, Zp, 3, 0, Read, 0, 1)      \
+  X(0x05, "ORA", ora, Zp, 3, 0, Read, 1, 1)      \
+  X(0x06, "ASL", asl, Zp, 5, 0, Rmw, 1, 1)       \
+  X(0x07, "SLO", slo, Zp, 5, 0, Rmw, 0, 1)       \
+  X(0x08, "PHP", php, Implied, 3, 0, None, 1, 1) \
+  X(0x09, "ORA", ora, Imm, 2, 0, Read, 1, 1)     \
+  X(0x0a, "ASL", asl, Implied, 2, 0, None, 1, 1) \
+  X(0x0b, "ANC", anc, Imm, 2, 0, Read, 0, 1)     \
+  X(0x0c, "NOP", nop, Abs, 4, 0, Read, 0, 1)     \
+  X(0x0d, "ORA", ora, Abs, 4, 0, Read, 1, 1)     \
+  X(0x0e, "ASL", asl, Abs, 6, 0, Rmw, 1, 1)      \
+  X(0x0f, "SLO", slo, Abs, 6, 0, Rmw, 0, 1)      \
+  X(0x10, "BPL", bpl, Rel, 2, 0, None, 1, 1)     \
+  X(0x11, "ORA", ora, Izy, 5, 1, Read, 1, 1)     \
+  X(0x12, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x13, "SLO", slo, Izy, 8, 0, Rmw, 0, 1)      \
+  X(0x14, "NOP", nop, Zpx, 4, 0, Read, 0, 1)     \
+  X(0x15, "ORA", ora, Zpx, 4, 0, Read, 1, 1)     \
+  X(0x16, "ASL", asl, Zpx, 6, 0, Rmw, 1, 1)      \
+  X(0x17, "SLO", slo, Zpx, 6, 0, Rmw, 0, 1)      \
+  X(0x18, "CLC", clc, Implied, 2, 0, None, 1, 1) \
+  X(0x19, "ORA", ora, Aby, 4, 1, Read, 1, 1)     \
+  X(0x1a, "NOP", nop, Implied, 2, 0, None, 0, 1) \
+  X(0x1b, "SLO", slo, Aby, 7, 0, Rmw, 0, 1)      \
+  X(0x1c, "NOP", nop, Abx, 4, 1, Read, 0, 1)     \
+  X(0x1d, "ORA", ora, Abx, 4, 1, Read, 1, 1)     \
+  X(0x1e, "ASL", asl, Abx, 7, 0, Rmw, 1, 1)      \
+  X(0x1f, "SLO", slo, Abx, 7, 0, Rmw, 0, 1)      \
+  X(0x20, "JSR", jsr, Abs, 6, 0, None, 1, 1)     \
+  X(0x21, "AND", and, Izx, 6, 0, Read, 1, 1)     \
+  X(0x22, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x23, "RLA", rla, Izx, 8, 0, Rmw, 0, 1)      \
+  X(0x24, "BIT", bit, Zp, 3, 0, Read, 1, 1)      \
+  X(0x25, "AND", and, Zp, 3, 0, Read, 1, 1)      \
+  X(0x26, "ROL", rol, Zp, 5, 0, Rmw, 1, 1)       \
+  X(0x27, "RLA", rla, Zp, 5, 0, Rmw, 0, 1)       \
+  X(0x28, "PLP", plp, Implied, 4, 0, None, 1, 1) \
+  X(0x29, "AND", and, Imm, 2, 0, Read, 1, 1)     \
+  X(0x2a, "ROL", rol, Implied, 2, 0, None, 1, 1) \
+  X(0x2b, "ANC", anc, Imm, 2, 0, Read, 0, 1)     \
+  X(0x2c, "BIT", bit, Abs, 4, 0, Read, 1, 1)     \
+  X(0x2d, "AND", and, Abs, 4, 0, Read, 1, 1)     \
+  X(0x2e, "ROL", rol, Abs, 6, 0, Rmw, 1, 1)      \
+  X(0x2f, "RLA", rla, Abs, 6, 0, Rmw, 0, 1)      \
+  X(0x30, "BMI", bmi, Rel, 2, 0, None, 1, 1)     \
+  X(0x31, "AND", and, Izy, 5, 1, Read, 1, 1)     \
+  X(0x32, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x33, "RLA", rla, Izy, 8, 0, Rmw, 0, 1)      \
+  X(0x34, "NOP", nop, Zpx, 4, 0, Read, 0, 1)     \
+  X(0x35, "AND", and, Zpx, 4, 0, Read, 1, 1)     \
+  X(0x36, "ROL", rol, Zpx, 6, 0, Rmw, 1, 1)      \
+  X(0x37, "RLA", rla, Zpx, 6, 0, Rmw, 0, 1)      \
+  X(0x38, "SEC", sec, Implied, 2, 0, None, 1, 1) \
+  X(0x39, "AND", and, Aby, 4, 1, Read, 1, 1)     \
+  X(0x3a, "NOP", nop, Implied, 2, 0, None, 0, 1) \
+  X(0x3b, "RLA", rla, Aby, 7, 0, Rmw, 0, 1)      \
+  X(0x3c, "NOP", nop, Abx, 4, 1, Read, 0, 1)     \
+  X(0x3d, "AND", and, Abx, 4, 1, Read, 1, 1)     \
+  X(0x3e, "ROL", rol, Abx, 7, 0, Rmw, 1, 1)      \
+  X(0x3f, "RLA", rla, Abx, 7, 0, Rmw, 0, 1)      \
+  X(0x40, "RTI", rti, Implied, 6, 0, None, 1, 1) \
+  X(0x41, "EOR", eor, Izx, 6, 0, Read, 1, 1)     \
+  X(0x42, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x43, "SRE", sre, Izx, 8, 0, Rmw, 0, 1)      \
+  X(0x44, "NOP", nop, Zp, 3, 0, Read, 0, 1)      \
+  X(0x45, "EOR", eor, Zp, 3, 0, Read, 1, 1)      \
+  X(0x46, "LSR", lsr, Zp, 5, 0, Rmw, 1, 1)       \
+  X(0x47, "SRE", sre, Zp, 5, 0, Rmw, 0, 1)       \
+  X(0x48, "PHA", pha, Implied, 3, 0, None, 1, 1) \
+  X(0x49, "EOR", eor, Imm, 2, 0, Read, 1, 1)     \
+  X(0x4a, "LSR", lsr, Implied, 2, 0, None, 1, 1) \
+  X(0x4b, "ALR", alr, Imm, 2, 0, Read, 0, 1)     \
+  X(0x4c, "JMP", jmp, Abs, 3, 0, None, 1, 1)     \
+  X(0x4d, "EOR", eor, Abs, 4, 0, Read, 1, 1)     \
+  X(0x4e, "LSR", lsr, Abs, 6, 0, Rmw, 1, 1)      \
+  X(0x4f, "SRE", sre, Abs, 6, 0, Rmw, 0, 1)      \
+  X(0x50, "BVC", bvc, Rel, 2, 0, None, 1, 1)     \
+  X(0x51, "EOR", eor, Izy, 5, 1, Read, 1, 1)     \
+  X(0x52, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x53, "SRE", sre, Izy, 8, 0, Rmw, 0, 1)      \
+  X(0x54, "NOP", nop, Zpx, 4, 0, Read, 0, 1)     \
+  X(0x55, "EOR", eor, Zpx, 4, 0, Read, 1, 1)     \
+  X(0x56, "LSR", lsr, Zpx, 6, 0, Rmw, 1, 1)      \
+  X(0x57, "SRE", sre, Zpx, 6, 0, Rmw, 0, 1)      \
+  X(0x58, "CLI", cli, Implied, 2, 0, None, 1, 1) \
+  X(0x59, "EOR", eor, Aby, 4, 1, Read, 1, 1)     \
+  X(0x5a, "NOP", nop, Implied, 2, 0, None, 0, 1) \
+  X(0x5b, "SRE", sre, Aby, 7, 0, Rmw, 0, 1)      \
+  X(0x5c, "NOP", nop, Abx, 4, 1, Read, 0, 1)     \
+  X(0x5d, "EOR", eor, Abx, 4, 1, Read, 1, 1)     \
+  X(0x5e, "LSR", lsr, Abx, 7, 0, Rmw, 1, 1)      \
+  X(0x5f, "SRE", sre, Abx, 7, 0, Rmw, 0, 1)      \
+  X(0x60, "RTS", rts, Implied, 6, 0, None, 1, 1) \
+  X(0x61, "ADC", adc, Izx, 6, 0, Read, 1, 1)     \
+  X(0x62, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x63, "RRA", rra, Izx, 8, 0, Rmw, 0, 1)      \
+  X(0x64, "NOP", nop, Zp, 3, 0, Read, 0, 1)      \
+  X(0x65, "ADC", adc, Zp, 3, 0, Read, 1, 1)      \
+  X(0x66, "ROR", ror, Zp, 5, 0, Rmw, 1, 1)       \
+  X(0x67, "RRA", rra, Zp, 5, 0, Rmw, 0, 1)       \
+  X(0x68, "PLA", pla, Implied, 4, 0, None, 1, 1) \
+  X(0x69, "ADC", adc, Imm, 2, 0, Read, 1, 1)     \
+  X(0x6a, "ROR", ror, Implied, 2, 0, None, 1, 1) \
+  X(0x6b, "ARR", arr, Imm, 2, 0, Read, 0, 1)     \
+  X(0x6c, "JMP", jmp, Ind, 5, 0, None, 1, 1)     \
+  X(0x6d, "ADC", adc, Abs, 4, 0, Read, 1, 1)     \
+  X(0x6e, "ROR", ror, Abs, 6, 0, Rmw, 1, 1)      \
+  X(0x6f, "RRA", rra, Abs, 6, 0, Rmw, 0, 1)      \
+  X(0x70, "BVS", bvs, Rel, 2, 0, None, 1, 1)     \
+  X(0x71, "ADC", adc, Izy, 5, 1, Read, 1, 1)     \
+  X(0x72, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x73, "RRA", rra, Izy, 8, 0, Rmw, 0, 1)      \
+  X(0x74, "NOP", nop, Zpx, 4, 0, Read, 0, 1)     \
+  X(0x75, "ADC", adc, Zpx, 4, 0, Read, 1, 1)     \
+  X(0x76, "ROR", ror, Zpx, 6, 0, Rmw, 1, 1)      \
+  X(0x77, "RRA", rra, Zpx, 6, 0, Rmw, 0, 1)      \
+  X(0x78, "SEI", sei, Implied, 2, 0, None, 1, 1) \
+  X(0x79, "ADC", adc, Aby, 4, 1, Read, 1, 1)     \
+  X(0x7a, "NOP", nop, Implied, 2, 0, None, 0, 1) \
+  X(0x7b, "RRA", rra, Aby, 7, 0, Rmw, 0, 1)      \
+  X(0x7c, "NOP", nop, Abx, 4, 1, Read, 0, 1)     \
+  X(0x7d, "ADC", adc, Abx, 4, 1, Read, 1, 1)     \
+  X(0x7e, "ROR", ror, Abx, 7, 0, Rmw, 1, 1)      \
+  X(0x7f, "RRA", rra, Abx, 7, 0, Rmw, 0, 1)      \
+  X(0x80, "NOP", nop, Imm, 2, 0, Read, 0, 1)     \
+  X(0x81, "STA", sta, Izx, 6, 0, Write, 1, 1)    \
+  X(0x82, "NOP", nop, Imm, 2, 0, Read, 0, 1)     \
+  X(0x83, "SAX", sax, Izx, 6, 0, Write, 0, 1)    \
+  X(0x84, "STY", sty, Zp, 3, 0, Write, 1, 1)     \
+  X(0x85, "STA", sta, Zp, 3, 0, Write, 1, 1)     \
+  X(0x86, "STX", stx, Zp, 3, 0, Write, 1, 1)     \
+  X(0x87, "SAX", sax, Zp, 3, 0, Write, 0, 1)     \
+  X(0x88, "DEY", dey, Implied, 2, 0, None, 1, 1) \
+  X(0x89, "NOP", nop, Imm, 2, 0, Read, 0, 1)     \
+  X(0x8a, "TXA", txa, Implied, 2, 0, None, 1, 1) \
+  X(0x8b, "ANE", ane, Imm, 2, 0, Read, 0, 0)     \
+  X(0x8c, "STY", sty, Abs, 4, 0, Write, 1, 1)    \
+  X(0x8d, "STA", sta, Abs, 4, 0, Write, 1, 1)    \
+  X(0x8e, "STX", stx, Abs, 4, 0, Write, 1, 1)    \
+  X(0x8f, "SAX", sax, Abs, 4, 0, Write, 0, 1)    \
+  X(0x90, "BCC", bcc, Rel, 2, 0, None, 1, 1)     \
+  X(0x91, "STA", sta, Izy, 6, 0, Write, 1, 1)    \
+  X(0x92, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0x93, "SHA", sha, Izy, 6, 0, Write, 0, 0)    \
+  X(0x94, "STY", sty, Zpx, 4, 0, Write, 1, 1)    \
+  X(0x95, "STA", sta, Zpx, 4, 0, Write, 1, 1)    \
+  X(0x96, "STX", stx, Zpy, 4, 0, Write, 1, 1)    \
+  X(0x97, "SAX", sax, Zpy, 4, 0, Write, 0, 1)    \
+  X(0x98, "TYA", tya, Implied, 2, 0, None, 1, 1) \
+  X(0x99, "STA", sta, Aby, 5, 0, Write, 1, 1)    \
+  X(0x9a, "TXS", txs, Implied, 2, 0, None, 1, 1) \
+  X(0x9b, "TAS", tas, Aby, 5, 0, Write, 0, 0)    \
+  X(0x9c, "SHY", shy, Abx, 5, 0, Write, 0, 0)    \
+  X(0x9d, "STA", sta, Abx, 5, 0, Write, 1, 1)    \
+  X(0x9e, "SHX", shx, Aby, 5, 0, Write, 0, 0)    \
+  X(0x9f, "SHA", sha, Aby, 5, 0, Write, 0, 0)    \
+  X(0xa0, "LDY", ldy, Imm, 2, 0, Read, 1, 1)     \
+  X(0xa1, "LDA", lda, Izx, 6, 0, Read, 1, 1)     \
+  X(0xa2, "LDX", ldx, Imm, 2, 0, Read, 1, 1)     \
+  X(0xa3, "LAX", lax, Izx, 6, 0, Read, 0, 1)     \
+  X(0xa4, "LDY", ldy, Zp, 3, 0, Read, 1, 1)      \
+  X(0xa5, "LDA", lda, Zp, 3, 0, Read, 1, 1)      \
+  X(0xa6, "LDX", ldx, Zp, 3, 0, Read, 1, 1)      \
+  X(0xa7, "LAX", lax, Zp, 3, 0, Read, 0, 1)      \
+  X(0xa8, "TAY", tay, Implied, 2, 0, None, 1, 1) \
+  X(0xa9, "LDA", lda, Imm, 2, 0, Read, 1, 1)     \
+  X(0xaa, "TAX", tax, Implied, 2, 0, None, 1, 1) \
+  X(0xab, "LXA", lxa, Imm, 2, 0, Read, 0, 0)     \
+  X(0xac, "LDY", ldy, Abs, 4, 0, Read, 1, 1)     \
+  X(0xad, "LDA", lda, Abs, 4, 0, Read, 1, 1)     \
+  X(0xae, "LDX", ldx, Abs, 4, 0, Read, 1, 1)     \
+  X(0xaf, "LAX", lax, Abs, 4, 0, Read, 0, 1)     \
+  X(0xb0, "BCS", bcs, Rel, 2, 0, None, 1, 1)     \
+  X(0xb1, "LDA", lda, Izy, 5, 1, Read, 1, 1)     \
+  X(0xb2, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0xb3, "LAX", lax, Izy, 5, 1, Read, 0, 1)     \
+  X(0xb4, "LDY", ldy, Zpx, 4, 0, Read, 1, 1)     \
+  X(0xb5, "LDA", lda, Zpx, 4, 0, Read, 1, 1)     \
+  X(0xb6, "LDX", ldx, Zpy, 4, 0, Read, 1, 1)     \
+  X(0xb7, "LAX", lax, Zpy, 4, 0, Read, 0, 1)     \
+  X(0xb8, "CLV", clv, Implied, 2, 0, None, 1, 1) \
+  X(0xb9, "LDA", lda, Aby, 4, 1, Read, 1, 1)     \
+  X(0xba, "TSX", tsx, Implied, 2, 0, None, 1, 1) \
+  X(0xbb, "LAS", las, Aby, 4, 1, Read, 0, 1)     \
+  X(0xbc, "LDY", ldy, Abx, 4, 1, Read, 1, 1)     \
+  X(0xbd, "LDA", lda, Abx, 4, 1, Read, 1, 1)     \
+  X(0xbe, "LDX", ldx, Aby, 4, 1, Read, 1, 1)     \
+  X(0xbf, "LAX", lax, Aby, 4, 1, Read, 0, 1)     \
+  X(0xc0, "CPY", cpy, Imm, 2, 0, Read, 1, 1)     \
+  X(0xc1, "CMP", cmp, Izx, 6, 0, Read, 1, 1)     \
+  X(0xc2, "NOP", nop, Imm, 2, 0, Read, 0, 1)     \
+  X(0xc3, "DCP", dcp, Izx, 8, 0, Rmw, 0, 1)      \
+  X(0xc4, "CPY", cpy, Zp, 3, 0, Read, 1, 1)      \
+  X(0xc5, "CMP", cmp, Zp, 3, 0, Read, 1, 1)      \
+  X(0xc6, "DEC", dec, Zp, 5, 0, Rmw, 1, 1)       \
+  X(0xc7, "DCP", dcp, Zp, 5, 0, Rmw, 0, 1)       \
+  X(0xc8, "INY", iny, Implied, 2, 0, None, 1, 1) \
+  X(0xc9, "CMP", cmp, Imm, 2, 0, Read, 1, 1)     \
+  X(0xca, "DEX", dex, Implied, 2, 0, None, 1, 1) \
+  X(0xcb, "SBX", sbx, Imm, 2, 0, Read, 0, 1)     \
+  X(0xcc, "CPY", cpy, Abs, 4, 0, Read, 1, 1)     \
+  X(0xcd, "CMP", cmp, Abs, 4, 0, Read, 1, 1)     \
+  X(0xce, "DEC", dec, Abs, 6, 0, Rmw, 1, 1)      \
+  X(0xcf, "DCP", dcp, Abs, 6, 0, Rmw, 0, 1)      \
+  X(0xd0, "BNE", bne, Rel, 2, 0, None, 1, 1)     \
+  X(0xd1, "CMP", cmp, Izy, 5, 1, Read, 1, 1)     \
+  X(0xd2, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0xd3, "DCP", dcp, Izy, 8, 0, Rmw, 0, 1)      \
+  X(0xd4, "NOP", nop, Zpx, 4, 0, Read, 0, 1)     \
+  X(0xd5, "CMP", cmp, Zpx, 4, 0, Read, 1, 1)     \
+  X(0xd6, "DEC", dec, Zpx, 6, 0, Rmw, 1, 1)      \
+  X(0xd7, "DCP", dcp, Zpx, 6, 0, Rmw, 0, 1)      \
+  X(0xd8, "CLD", cld, Implied, 2, 0, None, 1, 1) \
+  X(0xd9, "CMP", cmp, Aby, 4, 1, Read, 1, 1)     \
+  X(0xda, "NOP", nop, Implied, 2, 0, None, 0, 1) \
+  X(0xdb, "DCP", dcp, Aby, 7, 0, Rmw, 0, 1)      \
+  X(0xdc, "NOP", nop, Abx, 4, 1, Read, 0, 1)     \
+  X(0xdd, "CMP", cmp, Abx, 4, 1, Read, 1, 1)     \
+  X(0xde, "DEC", dec, Abx, 7, 0, Rmw, 1, 1)      \
+  X(0xdf, "DCP", dcp, Abx, 7, 0, Rmw, 0, 1)      \
+  X(0xe0, "CPX", cpx, Imm, 2, 0, Read, 1, 1)     \
+  X(0xe1, "SBC", sbc, Izx, 6, 0, Read, 1, 1)     \
+  X(0xe2, "NOP", nop, Imm, 2, 0, Read, 0, 1)     \
+  X(0xe3, "ISC", isc, Izx, 8, 0, Rmw, 0, 1)      \
+  X(0xe4, "CPX", cpx, Zp, 3, 0, Read, 1, 1)      \
+  X(0xe5, "SBC", sbc, Zp, 3, 0, Read, 1, 1)      \
+  X(0xe6, "INC", inc, Zp, 5, 0, Rmw, 1, 1)       \
+  X(0xe7, "ISC", isc, Zp, 5, 0, Rmw, 0, 1)       \
+  X(0xe8, "INX", inx, Implied, 2, 0, None, 1, 1) \
+  X(0xe9, "SBC", sbc, Imm, 2, 0, Read, 1, 1)     \
+  X(0xea, "NOP", nop, Implied, 2, 0, None, 1, 1) \
+  X(0xeb, "SBC", sbc, Imm, 2, 0, Read, 0, 1)     \
+  X(0xec, "CPX", cpx, Abs, 4, 0, Read, 1, 1)     \
+  X(0xed, "SBC", sbc, Abs, 4, 0, Read, 1, 1)     \
+  X(0xee, "INC", inc, Abs, 6, 0, Rmw, 1, 1)      \
+  X(0xef, "ISC", isc, Abs, 6, 0, Rmw, 0, 1)      \
+  X(0xf0, "BEQ", beq, Rel, 2, 0, None, 1, 1)     \
+  X(0xf1, "SBC", sbc, Izy, 5, 1, Read, 1, 1)     \
+  X(0xf2, "JAM", jam, Implied, 2, 0, None, 0, 0) \
+  X(0xf3, "ISC", isc, Izy, 8, 0, Rmw, 0, 1)      \
+  X(0xf4, "NOP", nop, Zpx, 4, 0, Read, 0, 1)     \
+  X(0xf5, "SBC", sbc, Zpx, 4, 0, Read, 1, 1)     \
+  X(0xf6, "INC", inc, Zpx, 6, 0, Rmw, 1, 1)      \
+  X(0xf7, "ISC", isc, Zpx, 6, 0, Rmw, 0, 1)      \
+  X(0xf8, "SED", sed, Implied, 2, 0, None, 1, 1) \
+  X(0xf9, "SBC", sbc, Aby, 4, 1, Read, 1, 1)     \
+  X(0xfa, "NOP", nop, Implied, 2, 0, None, 0, 1) \
+  X(0xfb, "ISC", isc, Aby, 7, 0, Rmw, 0, 1)      \
+  X(0xfc, "NOP", nop, Abx, 4, 1, Read, 0, 1)     \
+  X(0xfd, "SBC", sbc, Abx, 4, 1, Read, 1, 1)     \
+  X(0xfe, "INC", inc, Abx, 7, 0, Rmw, 1, 1)      \
+  X(0xff, "ISC", isc, Abx, 7, 0, Rmw, 0, 1)
+
+// The 65C02 opcode matrix in the same form, except that the last column marks
+// the rows that only the W65C02 and the Rockwell chips implement. On the
+// original 65C02 those opcodes are single byte NOPs like the other unused
+// ones. The documented opcodes of the NMOS chip keep their encoding.
+#define OPCODES_CMOS(X)                          \
+  X(0x00, "BRK", brk, Implied, 7, 0, None, 1, 0) \
+  X(0x01, "ORA", ora, Izx, 6, 0, Read, 1, 0)     \
+  X(0x02, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0x03, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x04, "TSB", tsb, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0x05, "ORA", ora, Zp, 3, 0, Read, 1, 0)      \
+  X(0x06, "ASL", asl, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0x07, "RMB0", rmb0, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x08, "PHP", php, Implied, 3, 0, None, 1, 0) \
+  X(0x09, "ORA", ora, Imm, 2, 0, Read, 1, 0)     \
+  X(0x0a, "ASL", asl, Implied, 2, 0, None, 1, 0) \
+  X(0x0b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x0c, "TSB", tsb, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0x0d, "ORA", ora, Abs, 4, 0, Read, 1, 0)     \
+  X(0x0e, "ASL", asl, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0x0f, "BBR0", bbr0, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x10, "BPL", bpl, Rel, 2, 0, None, 1, 0)     \
+  X(0x11, "ORA", ora, Izy, 5, 1, Read, 1, 0)     \
+  X(0x12, "ORA", ora, Izp, 5, 0, Read, 1, 0)     \
+  X(0x13, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x14, "TRB", trb, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0x15, "ORA", ora, Zpx, 4, 0, Read, 1, 0)     \
+  X(0x16, "ASL", asl, Zpx, 6, 0, Rmw, 1, 0)      \
+  X(0x17, "RMB1", rmb1, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x18, "CLC", clc, Implied, 2, 0, None, 1, 0) \
+  X(0x19, "ORA", ora, Aby, 4, 1, Read, 1, 0)     \
+  X(0x1a, "INC", inc, Implied, 2, 0, None, 1, 0) \
+  X(0x1b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x1c, "TRB", trb, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0x1d, "ORA", ora, Abx, 4, 1, Read, 1, 0)     \
+  X(0x1e, "ASL", asl, Abx, 6, 1, Rmw, 1, 0)      \
+  X(0x1f, "BBR1", bbr1, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x20, "JSR", jsr, Abs, 6, 0, None, 1, 0)     \
+  X(0x21, "AND", and, Izx, 6, 0, Read, 1, 0)     \
+  X(0x22, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0x23, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x24, "BIT", bit, Zp, 3, 0, Read, 1, 0)      \
+  X(0x25, "AND", and, Zp, 3, 0, Read, 1, 0)      \
+  X(0x26, "ROL", rol, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0x27, "RMB2", rmb2, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x28, "PLP", plp, Implied, 4, 0, None, 1, 0) \
+  X(0x29, "AND", and, Imm, 2, 0, Read, 1, 0)     \
+  X(0x2a, "ROL", rol, Implied, 2, 0, None, 1, 0) \
+  X(0x2b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x2c, "BIT", bit, Abs, 4, 0, Read, 1, 0)     \
+  X(0x2d, "AND", and, Abs, 4, 0, Read, 1, 0)     \
+  X(0x2e, "ROL", rol, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0x2f, "BBR2", bbr2, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x30, "BMI", bmi, Rel, 2, 0, None, 1, 0)     \
+  X(0x31, "AND", and, Izy, 5, 1, Read, 1, 0)     \
+  X(0x32, "AND", and, Izp, 5, 0, Read, 1, 0)     \
+  X(0x33, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x34, "BIT", bit, Zpx, 4, 0, Read, 1, 0)     \
+  X(0x35, "AND", and, Zpx, 4, 0, Read, 1, 0)     \
+  X(0x36, "ROL", rol, Zpx, 6, 0, Rmw, 1, 0)      \
+  X(0x37, "RMB3", rmb3, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x38, "SEC", sec, Implied, 2, 0, None, 1, 0) \
+  X(0x39, "AND", and, Aby, 4, 1, Read, 1, 0)     \
+  X(0x3a, "DEC", dec, Implied, 2, 0, None, 1, 0) \
+  X(0x3b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x3c, "BIT", bit, Abx, 4, 1, Read, 1, 0)     \
+  X(0x3d, "AND", and, Abx, 4, 1, Read, 1, 0)     \
+  X(0x3e, "ROL", rol, Abx, 6, 1, Rmw, 1, 0)      \
+  X(0x3f, "BBR3", bbr3, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x40, "RTI", rti, Implied, 6, 0, None, 1, 0) \
+  X(0x41, "EOR", eor, Izx, 6, 0, Read, 1, 0)     \
+  X(0x42, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0x43, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x44, "NOP", nop, Zp, 3, 0, Read, 0, 0)      \
+  X(0x45, "EOR", eor, Zp, 3, 0, Read, 1, 0)      \
+  X(0x46, "LSR", lsr, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0x47, "RMB4", rmb4, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x48, "PHA", pha, Implied, 3, 0, None, 1, 0) \
+  X(0x49, "EOR", eor, Imm, 2, 0, Read, 1, 0)     \
+  X(0x4a, "LSR", lsr, Implied, 2, 0, None, 1, 0) \
+  X(0x4b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x4c, "JMP", jmp, Abs, 3, 0, None, 1, 0)     \
+  X(0x4d, "EOR", eor, Abs, 4, 0, Read, 1, 0)     \
+  X(0x4e, "LSR", lsr, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0x4f, "BBR4", bbr4, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x50, "BVC", bvc, Rel, 2, 0, None, 1, 0)     \
+  X(0x51, "EOR", eor, Izy, 5, 1, Read, 1, 0)     \
+  X(0x52, "EOR", eor, Izp, 5, 0, Read, 1, 0)     \
+  X(0x53, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x54, "NOP", nop, Zpx, 4, 0, Read, 0, 0)     \
+  X(0x55, "EOR", eor, Zpx, 4, 0, Read, 1, 0)     \
+  X(0x56, "LSR", lsr, Zpx, 6, 0, Rmw, 1, 0)      \
+  X(0x57, "RMB5", rmb5, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x58, "CLI", cli, Implied, 2, 0, None, 1, 0) \
+  X(0x59, "EOR", eor, Aby, 4, 1, Read, 1, 0)     \
+  X(0x5a, "PHY", phy, Implied, 3, 0, None, 1, 0) \
+  X(0x5b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x5c, "NOP", nop, Abs, 8, 0, None, 0, 0)     \
+  X(0x5d, "EOR", eor, Abx, 4, 1, Read, 1, 0)     \
+  X(0x5e, "LSR", lsr, Abx, 6, 1, Rmw, 1, 0)      \
+  X(0x5f, "BBR5", bbr5, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x60, "RTS", rts, Implied, 6, 0, None, 1, 0) \
+  X(0x61, "ADC", adc, Izx, 6, 0, Read, 1, 0)     \
+  X(0x62, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0x63, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x64, "STZ", stz, Zp, 3, 0, Write, 1, 0)     \
+  X(0x65, "ADC", adc, Zp, 3, 0, Read, 1, 0)      \
+  X(0x66, "ROR", ror, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0x67, "RMB6", rmb6, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x68, "PLA", pla, Implied, 4, 0, None, 1, 0) \
+  X(0x69, "ADC", adc, Imm, 2, 0, Read, 1, 0)     \
+  X(0x6a, "ROR", ror, Implied, 2, 0, None, 1, 0) \
+  X(0x6b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x6c, "JMP", jmp, Ind, 6, 0, None, 1, 0)     \
+  X(0x6d, "ADC", adc, Abs, 4, 0, Read, 1, 0)     \
+  X(0x6e, "ROR", ror, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0x6f, "BBR6", bbr6, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x70, "BVS", bvs, Rel, 2, 0, None, 1, 0)     \
+  X(0x71, "ADC", adc, Izy, 5, 1, Read, 1, 0)     \
+  X(0x72, "ADC", adc, Izp, 5, 0, Read, 1, 0)     \
+  X(0x73, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x74, "STZ", stz, Zpx, 4, 0, Write, 1, 0)    \
+  X(0x75, "ADC", adc, Zpx, 4, 0, Read, 1, 0)     \
+  X(0x76, "ROR", ror, Zpx, 6, 0, Rmw, 1, 0)      \
+  X(0x77, "RMB7", rmb7, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x78, "SEI", sei, Implied, 2, 0, None, 1, 0) \
+  X(0x79, "ADC", adc, Aby, 4, 1, Read, 1, 0)     \
+  X(0x7a, "PLY", ply, Implied, 4, 0, None, 1, 0) \
+  X(0x7b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x7c, "JMP", jmp, Iax, 6, 0, None, 1, 0)     \
+  X(0x7d, "ADC", adc, Abx, 4, 1, Read, 1, 0)     \
+  X(0x7e, "ROR", ror, Abx, 6, 1, Rmw, 1, 0)      \
+  X(0x7f, "BBR7", bbr7, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x80, "BRA", bra, Rel, 2, 0, None, 1, 0)     \
+  X(0x81, "STA", sta, Izx, 6, 0, Write, 1, 0)    \
+  X(0x82, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0x83, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x84, "STY", sty, Zp, 3, 0, Write, 1, 0)     \
+  X(0x85, "STA", sta, Zp, 3, 0, Write, 1, 0)     \
+  X(0x86, "STX", stx, Zp, 3, 0, Write, 1, 0)     \
+  X(0x87, "SMB0", smb0, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x88, "DEY", dey, Implied, 2, 0, None, 1, 0) \
+  X(0x89, "BIT", bit_imm, Imm, 2, 0, Read, 1, 0) \
+  X(0x8a, "TXA", txa, Implied, 2, 0, None, 1, 0) \
+  X(0x8b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x8c, "STY", sty, Abs, 4, 0, Write, 1, 0)    \
+  X(0x8d, "STA", sta, Abs, 4, 0, Write, 1, 0)    \
+  X(0x8e, "STX", stx, Abs, 4, 0, Write, 1, 0)    \
+  X(0x8f, "BBS0", bbs0, Zpr, 5, 0, Read, 1, 1)   \
+  X(0x90, "BCC", bcc, Rel, 2, 0, None, 1, 0)     \
+  X(0x91, "STA", sta, Izy, 6, 0, Write, 1, 0)    \
+  X(0x92, "STA", sta, Izp, 5, 0, Write, 1, 0)    \
+  X(0x93, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x94, "STY", sty, Zpx, 4, 0, Write, 1, 0)    \
+  X(0x95, "STA", sta, Zpx, 4, 0, Write, 1, 0)    \
+  X(0x96, "STX", stx, Zpy, 4, 0, Write, 1, 0)    \
+  X(0x97, "SMB1", smb1, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0x98, "TYA", tya, Implied, 2, 0, None, 1, 0) \
+  X(0x99, "STA", sta, Aby, 5, 0, Write, 1, 0)    \
+  X(0x9a, "TXS", txs, Implied, 2, 0, None, 1, 0) \
+  X(0x9b, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0x9c, "STZ", stz, Abs, 4, 0, Write, 1, 0)    \
+  X(0x9d, "STA", sta, Abx, 5, 0, Write, 1, 0)    \
+  X(0x9e, "STZ", stz, Abx, 5, 0, Write, 1, 0)    \
+  X(0x9f, "BBS1", bbs1, Zpr, 5, 0, Read, 1, 1)   \
+  X(0xa0, "LDY", ldy, Imm, 2, 0, Read, 1, 0)     \
+  X(0xa1, "LDA", lda, Izx, 6, 0, Read, 1, 0)     \
+  X(0xa2, "LDX", ldx, Imm, 2, 0, Read, 1, 0)     \
+  X(0xa3, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xa4, "LDY", ldy, Zp, 3, 0, Read, 1, 0)      \
+  X(0xa5, "LDA", lda, Zp, 3, 0, Read, 1, 0)      \
+  X(0xa6, "LDX", ldx, Zp, 3, 0, Read, 1, 0)      \
+  X(0xa7, "SMB2", smb2, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0xa8, "TAY", tay, Implied, 2, 0, None, 1, 0) \
+  X(0xa9, "LDA", lda, Imm, 2, 0, Read, 1, 0)     \
+  X(0xaa, "TAX", tax, Implied, 2, 0, None, 1, 0) \
+  X(0xab, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xac, "LDY", ldy, Abs, 4, 0, Read, 1, 0)     \
+  X(0xad, "LDA", lda, Abs, 4, 0, Read, 1, 0)     \
+  X(0xae, "LDX", ldx, Abs, 4, 0, Read, 1, 0)     \
+  X(0xaf, "BBS2", bbs2, Zpr, 5, 0, Read, 1, 1)   \
+  X(0xb0, "BCS", bcs, Rel, 2, 0, None, 1, 0)     \
+  X(0xb1, "LDA", lda, Izy, 5, 1, Read, 1, 0)     \
+  X(0xb2, "LDA", lda, Izp, 5, 0, Read, 1, 0)     \
+  X(0xb3, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xb4, "LDY", ldy, Zpx, 4, 0, Read, 1, 0)     \
+  X(0xb5, "LDA", lda, Zpx, 4, 0, Read, 1, 0)     \
+  X(0xb6, "LDX", ldx, Zpy, 4, 0, Read, 1, 0)     \
+  X(0xb7, "SMB3", smb3, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0xb8, "CLV", clv, Implied, 2, 0, None, 1, 0) \
+  X(0xb9, "LDA", lda, Aby, 4, 1, Read, 1, 0)     \
+  X(0xba, "TSX", tsx, Implied, 2, 0, None, 1, 0) \
+  X(0xbb, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xbc, "LDY", ldy, Abx, 4, 1, Read, 1, 0)     \
+  X(0xbd, "LDA", lda, Abx, 4, 1, Read, 1, 0)     \
+  X(0xbe, "LDX", ldx, Aby, 4, 1, Read, 1, 0)     \
+  X(0xbf, "BBS3", bbs3, Zpr, 5, 0, Read, 1, 1)   \
+  X(0xc0, "CPY", cpy, Imm, 2, 0, Read, 1, 0)     \
+  X(0xc1, "CMP", cmp, Izx, 6, 0, Read, 1, 0)     \
+  X(0xc2, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0xc3, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xc4, "CPY", cpy, Zp, 3, 0, Read, 1, 0)      \
+  X(0xc5, "CMP", cmp, Zp, 3, 0, Read, 1, 0)      \
+  X(0xc6, "DEC", dec, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0xc7, "SMB4", smb4, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0xc8, "INY", iny, Implied, 2, 0, None, 1, 0) \
+  X(0xc9, "CMP", cmp, Imm, 2, 0, Read, 1, 0)     \
+  X(0xca, "DEX", dex, Implied, 2, 0, None, 1, 0) \
+  X(0xcb, "WAI", wai, Implied, 3, 0, None, 1, 1) \
+  X(0xcc, "CPY", cpy, Abs, 4, 0, Read, 1, 0)     \
+  X(0xcd, "CMP", cmp, Abs, 4, 0, Read, 1, 0)     \
+  X(0xce, "DEC", dec, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0xcf, "BBS4", bbs4, Zpr, 5, 0, Read, 1, 1)   \
+  X(0xd0, "BNE", bne, Rel, 2, 0, None, 1, 0)     \
+  X(0xd1, "CMP", cmp, Izy, 5, 1, Read, 1, 0)     \
+  X(0xd2, "CMP", cmp, Izp, 5, 0, Read, 1, 0)     \
+  X(0xd3, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xd4, "NOP", nop, Zpx, 4, 0, Read, 0, 0)     \
+  X(0xd5, "CMP", cmp, Zpx, 4, 0, Read, 1, 0)     \
+  X(0xd6, "DEC", dec, Zpx, 6, 0, Rmw, 1, 0)      \
+  X(0xd7, "SMB5", smb5, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0xd8, "CLD", cld, Implied, 2, 0, None, 1, 0) \
+  X(0xd9, "CMP", cmp, Aby, 4, 1, Read, 1, 0)     \
+  X(0xda, "PHX", phx, Implied, 3, 0, None, 1, 0) \
+  X(0xdb, "STP", jam, Implied, 3, 0, None, 1, 1) \
+  X(0xdc, "NOP", nop, Abs, 4, 0, Read, 0, 0)     \
+  X(0xdd, "CMP", cmp, Abx, 4, 1, Read, 1, 0)     \
+  X(0xde, "DEC", dec, Abx, 7, 0, Rmw, 1, 0)      \
+  X(0xdf, "BBS5", bbs5, Zpr, 5, 0, Read, 1, 1)   \
+  X(0xe0, "CPX", cpx, Imm, 2, 0, Read, 1, 0)     \
+  X(0xe1, "SBC", sbc, Izx, 6, 0, Read, 1, 0)     \
+  X(0xe2, "NOP", nop, Imm, 2, 0, Read, 0, 0)     \
+  X(0xe3, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xe4, "CPX", cpx, Zp, 3, 0, Read, 1, 0)      \
+  X(0xe5, "SBC", sbc, Zp, 3, 0, Read, 1, 0)      \
+  X(0xe6, "INC", inc, Zp, 5, 0, Rmw, 1, 0)       \
+  X(0xe7, "SMB6", smb6, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0xe8, "INX", inx, Implied, 2, 0, None, 1, 0) \
+  X(0xe9, "SBC", sbc, Imm, 2, 0, Read, 1, 0)     \
+  X(0xea, "NOP", nop, Implied, 2, 0, None, 1, 0) \
+  X(0xeb, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xec, "CPX", cpx, Abs, 4, 0, Read, 1, 0)     \
+  X(0xed, "SBC", sbc, Abs, 4, 0, Read, 1, 0)     \
+  X(0xee, "INC", inc, Abs, 6, 0, Rmw, 1, 0)      \
+  X(0xef, "BBS6", bbs6, Zpr, 5, 0, Read, 1, 1)   \
+  X(0xf0, "BEQ", beq, Rel, 2, 0, None, 1, 0)     \
+  X(0xf1, "SBC", sbc, Izy, 5, 1, Read, 1, 0)     \
+  X(0xf2, "SBC", sbc, Izp, 5, 0, Read, 1, 0)     \
+  X(0xf3, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xf4, "NOP", nop, Zpx, 4, 0, Read, 0, 0)     \
+  X(0xf5, "SBC", sbc, Zpx, 4, 0, Read, 1, 0)     \
+  X(0xf6, "INC", inc, Zpx, 6, 0, Rmw, 1, 0)      \
+  X(0xf7, "SMB7", smb7, Zp, 5, 0, Rmw, 1, 1)     \
+  X(0xf8, "SED", sed, Implied, 2, 0, None, 1, 0) \
+  X(0xf9, "SBC", sbc, Aby, 4, 1, Read, 1, 0)     \
+  X(0xfa, "PLX", plx, Implied, 4, 0, None, 1, 0) \
+  X(0xfb, "NOP", nop, Implied, 1, 0, None, 0, 0) \
+  X(0xfc, "NOP", nop, Abs, 4, 0, Read, 0, 0)     \
+  X(0xfd, "SBC", sbc, Abx, 4, 1, Read, 1, 0)     \
+  X(0xfe, "INC", inc, Abx, 7, 0, Rmw, 1, 0)      \
+  X(0xff, "BBS7", bbs7, Zpr, 5, 0, Read, 1, 1)
@@ -0,0 +1,81 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "cpu.h"
+
+struct Profile* profile_new(bool count_cycles) {
+  struct Profile* profile = calloc(1, sizeof(struct Profile));
+  if (!profile) {
+    return NULL;
+  }
+
+  profile->count_cycles = count_cycles;
+  return profile;
+}
+
+void profile_free(struct Profile* profile) { free(profile); }
+
+// Returns kProfileMaxCalls when the table is full.
+static u32 find_call(struct Profile* profile, u16 site, u16 target) {
+  u32 key = (u32)site << 16 | target;
+  u32 i = (key * 0x9e3779b1u) >> 20;
+  for (u32 n = 0; n < kProfileMaxCalls; ++n) {
+    struct ProfileCall* call = profile->calls + i;
+    if (call->calls == 0) {
+      call->site = site;
+      call->target = target;
+      return i;
+    }
+
+    if (call->site == site && call->target == target) {
+      return i;
+    }
+
+    i = (i + 1) % kProfileMaxCalls;
+  }
+
+  return kProfileMaxCalls;
+}
+
+// Pops the frames whose return address is no longer on the stack, s is the
+// stack pointer before the current instruction pushed anything.
+static void unwind(struct Profile* profile, u16 s, u64 cycles) {
+  while (profile->depth > 0 && profile->frames[profile->depth - 1].s < s) {
+    const struct ProfileFrame* frame = profile->frames + --profile->depth;
+    struct ProfileCall* call = profile->calls + frame->call;
+    if (frame->call < kProfileMaxCalls && --call->active == 0) {
+      call->cycles += cycles - frame->cycles;
+    }
+  }
+}
+
+void profile_call(struct Profile* profile, const struct Cpu* cpu, u16 site,
+                  u64 start_cycles) {
+  unwind(profile, cpu->s + 2, start_cycles);
+
+  u32 call = find_call(profile, site, cpu->pc);
+  if (call < kProfileMaxCalls) {
+    ++profile->calls[call].calls;
+  } else {
+    ++profile->dropped_calls;
+  }
+
+  // Frames are ordered by the stack pointer, only a wrapped stack runs out.
+  if (profile->depth == kProfileMaxDepth) {
+    return;
+  }
+
+  if (call < kProfileMaxCalls) {
+    ++profile->calls[call].active;
+  }
+
+  profile->frames[profile->depth++] = (struct ProfileFrame){
+      .call = call,
+      .s = cpu->s,
+      .cycles = start_cycles,
+  };
+}
+
+void profile_return(struct Profile* profile, const struct Cpu* cpu) {
+  unwind(profile, cpu->s, cpu->cycles);
+}
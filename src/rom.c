@@ -0,0 +1,351 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "e6502.h"
+
+// Images with neither header below are plain programs loaded at $0200 with
+// the reset vector pointing there.
+//
+// The e6502 ROM header, words are little endian:
+//    0  "e6502rom"
+//    8  version
+//    9  number of segments
+//   10  NMI, reset and IRQ vectors, zero leaves a vector to the segments
+//   16  segments of 12 bytes: load address, flags, then the file offset and
+//       size as 32 bit words
+//
+// o65 executables, as written by ld65, load their text and data segments at
+// the addresses in the o65 header and zero bss and zero page. The vectors are
+// taken from exported "nmi", "reset" and "irq" symbols, reset defaults to the
+// start of text.
+
+#define kRomVersion 1
+#define kRomHeaderSize 16
+#define kRomSegmentSize 12
+#define kRomMaxSegments 16
+
+#define kRomFlagWritable 0x0001
+
+#define kPlainLoadAddr 0x0200
+
+#define kO65HeaderSize 26
+#define kO65Mode65816 0x8000
+#define kO65ModePagewise 0x4000
+#define kO65ModeLong 0x2000
+#define kO65ModeObject 0x1000
+#define kO65ModeChain 0x0400
+
+static const u8 kRomMagic[8] = {'e', '6', '5', '0', '2', 'r', 'o', 'm'};
+static const u8 kO65Magic[6] = {0x01, 0x00, 'o', '6', '5', 0x00};
+
+enum Vector {
+  kVectorNmi,
+  kVectorReset,
+  kVectorIrq,
+  kNumVectors,
+};
+
+static const char* const vector_names[kNumVectors] = {"nmi", "reset", "irq"};
+
+// Data is NULL for segments that are zero filled.
+struct RomSegment {
+  const u8* data;
+  u32 addr;
+  u32 size;
+  bool writable;
+};
+
+struct Rom {
+  u8* map;
+  size_t map_size;
+
+  struct RomSegment segments[kRomMaxSegments];
+  size_t num_segments;
+
+  u16 vectors[kNumVectors];
+  bool has_vector[kNumVectors];
+};
+
+static u16 get16(const u8* p) { return p[0] | p[1] << 8; }
+
+static u32 get32(const u8* p) { return get16(p) | (u32)get16(p + 2) << 16; }
+
+static bool add_segment(struct Rom* rom, const u8* data, u32 addr, u32 size,
+                        bool writable) {
+  if (rom->num_segments == kRomMaxSegments || addr + size > 0x10000) {
+    return false;
+  }
+
+  if (size > 0) {
+    rom->segments[rom->num_segments++] = (struct RomSegment){
+        .data = data,
+        .addr = addr,
+        .size = size,
+        .writable = writable,
+    };
+  }
+
+  return true;
+}
+
+static bool parse_rom(struct Rom* rom) {
+  const u8* map = rom->map;
+  if (rom->map_size < kRomHeaderSize || map[8] != kRomVersion) {
+    return false;
+  }
+
+  size_t num_segments = map[9];
+  if (rom->map_size < kRomHeaderSize + num_segments * kRomSegmentSize) {
+    return false;
+  }
+
+  for (int i = 0; i < kNumVectors; ++i) {
+    rom->vectors[i] = get16(map + 10 + 2 * i);
+    rom->has_vector[i] = rom->vectors[i] != 0;
+  }
+
+  for (size_t i = 0; i < num_segments; ++i) {
+    const u8* entry = map + kRomHeaderSize + i * kRomSegmentSize;
+    u32 offset = get32(entry + 4);
+    u32 size = get32(entry + 8);
+    if (offset > rom->map_size || size > rom->map_size - offset ||
+        !add_segment(rom, map + offset, get16(entry), size,
+                     get16(entry + 2) & kRomFlagWritable)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Bounds checked reads of an o65 file.
+struct Cursor {
+  const u8* p;
+  const u8* end;
+  bool ok;
+};
+
+static const u8* skip(struct Cursor* c, size_t n) {
+  const u8* p = c->p;
+  if ((size_t)(c->end - c->p) < n) {
+    c->ok = false;
+    c->p = c->end;
+    return NULL;
+  }
+
+  c->p += n;
+  return p;
+}
+
+static u8 next8(struct Cursor* c) {
+  const u8* p = skip(c, 1);
+  return p ? *p : 0;
+}
+
+static u16 next16(struct Cursor* c) {
+  const u8* p = skip(c, 2);
+  return p ? get16(p) : 0;
+}
+
+// Relocations only matter when loading elsewhere than at the segment bases,
+// they are skipped to get to the exports.
+static void skip_relocations(struct Cursor* c, u16 mode) {
+  for (;;) {
+    u8 offset = next8(c);
+    if (offset == 0 || !c->ok) {
+      return;
+    }
+
+    if (offset == 0xff) {
+      continue;
+    }
+
+    u8 type = next8(c);
+    if ((type & 0x07) == 0) {
+      next16(c);  // Index of an undefined reference.
+    }
+
+    if ((type & 0xe0) == 0x40 && !(mode & kO65ModePagewise)) {
+      next8(c);  // Low byte of a HIGH relocation.
+    }
+  }
+}
+
+static bool parse_o65(struct Rom* rom) {
+  struct Cursor c = {
+      .p = rom->map,
+      .end = rom->map + rom->map_size,
+      .ok = true,
+  };
+
+  const u8* header = skip(&c, kO65HeaderSize);
+  if (!header) {
+    return false;
+  }
+
+  u16 mode = get16(header + 6);
+  if (mode & (kO65Mode65816 | kO65ModeLong | kO65ModeObject |
+              kO65ModeChain)) {
+    return false;
+  }
+
+  u16 tbase = get16(header + 8);
+  u16 tlen = get16(header + 10);
+  u16 dbase = get16(header + 12);
+  u16 dlen = get16(header + 14);
+  u16 bbase = get16(header + 16);
+  u16 blen = get16(header + 18);
+  u16 zbase = get16(header + 20);
+  u16 zlen = get16(header + 22);
+
+  for (u8 len = next8(&c); len != 0 && c.ok; len = next8(&c)) {
+    skip(&c, len - 1);
+  }
+
+  const u8* text = skip(&c, tlen);
+  const u8* data = skip(&c, dlen);
+  for (u16 n = next16(&c); n > 0 && c.ok; --n) {
+    while (next8(&c) != 0 && c.ok) {
+    }
+  }
+
+  skip_relocations(&c, mode);
+  skip_relocations(&c, mode);
+  if (!c.ok || !add_segment(rom, text, tbase, tlen, false) ||
+      !add_segment(rom, data, dbase, dlen, true) ||
+      !add_segment(rom, NULL, bbase, blen, true) ||
+      !add_segment(rom, NULL, zbase, zlen, true)) {
+    return false;
+  }
+
+  for (u16 n = next16(&c); n > 0 && c.ok; --n) {
+    const char* name = (const char*)c.p;
+    while (next8(&c) != 0 && c.ok) {
+    }
+
+    next8(&c);  // Segment.
+    u16 value = next16(&c);
+    for (int i = 0; i < kNumVectors && c.ok; ++i) {
+      if (strcasecmp(name, vector_names[i]) == 0) {
+        rom->vectors[i] = value;
+        rom->has_vector[i] = true;
+      }
+    }
+  }
+
+  // Unless the text holds the vectors itself.
+  if (!rom->has_vector[kVectorReset] && tbase + tlen <= 0xff00) {
+    rom->vectors[kVectorReset] = tbase;
+    rom->has_vector[kVectorReset] = true;
+  }
+
+  return c.ok;
+}
+
+// Programs long enough to reach the reset vector bring their own.
+static bool parse_plain(struct Rom* rom) {
+  rom->vectors[kVectorReset] = kPlainLoadAddr;
+  rom->has_vector[kVectorReset] = kPlainLoadAddr + rom->map_size <= 0xfffc;
+  return rom->map_size <= 0x10000 - kPlainLoadAddr &&
+         add_segment(rom, rom->map, kPlainLoadAddr, rom->map_size, true);
+}
+
+// Vectors from the metadata are written to RAM, a read-only segment over them
+// would hide them.
+static bool vectors_visible(const struct Rom* rom) {
+  bool any = false;
+  for (int i = 0; i < kNumVectors; ++i) {
+    any |= rom->has_vector[i];
+  }
+
+  for (size_t i = 0; any && i < rom->num_segments; ++i) {
+    const struct RomSegment* segment = rom->segments + i;
+    if (!segment->writable && segment->addr + segment->size > 0xff00) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+struct Rom* rom_new(int fd) {
+  struct stat st;
+  if (fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    return NULL;
+  }
+
+  struct Rom* rom = calloc(1, sizeof(struct Rom));
+  if (!rom) {
+    return NULL;
+  }
+
+  rom->map_size = st.st_size;
+  rom->map = mmap(NULL, rom->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (rom->map == MAP_FAILED) {
+    free(rom);
+    return NULL;
+  }
+
+  bool ok;
+  if (rom->map_size >= sizeof(kRomMagic) &&
+      memcmp(rom->map, kRomMagic, sizeof(kRomMagic)) == 0) {
+    ok = parse_rom(rom);
+  } else if (rom->map_size >= sizeof(kO65Magic) &&
+             memcmp(rom->map, kO65Magic, sizeof(kO65Magic)) == 0) {
+    ok = parse_o65(rom);
+  } else {
+    ok = parse_plain(rom);
+  }
+
+  if (!ok || !vectors_visible(rom)) {
+    rom_free(rom);
+    return NULL;
+  }
+
+  return rom;
+}
+
+void rom_free(struct Rom* rom) {
+  if (rom) {
+    munmap(rom->map, rom->map_size);
+    free(rom);
+  }
+}
+
+void rom_load(const struct Rom* rom, struct Bus* bus, u8* ram) {
+  for (size_t i = 0; i < rom->num_segments; ++i) {
+    const struct RomSegment* segment = rom->segments + i;
+    u32 end = segment->addr + segment->size;
+    for (u32 addr = segment->addr; addr < end;) {
+      u32 page_end = (addr & 0xff00) + 0x0100;
+      u32 n = (page_end < end ? page_end : end) - addr;
+      u8 page = addr >> 8;
+      const u8* src = segment->data;
+      if (src) {
+        src += addr - segment->addr;
+      }
+
+      if (src && !segment->writable && n == 0x0100 &&
+          bus->read_pages[page] == ram + addr) {
+        bus_map_rom(bus, page, 1, src);
+      } else if (src) {
+        memcpy(ram + addr, src, n);
+      } else {
+        memset(ram + addr, 0, n);
+      }
+
+      addr += n;
+    }
+  }
+
+  for (int i = 0; i < kNumVectors; ++i) {
+    if (rom->has_vector[i]) {
+      ram[0xfffa + 2 * i] = rom->vectors[i] & 0x00ff;
+      ram[0xfffb + 2 * i] = rom->vectors[i] >> 8;
+    }
+  }
+}
@@ -0,0 +1,181 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "e6502.h"
+
+#define kTxSize 4096
+#define kRxSize 256
+
+// The FIFOs are rings indexed by free running counters, the sizes are powers
+// of two so that the counters may wrap.
+struct Serial {
+  int in_fd;
+  int out_fd;
+  int in_flags;
+  bool in_eof;
+
+  u8 tx[kTxSize];
+  u32 tx_head;
+  u32 tx_tail;
+
+  u8 rx[kRxSize];
+  u32 rx_head;
+  u32 rx_tail;
+};
+
+struct Serial* serial_new(int in_fd, int out_fd) {
+  struct Serial* serial = calloc(1, sizeof(struct Serial));
+  if (!serial) {
+    return NULL;
+  }
+
+  serial->in_fd = in_fd;
+  serial->out_fd = out_fd;
+  serial->in_eof = in_fd < 0;
+  if (in_fd >= 0) {
+    serial->in_flags = fcntl(in_fd, F_GETFL);
+    if (serial->in_flags < 0 ||
+        fcntl(in_fd, F_SETFL, serial->in_flags | O_NONBLOCK) < 0) {
+      free(serial);
+      return NULL;
+    }
+  }
+
+  return serial;
+}
+
+void serial_free(struct Serial* serial) {
+  if (!serial) {
+    return;
+  }
+
+  serial_flush(serial);
+  if (serial->in_fd >= 0) {
+    fcntl(serial->in_fd, F_SETFL, serial->in_flags);
+  }
+
+  free(serial);
+}
+
+static u32 tx_depth(const struct Serial* serial) {
+  return serial->tx_tail - serial->tx_head;
+}
+
+static u32 rx_depth(const struct Serial* serial) {
+  return serial->rx_tail - serial->rx_head;
+}
+
+static u8 saturate(u32 depth) { return depth > 0xff ? 0xff : depth; }
+
+u8 serial_read(struct Serial* serial, u8 reg) {
+  switch (reg) {
+    case kSerialStatus:
+      return tx_depth(serial) == kTxSize;
+    case kSerialData:
+      if (rx_depth(serial) == 0) {
+        return 0;
+      }
+
+      return serial->rx[serial->rx_head++ & (kRxSize - 1)];
+    case kSerialRxDepth:
+      return saturate(rx_depth(serial));
+    case kSerialTxDepth:
+      return saturate(tx_depth(serial));
+    default:
+      return 0;
+  }
+}
+
+void serial_write(struct Serial* serial, u8 reg, u8 data) {
+  if (reg != kSerialData) {
+    return;
+  }
+
+  if (tx_depth(serial) == kTxSize && !serial_flush(serial)) {
+    return;
+  }
+
+  serial->tx[serial->tx_tail++ & (kTxSize - 1)] = data;
+}
+
+bool serial_flush(struct Serial* serial) {
+  if (serial->out_fd < 0) {
+    serial->tx_head = serial->tx_tail;
+    return true;
+  }
+
+  while (tx_depth(serial) > 0) {
+    // The pending bytes wrap around the end of the ring at most once.
+    u32 head = serial->tx_head & (kTxSize - 1);
+    u32 depth = tx_depth(serial);
+    u32 first = kTxSize - head < depth ? kTxSize - head : depth;
+    struct iovec iov[2] = {
+        {.iov_base = serial->tx + head, .iov_len = first},
+        {.iov_base = serial->tx, .iov_len = depth - first},
+    };
+
+    ssize_t n = writev(serial->out_fd, iov, depth > first ? 2 : 1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    serial->tx_head += n;
+  }
+
+  return true;
+}
+
+void serial_poll(struct Serial* serial) {
+  while (!serial->in_eof && rx_depth(serial) < kRxSize) {
+    u32 tail = serial->rx_tail & (kRxSize - 1);
+    u32 room = kRxSize - rx_depth(serial);
+    u32 first = kRxSize - tail < room ? kRxSize - tail : room;
+    struct iovec iov[2] = {
+        {.iov_base = serial->rx + tail, .iov_len = first},
+        {.iov_base = serial->rx, .iov_len = room - first},
+    };
+
+    ssize_t n = readv(serial->in_fd, iov, room > first ? 2 : 1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n == 0) {
+      serial->in_eof = true;
+    }
+
+    if (n <= 0) {
+      return;
+    }
+
+    serial->rx_tail += n;
+  }
+}
+
+bool serial_wait(struct Serial* serial) {
+  if (rx_depth(serial) > 0) {
+    return true;
+  }
+
+  if (serial->in_eof) {
+    return false;
+  }
+
+  struct pollfd fds = {.fd = serial->in_fd, .events = POLLIN};
+  while (poll(&fds, 1, -1) < 0) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
+
+  return true;
+}
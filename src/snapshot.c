@@ -0,0 +1,222 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+struct Page {
+  atomic_uint refs;
+  u8 data[256];
+};
+
+// Shared by every memory until written, never freed.
+static struct Page zero_page;
+
+struct Memory {
+  struct Page* pages[256];
+
+  struct Bus* bus;
+  bool mapped[256];
+};
+
+struct Snapshot {
+  u8 a;
+  u8 x;
+  u8 y;
+  u8 s;
+  u8 p;
+  u16 pc;
+  u8 interrupts;
+  bool waiting;
+  u64 cycles;
+
+  struct Page* pages[256];
+};
+
+static struct Page* page_ref(struct Page* page) {
+  if (page != &zero_page) {
+    atomic_fetch_add_explicit(&page->refs, 1, memory_order_relaxed);
+  }
+
+  return page;
+}
+
+static void page_unref(struct Page* page) {
+  if (page != &zero_page &&
+      atomic_fetch_sub_explicit(&page->refs, 1, memory_order_acq_rel) == 1) {
+    free(page);
+  }
+}
+
+static bool page_shared(struct Page* page) {
+  return page == &zero_page ||
+         atomic_load_explicit(&page->refs, memory_order_acquire) > 1;
+}
+
+static void map_page(struct Memory* mem, u8 index) {
+  if (!mem->mapped[index]) {
+    return;
+  }
+
+  struct Page* page = mem->pages[index];
+  if (page_shared(page)) {
+    bus_map_rom(mem->bus, index, 1, page->data);
+  } else {
+    bus_map_ram(mem->bus, index, 1, page->data);
+  }
+}
+
+struct Memory* memory_new(void) {
+  struct Memory* mem = calloc(1, sizeof(struct Memory));
+  if (!mem) {
+    return NULL;
+  }
+
+  for (int i = 0; i < 256; ++i) {
+    mem->pages[i] = &zero_page;
+  }
+
+  return mem;
+}
+
+void memory_free(struct Memory* mem) {
+  if (!mem) {
+    return;
+  }
+
+  for (int i = 0; i < 256; ++i) {
+    page_unref(mem->pages[i]);
+  }
+
+  free(mem);
+}
+
+void memory_map(struct Memory* mem, struct Bus* bus, u8 first_page,
+                u16 num_pages) {
+  mem->bus = bus;
+  for (u16 i = first_page; i < 256 && i - first_page < num_pages; ++i) {
+    mem->mapped[i] = true;
+    map_page(mem, i);
+  }
+}
+
+u8 memory_read(const struct Memory* mem, u16 addr) {
+  return mem->pages[addr >> 8]->data[addr & 0x00ff];
+}
+
+// Gives mem its own copy of the page unless it already has one.
+static struct Page* own_page(struct Memory* mem, u8 index) {
+  struct Page* page = mem->pages[index];
+  if (!page_shared(page)) {
+    return page;
+  }
+
+  struct Page* copy = malloc(sizeof(struct Page));
+  if (!copy) {
+    return NULL;
+  }
+
+  atomic_init(&copy->refs, 1);
+  memcpy(copy->data, page->data, sizeof(copy->data));
+  mem->pages[index] = copy;
+  page_unref(page);
+
+  map_page(mem, index);
+  return copy;
+}
+
+bool memory_write(struct Memory* mem, u16 addr, u8 data) {
+  struct Page* page = own_page(mem, addr >> 8);
+  if (!page) {
+    return false;
+  }
+
+  page->data[addr & 0x00ff] = data;
+  return true;
+}
+
+bool memory_load(struct Memory* mem, u16 addr, const u8* data, size_t size) {
+  if (size > 0x10000 - (size_t)addr) {
+    return false;
+  }
+
+  while (size > 0) {
+    struct Page* page = own_page(mem, addr >> 8);
+    if (!page) {
+      return false;
+    }
+
+    size_t offset = addr & 0x00ff;
+    size_t n = 256 - offset < size ? 256 - offset : size;
+    memcpy(page->data + offset, data, n);
+
+    addr += n;
+    data += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+struct Snapshot* snapshot_take(const struct Cpu* cpu, struct Memory* mem) {
+  struct Snapshot* snapshot = malloc(sizeof(struct Snapshot));
+  if (!snapshot) {
+    return NULL;
+  }
+
+  snapshot->a = cpu->a;
+  snapshot->x = cpu->x;
+  snapshot->y = cpu->y;
+  snapshot->s = cpu->s;
+  snapshot->p = cpu_get_p(cpu);
+  snapshot->pc = cpu->pc;
+  snapshot->interrupts = cpu->interrupts;
+  snapshot->waiting = cpu->waiting;
+  snapshot->cycles = cpu->cycles;
+
+  // Every page is shared now, the next write to one copies it.
+  for (int i = 0; i < 256; ++i) {
+    snapshot->pages[i] = page_ref(mem->pages[i]);
+    map_page(mem, i);
+  }
+
+  return snapshot;
+}
+
+void snapshot_free(struct Snapshot* snapshot) {
+  if (!snapshot) {
+    return;
+  }
+
+  for (int i = 0; i < 256; ++i) {
+    page_unref(snapshot->pages[i]);
+  }
+
+  free(snapshot);
+}
+
+void snapshot_restore(const struct Snapshot* snapshot, struct Cpu* cpu,
+                      struct Memory* mem) {
+  for (int i = 0; i < 256; ++i) {
+    struct Page* page = page_ref(snapshot->pages[i]);
+    page_unref(mem->pages[i]);
+    mem->pages[i] = page;
+    map_page(mem, i);
+  }
+
+  cpu->a = snapshot->a;
+  cpu->x = snapshot->x;
+  cpu->y = snapshot->y;
+  cpu->s = snapshot->s;
+  unpack_flags(cpu, snapshot->p);
+  cpu->pc = snapshot->pc;
+  cpu->interrupts = snapshot->interrupts;
+  cpu->waiting = snapshot->waiting;
+  cpu->cycles = snapshot->cycles;
+  cpu->stop_requested = false;
+  cpu->jammed = false;
+
+  // Freed pages may come back at the same address with other contents.
+  cpu_flush_blocks(cpu);
+}
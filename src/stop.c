@@ -0,0 +1,292 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+
+static bool addr_set_add(struct AddrSet* set, u16 addr) {
+  u32* bits = set->pages[addr >> 8];
+  if (!bits) {
+    bits = calloc(8, sizeof(u32));
+    if (!bits) {
+      return false;
+    }
+
+    set->pages[addr >> 8] = bits;
+    ++set->num_pages;
+  }
+
+  bits[(addr & 0x00ff) >> 5] |= 1u << (addr & 31);
+  return true;
+}
+
+// Drops the bitmap of a page once its last bit is cleared, so that the page
+// costs nothing again.
+static void addr_set_remove(struct AddrSet* set, u16 addr) {
+  u32* bits = set->pages[addr >> 8];
+  if (!bits) {
+    return;
+  }
+
+  bits[(addr & 0x00ff) >> 5] &= ~(1u << (addr & 31));
+  for (int i = 0; i < 8; ++i) {
+    if (bits[i]) {
+      return;
+    }
+  }
+
+  free(bits);
+  set->pages[addr >> 8] = NULL;
+  --set->num_pages;
+}
+
+static void addr_set_free(struct AddrSet* set) {
+  for (int page = 0; page < 256; ++page) {
+    free(set->pages[page]);
+  }
+}
+
+static struct StopPoints* stop_points(struct Cpu* cpu) {
+  if (!cpu->stops) {
+    cpu->stops = calloc(1, sizeof(struct StopPoints));
+  }
+
+  return cpu->stops;
+}
+
+void stop_points_free(struct StopPoints* stops) {
+  if (!stops) {
+    return;
+  }
+
+  addr_set_free(&stops->exec);
+  addr_set_free(&stops->breakpoints);
+  addr_set_free(&stops->watch_read);
+  addr_set_free(&stops->watch_write);
+  free(stops->traps);
+  free(stops);
+}
+
+static struct HostTrap* find_host_trap(const struct StopPoints* stops,
+                                       u16 addr) {
+  for (size_t i = 0; i < stops->num_traps; ++i) {
+    if (stops->traps[i].addr == addr) {
+      return stops->traps + i;
+    }
+  }
+
+  return NULL;
+}
+
+bool cpu_set_breakpoint(struct Cpu* cpu, u16 addr) {
+  struct StopPoints* stops = stop_points(cpu);
+  if (!stops || !addr_set_add(&stops->breakpoints, addr)) {
+    return false;
+  }
+
+  if (!addr_set_add(&stops->exec, addr)) {
+    addr_set_remove(&stops->breakpoints, addr);
+    return false;
+  }
+
+  return true;
+}
+
+void cpu_clear_breakpoint(struct Cpu* cpu, u16 addr) {
+  struct StopPoints* stops = cpu->stops;
+  if (!stops) {
+    return;
+  }
+
+  addr_set_remove(&stops->breakpoints, addr);
+  if (!find_host_trap(stops, addr)) {
+    addr_set_remove(&stops->exec, addr);
+  }
+}
+
+bool cpu_set_watchpoint(struct Cpu* cpu, u16 addr, u8 access) {
+  struct StopPoints* stops = stop_points(cpu);
+  if (!stops) {
+    return false;
+  }
+
+  if ((access & kAccessTypeRead) && !addr_set_add(&stops->watch_read, addr)) {
+    return false;
+  }
+
+  if ((access & kAccessTypeWrite) &&
+      !addr_set_add(&stops->watch_write, addr)) {
+    return false;
+  }
+
+  return true;
+}
+
+void cpu_clear_watchpoint(struct Cpu* cpu, u16 addr, u8 access) {
+  struct StopPoints* stops = cpu->stops;
+  if (!stops) {
+    return;
+  }
+
+  if (access & kAccessTypeRead) {
+    addr_set_remove(&stops->watch_read, addr);
+  }
+
+  if (access & kAccessTypeWrite) {
+    addr_set_remove(&stops->watch_write, addr);
+  }
+}
+
+bool cpu_set_host_trap(struct Cpu* cpu, u16 addr, HostTrapFn fn, void* ctx) {
+  struct StopPoints* stops = stop_points(cpu);
+  if (!stops) {
+    return false;
+  }
+
+  struct HostTrap* trap = find_host_trap(stops, addr);
+  if (trap) {
+    trap->fn = fn;
+    trap->ctx = ctx;
+    return true;
+  }
+
+  if (stops->num_traps == stops->trap_capacity) {
+    size_t capacity = stops->trap_capacity ? 2 * stops->trap_capacity : 8;
+    struct HostTrap* traps =
+        realloc(stops->traps, capacity * sizeof(struct HostTrap));
+    if (!traps) {
+      return false;
+    }
+
+    stops->traps = traps;
+    stops->trap_capacity = capacity;
+  }
+
+  if (!addr_set_add(&stops->exec, addr)) {
+    return false;
+  }
+
+  stops->traps[stops->num_traps++] = (struct HostTrap){
+      .addr = addr,
+      .fn = fn,
+      .ctx = ctx,
+  };
+
+  return true;
+}
+
+void cpu_clear_host_trap(struct Cpu* cpu, u16 addr) {
+  struct StopPoints* stops = cpu->stops;
+  struct HostTrap* trap = stops ? find_host_trap(stops, addr) : NULL;
+  if (!trap) {
+    return;
+  }
+
+  *trap = stops->traps[--stops->num_traps];
+  if (!addr_set_has(&stops->breakpoints, addr)) {
+    addr_set_remove(&stops->exec, addr);
+  }
+}
+
+bool call_host_trap(struct Cpu* cpu) {
+  struct StopPoints* stops = cpu->stops;
+  if (!addr_set_has(&stops->exec, cpu->pc)) {
+    return false;
+  }
+
+  const struct HostTrap* trap = find_host_trap(stops, cpu->pc);
+  if (!trap) {
+    return false;
+  }
+
+  u16 pc = cpu->pc;
+  trap->fn(cpu, trap->ctx);
+  return cpu->pc != pc || cpu->stop_requested;
+}
+
+static void record_hit(struct StopPoints* stops, u16 addr, u8 access) {
+  if (stops->hit_access == kAccessTypeNone) {
+    stops->hit_access = access;
+    stops->hit_addr = addr;
+  }
+}
+
+static void watch_bus_map(struct StopPoints* stops) {
+  struct Bus* bus = &stops->watch_bus;
+  const struct Bus* host = stops->host_bus;
+  memcpy(bus->read_pages, host->read_pages, sizeof(bus->read_pages));
+  memcpy(bus->write_pages, host->write_pages, sizeof(bus->write_pages));
+  for (int page = 0; page < 256; ++page) {
+    if (stops->watch_read.pages[page]) {
+      bus->read_pages[page] = NULL;
+    }
+
+    if (stops->watch_write.pages[page]) {
+      bus->write_pages[page] = NULL;
+    }
+  }
+}
+
+static u8 watch_bus_read(void* ctx, u16 addr) {
+  struct StopPoints* stops = ctx;
+  if (addr_set_has(&stops->watch_read, addr)) {
+    record_hit(stops, addr, kAccessTypeRead);
+  }
+
+  const struct Bus* host = stops->host_bus;
+  const u8* page = host->read_pages[addr >> 8];
+  if (page) {
+    return page[addr & 0x00ff];
+  }
+
+  return host->read(host->ctx, addr);
+}
+
+// The host's write callback may remap pages, e.g. to switch banks.
+static void watch_bus_write(void* ctx, u16 addr, u8 data) {
+  struct StopPoints* stops = ctx;
+  if (addr_set_has(&stops->watch_write, addr)) {
+    record_hit(stops, addr, kAccessTypeWrite);
+  }
+
+  struct Bus* host = stops->host_bus;
+  u8* page = host->write_pages[addr >> 8];
+  if (page) {
+    page[addr & 0x00ff] = data;
+    return;
+  }
+
+  host->write(host->ctx, addr, data);
+  watch_bus_map(stops);
+}
+
+void watch_begin(struct Cpu* cpu) {
+  struct StopPoints* stops = cpu->stops;
+  stops->host_bus = cpu->bus;
+  stops->watch_bus.ctx = stops;
+  stops->watch_bus.read = watch_bus_read;
+  stops->watch_bus.write = watch_bus_write;
+  memcpy(stops->watch_bus.pure_reads, cpu->bus->pure_reads,
+         sizeof(cpu->bus->pure_reads));
+  stops->watch_bus.num_pure_reads = cpu->bus->num_pure_reads;
+  watch_bus_map(stops);
+  cpu->bus = &stops->watch_bus;
+}
+
+void watch_end(struct Cpu* cpu) {
+  struct StopPoints* stops = cpu->stops;
+  struct Bus* bus = &stops->watch_bus;
+  for (int page = 0; page < 256; ++page) {
+    stops->host_bus->dirty[page] |= bus->dirty[page];
+  }
+
+  memset(bus->dirty, 0, sizeof(bus->dirty));
+  cpu->bus = stops->host_bus;
+}
+
+void cpu_rts(struct Cpu* cpu) {
+  u16 lo = bus_load(cpu, 0x0100 + ++cpu->s);
+  u16 hi = bus_load(cpu, 0x0100 + ++cpu->s);
+  cpu->pc = ((hi << 8) | lo) + 1;
+  cpu->cycles += 6;
+}
@@ -0,0 +1,268 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu.h"
+#include "trace_format.h"
+
+#define kChunkRecords 4096
+#define kChunkSize (kChunkRecords * kTraceRecordSize)
+#define kNumChunks 8
+
+// Compressed records start with a mask of the bytes that differ from the
+// prediction, followed by those bytes.
+#define kMaxEncodedSize (2 + kTraceRecordSize)
+
+struct Chunk {
+  u8 data[kChunkSize];
+  size_t size;
+};
+
+struct Tracer {
+  // Filled by the CPU thread.
+  u8* record;
+  u8* end;
+  u64 start_cycles;
+
+  // Chunks from head up to tail are full and waiting for the writer, tail is
+  // being filled.
+  pthread_mutex_t lock;
+  pthread_cond_t filled;
+  pthread_cond_t drained;
+  size_t head;
+  size_t tail;
+  bool stopping;
+  struct Chunk* chunks;
+
+  pthread_t thread;
+  int fd;
+  bool compressed;
+  bool failed;
+  enum CpuVariant variant;
+
+  // Predictor of the compressed format, see trace_format.h.
+  u8 previous[kTraceRecordSize];
+  u8 (*seen)[4];
+  u8 encoded[kChunkRecords * kMaxEncodedSize];
+};
+
+static bool write_all(int fd, const u8* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return false;
+    }
+
+    data += n;
+    size -= n;
+  }
+
+  return true;
+}
+
+static size_t encode(struct Tracer* tracer, const u8* records, size_t size) {
+  u8* out = tracer->encoded;
+  for (size_t i = 0; i < size; i += kTraceRecordSize) {
+    const u8* record = records + i;
+    u8 predicted[kTraceRecordSize];
+    predict_pc(tracer->variant, tracer->previous, predicted);
+    u8* seen = tracer->seen[record[kFieldPcLo] | record[kFieldPcHi] << 8];
+    predict_seen(seen, predicted);
+
+    u16 mask = 0;
+    u8* mask_out = out;
+    out += 2;
+    for (int j = 0; j < kTraceRecordSize; ++j) {
+      if (record[j] != predicted[j]) {
+        mask |= 1 << j;
+        *out++ = record[j];
+      }
+    }
+
+    mask_out[0] = mask & 0x00ff;
+    mask_out[1] = mask >> 8;
+
+    update_seen(seen, record);
+    memcpy(tracer->previous, record, kTraceRecordSize);
+  }
+
+  return out - tracer->encoded;
+}
+
+static void* writer_main(void* arg) {
+  struct Tracer* tracer = arg;
+
+  pthread_mutex_lock(&tracer->lock);
+  for (;;) {
+    while (tracer->head == tracer->tail && !tracer->stopping) {
+      pthread_cond_wait(&tracer->filled, &tracer->lock);
+    }
+
+    if (tracer->head == tracer->tail) {
+      break;
+    }
+
+    struct Chunk* chunk = tracer->chunks + tracer->head % kNumChunks;
+    pthread_mutex_unlock(&tracer->lock);
+
+    bool ok;
+    if (tracer->compressed) {
+      size_t size = encode(tracer, chunk->data, chunk->size);
+      ok = write_all(tracer->fd, tracer->encoded, size);
+    } else {
+      ok = write_all(tracer->fd, chunk->data, chunk->size);
+    }
+
+    pthread_mutex_lock(&tracer->lock);
+    tracer->failed |= !ok;
+    ++tracer->head;
+    pthread_cond_signal(&tracer->drained);
+  }
+
+  pthread_mutex_unlock(&tracer->lock);
+  return NULL;
+}
+
+struct Tracer* tracer_new(int fd, bool compressed, enum CpuVariant variant) {
+  if ((unsigned)variant >= kNumCpuVariants) {
+    return NULL;
+  }
+
+  struct Tracer* tracer = calloc(1, sizeof(struct Tracer));
+  if (!tracer) {
+    return NULL;
+  }
+
+  tracer->chunks = malloc(kNumChunks * sizeof(struct Chunk));
+  if (compressed) {
+    tracer->seen = calloc(0x10000, sizeof(*tracer->seen));
+  }
+
+  if (!tracer->chunks || (compressed && !tracer->seen)) {
+    goto err;
+  }
+
+  tracer->fd = fd;
+  tracer->compressed = compressed;
+  tracer->variant = variant;
+  tracer->record = tracer->chunks[0].data;
+  tracer->end = tracer->record + kChunkSize;
+
+  u8 header[12];
+  memcpy(header, kMagic, sizeof(kMagic));
+  header[8] = kVersion;
+  header[9] = compressed ? kFlagCompressed : 0;
+  header[10] = kTraceRecordSize;
+  header[11] = variant;
+  if (!write_all(fd, header, sizeof(header))) {
+    goto err;
+  }
+
+  pthread_mutex_init(&tracer->lock, NULL);
+  pthread_cond_init(&tracer->filled, NULL);
+  pthread_cond_init(&tracer->drained, NULL);
+  if (pthread_create(&tracer->thread, NULL, writer_main, tracer)) {
+    pthread_cond_destroy(&tracer->drained);
+    pthread_cond_destroy(&tracer->filled);
+    pthread_mutex_destroy(&tracer->lock);
+    goto err;
+  }
+
+  return tracer;
+err:
+  free(tracer->seen);
+  free(tracer->chunks);
+  free(tracer);
+  return NULL;
+}
+
+// Hands the chunk being filled to the writer, waiting for a free one if the
+// writer falls behind.
+static void publish(struct Tracer* tracer) {
+  struct Chunk* chunk = tracer->chunks + tracer->tail % kNumChunks;
+  chunk->size = tracer->record - chunk->data;
+
+  pthread_mutex_lock(&tracer->lock);
+  ++tracer->tail;
+  pthread_cond_signal(&tracer->filled);
+  while (tracer->tail - tracer->head == kNumChunks) {
+    pthread_cond_wait(&tracer->drained, &tracer->lock);
+  }
+
+  chunk = tracer->chunks + tracer->tail % kNumChunks;
+  pthread_mutex_unlock(&tracer->lock);
+
+  tracer->record = chunk->data;
+  tracer->end = chunk->data + kChunkSize;
+}
+
+bool tracer_free(struct Tracer* tracer) {
+  if (!tracer) {
+    return true;
+  }
+
+  if (tracer->record != tracer->chunks[tracer->tail % kNumChunks].data) {
+    publish(tracer);
+  }
+
+  pthread_mutex_lock(&tracer->lock);
+  tracer->stopping = true;
+  pthread_cond_signal(&tracer->filled);
+  pthread_mutex_unlock(&tracer->lock);
+  pthread_join(tracer->thread, NULL);
+
+  bool ok = !tracer->failed;
+  pthread_cond_destroy(&tracer->drained);
+  pthread_cond_destroy(&tracer->filled);
+  pthread_mutex_destroy(&tracer->lock);
+  free(tracer->seen);
+  free(tracer->chunks);
+  free(tracer);
+  return ok;
+}
+
+// Fetches without the side effects of the bus where the page table allows.
+static u8 peek(const struct Cpu* cpu, u16 addr) {
+  const u8* page = cpu->bus->read_pages[addr >> 8];
+  if (page) {
+    return page[addr & 0x00ff];
+  }
+
+  return cpu->bus->read(cpu->bus->ctx, addr);
+}
+
+void trace_begin(struct Tracer* tracer, const struct Cpu* cpu) {
+  u8* record = tracer->record;
+  u16 pc = cpu->pc;
+  u8 opcode = peek(cpu, pc);
+  u8 num_bytes = opcode_bytes(cpu->variant, opcode);
+
+  record[kFieldPcLo] = pc & 0x00ff;
+  record[kFieldPcHi] = pc >> 8;
+  record[kFieldOpcode] = opcode;
+  record[kFieldOperand1] = num_bytes >= 2 ? peek(cpu, pc + 1) : 0;
+  record[kFieldOperand2] = num_bytes == 3 ? peek(cpu, pc + 2) : 0;
+  tracer->start_cycles = cpu->cycles;
+}
+
+void trace_end(struct Tracer* tracer, const struct Cpu* cpu) {
+  u8* record = tracer->record;
+  record[kFieldA] = cpu->a;
+  record[kFieldX] = cpu->x;
+  record[kFieldY] = cpu->y;
+  record[kFieldS] = cpu->s;
+  record[kFieldP] = cpu_get_p(cpu);
+  record[kFieldCycles] = cpu->cycles - tracer->start_cycles;
+
+  tracer->record += kTraceRecordSize;
+  if (tracer->record == tracer->end) {
+    publish(tracer);
+  }
+}
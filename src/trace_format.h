@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string.h>
+
+#include "e6502.h"
+
+// The file format of tracer_new(), shared by the writer in trace.c and the
+// e6502-trace decoder. A 12 byte header of the magic, the version, the flags,
+// the record size and the CPU variant is followed by the records.
+
+static const u8 kMagic[8] = {'e', '6', '5', '0', '2', 't', 'r', 'c'};
+
+#define kVersion 1
+#define kFlagCompressed 0x01
+
+enum Field {
+  kFieldPcLo,
+  kFieldPcHi,
+  kFieldOpcode,
+  kFieldOperand1,
+  kFieldOperand2,
+  kFieldA,
+  kFieldX,
+  kFieldY,
+  kFieldS,
+  kFieldP,
+  kFieldCycles,
+};
+
+// Predictor of the compressed format. The PC is predicted to follow the
+// previous instruction and the registers to be those of the previous record.
+// The opcode, operands and cycles are predicted from the last time the PC was
+// seen, which a decoder only knows once it has the PC.
+static inline void predict_pc(enum CpuVariant variant, const u8* previous,
+                              u8* predicted) {
+  u16 pc = previous[kFieldPcLo] | previous[kFieldPcHi] << 8;
+  pc += opcode_bytes(variant, previous[kFieldOpcode]);
+
+  memcpy(predicted, previous, kTraceRecordSize);
+  predicted[kFieldPcLo] = pc & 0x00ff;
+  predicted[kFieldPcHi] = pc >> 8;
+}
+
+static inline void predict_seen(const u8 seen[4], u8* predicted) {
+  predicted[kFieldOpcode] = seen[0];
+  predicted[kFieldOperand1] = seen[1];
+  predicted[kFieldOperand2] = seen[2];
+  predicted[kFieldCycles] = seen[3];
+}
+
+static inline void update_seen(u8 seen[4], const u8* record) {
+  seen[0] = record[kFieldOpcode];
+  seen[1] = record[kFieldOperand1];
+  seen[2] = record[kFieldOperand2];
+  seen[3] = record[kFieldCycles];
+}
@@ -0,0 +1,14 @@
+  io_data = $ffe1
+  io_rx_depth = $ffe2
+
+  .org $0200
+
+loop:
+  lda io_rx_depth
+  beq loop
+  lda io_data
+  sta io_data
+  cmp #'q'
+  bne loop
+
+  brk